@@ -787,6 +787,220 @@ void ComplexCondition::removeChildrenHelper(Condition* condition)
     }
 }
 
+CompiledCondition::CompiledCondition()
+{
+}
+
+std::shared_ptr<CompiledCondition> CompiledCondition::compile(
+    const ComplexCondition* condition, const View* view, const DataProperty& dataset, QList<ModelPtr>& data_not_ready, Error& error)
+{
+    Z_CHECK_NULL(condition);
+    Z_CHECK_NULL(view);
+    Z_CHECK(dataset.propertyType() == PropertyType::Dataset);
+
+    error.clear();
+
+    auto compiled = std::shared_ptr<CompiledCondition>(new CompiledCondition);
+    compiled->_view = view;
+    compiled->_dataset = dataset;
+
+    if (!compiled->compileHelper(condition->root(), data_not_ready, error))
+        return nullptr;
+
+    return compiled;
+}
+
+bool CompiledCondition::calculate(int row, const QModelIndex& parent, QList<ModelPtr>& data_not_ready, Error& error) const
+{
+    error.clear();
+
+    if (_program.isEmpty())
+        return true;
+
+    int pos = 0;
+    bool res = execute(pos, row, parent, data_not_ready, error);
+    return res && data_not_ready.isEmpty() && error.isOk();
+}
+
+bool CompiledCondition::compileHelper(const ConditionPtr& c, QList<ModelPtr>& data_not_ready, Error& error)
+{
+    Instruction ins;
+    ins.type = c->_type;
+
+    if (c->isLogical()) {
+        int pos = _program.count();
+        _program << ins;
+
+        for (auto& child : c->_children) {
+            if (!compileHelper(child, data_not_ready, error))
+                return false;
+        }
+
+        _program[pos].skip = _program.count() - pos - 1;
+        return true;
+    }
+
+    if (c->_type != ConditionType::Required && c->_type != ConditionType::Compare)
+        return false;
+
+    // строки есть только для фильтруемого набора данных
+    auto is_supported = [&](const DataProperty& p) {
+        return p.propertyType() == PropertyType::Field || (p.propertyType() == PropertyType::ColumnFull && p.dataset() == _dataset);
+    };
+
+    if (!is_supported(c->_source))
+        return false;
+
+    ins.source = c->_source;
+    ins.source_conversion = c->_source_conversion;
+
+    if (c->_type == ConditionType::Compare) {
+        ins.compare_operator = c->_compare_operator;
+        ins.is_property_compare = c->_is_property_compare;
+
+        if (c->_is_property_compare) {
+            if (!is_supported(c->_target_property))
+                return false;
+
+            ins.target_property = c->_target_property;
+            ins.target_conversion = c->_target_conversion;
+
+        } else if (c->isRawCompare()) {
+            ins.target_value = c->_target_value;
+
+        } else {
+            // расшифровка lookup выполняется один раз, а не для каждой строки
+            Z_CHECK_NULL(c->_source.lookup());
+
+            if (c->_source.lookup()->type() == LookupType::List) {
+                ins.target_value = c->_source.lookup()->listName(c->_target_value);
+
+            } else {
+                ModelPtr source_model;
+                if (!Core::getEntityValue(c->_source.lookup(), c->_target_value, ins.target_value, source_model, error)) {
+                    if (error.isOk())
+                        data_not_ready << source_model;
+                    return false;
+                }
+            }
+        }
+    }
+
+    _program << ins;
+    return true;
+}
+
+bool CompiledCondition::execute(int& pos, int row, const QModelIndex& parent, QList<ModelPtr>& data_not_ready, Error& error) const
+{
+    const Instruction& ins = _program.at(pos);
+    pos++;
+
+    if (ins.type != ConditionType::Or && ins.type != ConditionType::And)
+        return executeSelf(ins, row, parent, data_not_ready, error);
+
+    int end = pos + ins.skip;
+    if (pos == end)
+        return true;
+
+    while (pos < end) {
+        bool res = execute(pos, row, parent, data_not_ready, error);
+        if (!data_not_ready.isEmpty() || error.isError())
+            return false;
+
+        // остальные вложенные условия не влияют на результат
+        if (res == (ins.type == ConditionType::Or)) {
+            pos = end;
+            return res;
+        }
+    }
+
+    return ins.type == ConditionType::And;
+}
+
+bool CompiledCondition::executeSelf(
+    const Instruction& ins, int row, const QModelIndex& parent, QList<ModelPtr>& data_not_ready, Error& error) const
+{
+    QVariant source_value = value(ins.source, ins.source_conversion, row, parent, data_not_ready, error);
+    if (error.isError())
+        return true;
+
+    if (!data_not_ready.isEmpty())
+        return false;
+
+    if (ins.type == ConditionType::Required)
+        return !source_value.toString().trimmed().isEmpty();
+
+    QVariant target_value;
+    if (ins.is_property_compare) {
+        target_value = value(ins.target_property, ins.target_conversion, row, parent, data_not_ready, error);
+        if (error.isError())
+            return true;
+
+        if (!data_not_ready.isEmpty())
+            return false;
+
+    } else {
+        target_value = ins.target_value;
+    }
+
+    // для сравнения Bool считаем invalid как false
+    if (source_value.type() == QVariant::Bool && (!target_value.isValid() || target_value.isNull()))
+        target_value = false;
+    else if (target_value.type() == QVariant::Bool && (!source_value.isValid() || source_value.isNull()))
+        source_value = false;
+
+    return compare(source_value, target_value, ins.compare_operator);
+}
+
+QVariant CompiledCondition::value(const DataProperty& property, ConversionType conversion, int row, const QModelIndex& parent,
+    QList<ModelPtr>& data_not_ready, Error& error) const
+{
+    error.clear();
+
+    if (property.propertyType() == PropertyType::Field)
+        return Condition::convertValue(nullptr, _view, property, conversion, _view->data()->value(property));
+
+    QVariant value = _view->data()->cellIndex(row, property, parent).data(Qt::DisplayRole);
+    QString display_value = value.toString();
+    QList<ModelPtr> model_data_not_ready;
+    error = _view->getDatasetCellVisibleValue(
+        row, property, parent, value, VisibleValueOption::Application, display_value, model_data_not_ready);
+    if (!display_value.isEmpty() || property.dataType() != DataType::Bool)
+        value = display_value;
+
+    for (auto& m : qAsConst(model_data_not_ready)) {
+        Z_CHECK(m->isLoading());
+    }
+
+    data_not_ready << model_data_not_ready;
+
+    return !model_data_not_ready.isEmpty() || error.isError() ? QVariant()
+                                                              : Condition::convertValue(nullptr, _view, property, conversion, value);
+}
+
+bool CompiledCondition::compare(const QVariant& source_value, const QVariant& value, CompareOperator op)
+{
+    // отображаемые значения почти всегда строки. Для них результат совпадает с Utils::compareVariant, но без перебора типов
+    if (source_value.type() == QVariant::String && value.type() == QVariant::String && (!source_value.isNull() || !value.isNull())) {
+        switch (op) {
+            case CompareOperator::Equal:
+                return source_value.toString().compare(value.toString(), Qt::CaseInsensitive) == 0;
+            case CompareOperator::NotEqual:
+                return source_value.toString().compare(value.toString(), Qt::CaseInsensitive) != 0;
+            case CompareOperator::Contains:
+                return source_value.toString().contains(value.toString(), Qt::CaseInsensitive);
+            case CompareOperator::StartsWith:
+                return source_value.toString().startsWith(value.toString(), Qt::CaseInsensitive);
+            case CompareOperator::EndsWith:
+                return source_value.toString().endsWith(value.toString(), Qt::CaseInsensitive);
+            default:
+                break;
+        }
+    }
+
+    return Utils::compareVariant(source_value, value, op, Core::locale(LocaleType::UserInterface), CompareOption::CaseInsensitive);
+}
+
 //! Версия данных стрима Condition
 static int _ConditionStreamVersion = 1;
 QDataStream& operator<<(QDataStream& out, const Condition& obj)
@@ -173,6 +173,7 @@ private:
     QList<std::shared_ptr<Condition>> _children;
 
     friend class ComplexCondition;
+    friend class CompiledCondition;
     friend QDataStream& operator<<(QDataStream& out, const Condition& obj);
     friend QDataStream& operator>>(QDataStream& in, const std::shared_ptr<Condition>& obj);
 };
@@ -335,6 +336,70 @@ QDataStream
         &
     operator>>(QDataStream& in, ComplexCondition& obj);
 
+/*! Составное условие, скомпилированное для построчной фильтрации набора данных представления.
+ * Дерево условий разворачивается в плоскую программу, в которой для колонок заранее определены позиции, а значения сравнения
+ * (в т.ч. расшифровка lookup) вычислены один раз при компиляции. Строки передаются напрямую, без поиска по RowID.
+ * Программа не отслеживает изменения условия и lookup моделей - ее надо компилировать заново */
+class ZCORESHARED_EXPORT CompiledCondition
+{
+public:
+    /*! Скомпилировать условие для набора данных представления. Возвращает nullptr, если данные для компиляции не готовы
+     * (заполняется data_not_ready), при ошибке или если условие содержит колонки других наборов данных */
+    static std::shared_ptr<CompiledCondition> compile(const ComplexCondition* condition, const View* view, const DataProperty& dataset,
+        //! Список моделей, данные которых нужны, но не загружены
+        QList<ModelPtr>& data_not_ready,
+        //! Ошибка
+        Error& error);
+
+    //! Вычислить условие для строки набора данных
+    bool calculate(int row, const QModelIndex& parent,
+        //! Список моделей, данные которых нужны, но не загружены
+        QList<ModelPtr>& data_not_ready,
+        //! Ошибка
+        Error& error) const;
+
+private:
+    CompiledCondition();
+
+    //! Инструкция программы
+    struct Instruction
+    {
+        ConditionType type = ConditionType::Undefined;
+        //! Для логических условий: количество инструкций вложенных условий, идущих следом
+        int skip = 0;
+
+        DataProperty source;
+        ConversionType source_conversion = ConversionType::Undefined;
+
+        CompareOperator compare_operator = CompareOperator::Undefined;
+
+        //! Сравнение двух свойств
+        bool is_property_compare = false;
+        DataProperty target_property;
+        ConversionType target_conversion = ConversionType::Undefined;
+        //! Вычисленное при компиляции значение сравнения
+        QVariant target_value;
+    };
+
+    //! Добавить условие с вложенными в программу
+    bool compileHelper(const ConditionPtr& c, QList<ModelPtr>& data_not_ready, Error& error);
+    //! Выполнить инструкцию (с вложенными) и перейти к следующей
+    bool execute(int& pos, int row, const QModelIndex& parent, QList<ModelPtr>& data_not_ready, Error& error) const;
+    //! Вычислить условие без вложенных
+    bool executeSelf(const Instruction& ins, int row, const QModelIndex& parent, QList<ModelPtr>& data_not_ready, Error& error) const;
+    //! Значение свойства для строки
+    QVariant value(const DataProperty& property, ConversionType conversion, int row, const QModelIndex& parent,
+        QList<ModelPtr>& data_not_ready, Error& error) const;
+    //! Сравнение. Строки сравниваются напрямую, остальное через Utils::compareVariant
+    static bool compare(const QVariant& source_value, const QVariant& value, CompareOperator op);
+
+    const View* _view = nullptr;
+    DataProperty _dataset;
+    QVector<Instruction> _program;
+};
+
+typedef std::shared_ptr<CompiledCondition> CompiledConditionPtr;
+
 //! Интерфейс фильтрации на основании условий для указанного набора данных
 class I_ConditionFilter
 {
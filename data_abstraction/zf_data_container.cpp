@@ -5,6 +5,8 @@
 #include "zf_logging.h"
 
 #include <QDebug>
+#include <QImage>
+#include <QPixmap>
 #include <QTimeZone>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -19,6 +21,67 @@ static void _variantToDebug(QDebug debug, const QVariant& value)
         debug << value;
 }
 
+//! Оценка памяти, занимаемой значением
+static qint64 _variantMemorySize(const QVariant& value)
+{
+    qint64 size = sizeof(QVariant);
+    switch (value.type()) {
+        case QVariant::String:
+            size += value.toString().size() * static_cast<qint64>(sizeof(QChar));
+            break;
+        case QVariant::ByteArray:
+            size += value.toByteArray().size();
+            break;
+        case QVariant::Image:
+            size += value.value<QImage>().sizeInBytes();
+            break;
+        case QVariant::Pixmap: {
+            QPixmap pixmap = value.value<QPixmap>();
+            size += static_cast<qint64>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+            break;
+        }
+        default:
+            break;
+    }
+    return size;
+}
+
+//! Оценка памяти, занимаемой набором данных. Размер строки оценивается по первым строкам
+static qint64 _datasetMemorySize(const QAbstractItemModel* model, const QModelIndex& parent)
+{
+    // сколько строк анализировать для оценки размера строки
+    const int sample_rows = 16;
+    // накладные расходы на ячейку (_FlatIndexData и т.п.)
+    const qint64 cell_overhead = 32;
+
+    int row_count = model->rowCount(parent);
+    int column_count = model->columnCount(parent);
+    if (row_count == 0 || column_count == 0)
+        return 0;
+
+    int sampled = qMin(row_count, sample_rows);
+    qint64 sample_size = 0;
+    for (int row = 0; row < sampled; row++) {
+        for (int col = 0; col < column_count; col++) {
+            const auto roles = model->itemData(model->index(row, col, parent));
+            for (auto i = roles.constBegin(); i != roles.constEnd(); ++i) {
+                sample_size += _variantMemorySize(i.value());
+            }
+            sample_size += cell_overhead;
+        }
+    }
+
+    qint64 size = sample_size * row_count / sampled;
+
+    for (int row = 0; row < row_count; row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        if (model->hasChildren(index))
+            size += _datasetMemorySize(model, index);
+    }
+
+    return size;
+}
+
 //! Значение свойства
 struct DataContainerValue
 {
@@ -3636,6 +3699,30 @@ void DataContainer::detach()
     _d.detach();
 }
 
+qint64 DataContainer::estimatedMemorySize() const
+{
+    if (!isValid())
+        return 0;
+
+    qint64 size = sizeof(DataContainer_SharedData);
+    for (auto& p : structure()->propertiesMain()) {
+        if (container(p.id()) != this || !isInitialized(p))
+            continue;
+
+        if (p.propertyType() == PropertyType::Field) {
+            const LanguageMap values = valueLanguages(p);
+            for (auto i = values.constBegin(); i != values.constEnd(); ++i) {
+                size += _variantMemorySize(i.value());
+            }
+
+        } else if (p.propertyType() == PropertyType::Dataset) {
+            size += _datasetMemorySize(dataset(p), QModelIndex());
+        }
+    }
+
+    return size;
+}
+
 QVariant DataContainer::variant() const
 {
     return QVariant::fromValue(*this);
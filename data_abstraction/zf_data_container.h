@@ -1131,6 +1131,10 @@ public:
     //! Создать персональную копию разделяемых данных для редактирования набора данных
     void detach();
 
+    //! Приблизительная оценка памяти, занимаемой данными (байт). Для наборов данных размер строки
+    //! оценивается по первым строкам. Свойства, перенаправленные в режиме прокси, не учитываются
+    qint64 estimatedMemorySize() const;
+
     //! Преобразовать в QVariant
     QVariant variant() const;
     //! Восстановить из QVariant
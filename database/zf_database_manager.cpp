@@ -9,6 +9,7 @@
 
 #include <QPluginLoader>
 #include <QApplication>
+#include <QDataStream>
 
 #define DB_DRIVER_USE_THREAD true // запускать драйвер в отдельном потоке
 
@@ -44,6 +45,10 @@ DatabaseManager::DatabaseManager(int terminate_timeout_ms)
     , _terminate_timeout_ms(terminate_timeout_ms)
     , _object_extension(new ObjectExtension(this))
 {
+    _batch_timer = new QTimer(this);
+    _batch_timer->setSingleShot(true);
+    _batch_timer->setInterval(0);
+    connect(_batch_timer, &QTimer::timeout, this, &DatabaseManager::sl_flushBatch);
 }
 
 DatabaseManager::~DatabaseManager()
@@ -122,7 +127,7 @@ void DatabaseManager::bootstrap()
 
 Error DatabaseManager::registerDatabaseDriver(const DatabaseDriverConfig& config, const QString& library_name, const QString& path)
 {
-    Z_CHECK_X(_driver_worker == nullptr, "driver already registered");
+    Z_CHECK_X(_workers.isEmpty(), "driver already registered");
 
     Error error;
 
@@ -145,25 +150,38 @@ Error DatabaseManager::registerDatabaseDriver(const DatabaseDriverConfig& config
     if (error.isError())
         return error;
 
-    _driver_worker = _driver->createWorker(error);
-    if (error.isError()) {
-        loader.unload();
-        return error;
+    // каждый обработчик имеет свое подключение к БД
+    int worker_count = config.workerCount() + config.reportWorkerCount();
+    for (int i = 0; i < worker_count; i++) {
+        WorkerInfo info;
+        info.worker = _driver->createWorker(error);
+        if (error.isError()) {
+            for (auto& w : qAsConst(_workers)) {
+                w.worker->objectExtensionDestroy();
+            }
+            _workers.clear();
+            loader.unload();
+            return error;
+        }
+        Z_CHECK_NULL(info.worker);
+        _workers << info;
     }
-    Z_CHECK_NULL(_driver_worker);
+    _general_worker_count = config.workerCount();
 
-    Core::writeToLogStorage("database driver loaded: " + library_name, InformationType::Information);
+    Core::writeToLogStorage(QString("database driver loaded: %1, workers: %2").arg(library_name).arg(worker_count),
+                            InformationType::Information);
 
+    for (auto& w : _workers) {
 #if DB_DRIVER_USE_THREAD
-    _driver_thread = new DriverThread;
-    _driver_worker->moveToThread(_driver_thread);
-//    connect(_driver_thread, &QThread::finished, _driver_worker, [this]() { _driver_worker->deleteLater(); });
+        w.thread = new DriverThread;
+        w.worker->moveToThread(w.thread);
 #endif
-    connect(_driver_worker, &DatabaseDriverWorker::sg_feedback, this, &DatabaseManager::sl_feedback);
+        connect(w.worker, &DatabaseDriverWorker::sg_feedback, this, &DatabaseManager::sl_feedback);
 
 #if DB_DRIVER_USE_THREAD
-    _driver_thread->start();
+        w.thread->start();
 #endif
+    }
 
     return Error();
 }
@@ -175,13 +193,15 @@ void DatabaseManager::shutdown()
 
 void DatabaseManager::setDatabaseCredentials(const DatabaseID& database_id, const Credentials& credentials)
 {
-    Z_CHECK_X(_driver_worker != nullptr, "driver not registered");
-    _driver_worker->setDatabaseCredentials(database_id, credentials);
+    Z_CHECK_X(!_workers.isEmpty(), "driver not registered");
+    for (auto& w : qAsConst(_workers)) {
+        w.worker->setDatabaseCredentials(database_id, credentials);
+    }
 }
 
 Error DatabaseManager::databaseInitialized()
 {
-    Z_CHECK_X(_driver_worker != nullptr, "driver not registered");
+    Z_CHECK_X(!_workers.isEmpty(), "driver not registered");
     Z_CHECK(!_database_initialized);
 
     auto codes = Core::fr()->getAllModules();
@@ -200,8 +220,24 @@ Error DatabaseManager::databaseInitialized()
 
 DatabaseDriverWorker* DatabaseManager::worker() const
 {
-    Z_CHECK_NULL(_driver_worker);
-    return _driver_worker;
+    Z_CHECK(!_workers.isEmpty());
+    Z_CHECK_NULL(_workers.first().worker);
+    return _workers.first().worker;
+}
+
+void DatabaseManager::setCommandBatchWindow(int ms)
+{
+    Z_CHECK(ms >= 0);
+    _batch_timer->setInterval(ms);
+}
+
+QList<DatabaseDriverWorker*> DatabaseManager::workers() const
+{
+    QList<DatabaseDriverWorker*> res;
+    for (auto& w : qAsConst(_workers)) {
+        res << w.worker;
+    }
+    return res;
 }
 
 const QMap<MessageType, MessageType>& DatabaseManager::commandFeedbackMapping()
@@ -460,6 +496,23 @@ void DatabaseManager::registerUpdateLink(const QList<EntityCode>& source_entity_
     }
 }
 
+UidList DatabaseManager::updateLinkTargets(const Uid& source_entity) const
+{
+    QMutexLocker locked(&_links_mutex);
+
+    QList<UpdateLinkInfo> links = _update_links.values(UpdateLinkInfo(source_entity));
+    links << _update_links.values(UpdateLinkInfo(source_entity.entityCode()));
+
+    UidList res;
+    for (auto& l : qAsConst(links)) {
+        // ссылки на код сущности не указывают на конкретный объект
+        if (l.entity.isValid() && l.entity != source_entity && !res.contains(l.entity))
+            res << l.entity;
+    }
+
+    return res;
+}
+
 const ConnectionInformation* DatabaseManager::connectionInformation() const
 {
     return &_connection_information;
@@ -504,11 +557,80 @@ void DatabaseManager::sl_feedback(const QList<Message>& feedback)
     if (_destroyed)
         return;
 
+    // рассылки о подключении принимаем только от основного обработчика, остальные подключаются к той же БД
+    bool from_main_worker = (sender() == nullptr || _workers.isEmpty() || sender() == _workers.first().worker.data());
+
+    // ответы на объединенные команды раздаем всем исходным командам
+    QList<Message> expanded;
     for (auto& m : feedback) {
         Z_CHECK(m.isValid());
 
         MessageID feedback_id = m.feedbackMessageId();
 
+        // ответы обработчиков на команду, разосланную всем, объединяем в один
+        if (feedback_id.isValid() && _broadcast_parts.contains(feedback_id) && m.messageType() == MessageType::Progress)
+            continue;
+        MessageID broadcast_id = feedback_id.isValid() ? _broadcast_parts.value(feedback_id) : MessageID();
+        bool is_broadcast_part = broadcast_id.isValid();
+        if (!is_broadcast_part && feedback_id.isValid() && _broadcast.contains(feedback_id) && m.messageType() != MessageType::Progress)
+            broadcast_id = feedback_id;
+
+        if (broadcast_id.isValid()) {
+            _broadcast_parts.remove(feedback_id);
+            commandFinished(feedback_id);
+
+            auto b = _broadcast.find(broadcast_id);
+            Z_CHECK(b != _broadcast.end());
+            if (m.messageType() == MessageType::Error)
+                b.value().error << ErrorMessage(m).error();
+            if (!is_broadcast_part)
+                b.value().feedback = m;
+
+            if (--b.value().pending > 0)
+                continue;
+
+            expanded << (b.value().error.isError() ? ErrorMessage(broadcast_id, b.value().error) : b.value().feedback);
+            _broadcast.erase(b);
+            continue;
+        }
+
+        auto it = feedback_id.isValid() ? _coalesced.find(feedback_id) : _coalesced.end();
+        if (it == _coalesced.end()) {
+            expanded << m;
+            continue;
+        }
+
+        if (m.messageType() == MessageType::Progress) {
+            for (auto& c : qAsConst(it.value())) {
+                expanded << splitFeedback(m, c.first);
+            }
+            continue;
+        }
+
+        // драйвер отвечает на команду один раз, поэтому объединенная команда завершена
+        auto commands = it.value();
+        commandFinished(feedback_id);
+        _coalesced.erase(it);
+
+        for (auto& c : qAsConst(commands)) {
+            /* ошибка может относиться к одной из сущностей, а в ответе может не оказаться части сущностей
+             * такие исходные команды повторяем по отдельности, чтобы каждая получила свой ответ */
+            Message split = (m.messageType() == MessageType::Error) ? Message() : splitFeedback(m, c.first);
+            if (split.isValid())
+                expanded << split;
+            else
+                dispatchCommand(c.first, c.second);
+        }
+    }
+
+    for (auto& m : qAsConst(expanded)) {
+        Z_CHECK(m.isValid());
+
+        MessageID feedback_id = m.feedbackMessageId();
+        // промежуточные сообщения о ходе выполнения не завершают команду
+        if (feedback_id.isValid() && m.messageType() != MessageType::Progress)
+            commandFinished(feedback_id);
+
         if (m.messageType() == MessageType::DBEventEntityLoaded) {
         } else if (m.messageType() == MessageType::DBEventEntityExists) {
         } else if (m.messageType() == MessageType::DBEventQueryFeedback) {
@@ -534,7 +656,7 @@ void DatabaseManager::sl_feedback(const QList<Message>& feedback)
         } else if (m.messageType() == MessageType::DBEventInformation || m.messageType() == MessageType::DBEventConnectionDone || m.messageType() == MessageType::DBEventInitLoadDone) {
             Z_CHECK(Core::messageDispatcher()->postMessageToChannel(CoreChannels::SERVER_INFORMATION, CoreUids::DATABASE_MANAGER, m));
         } else if (m.messageType() == MessageType::DBEventConnectionInformation) {
-            if (!feedback_id.isValid()) {
+            if (!feedback_id.isValid() && from_main_worker) {
                 // это рассылка о смене подключения
                 auto msg = DBEventConnectionInformationMessage(m);
                 _connection_information = msg.information();
@@ -601,7 +723,7 @@ void DatabaseManager::sl_message_dispatcher_inbound_advanced(const zf::I_ObjectE
     Z_CHECK(message.isValid());
     Z_CHECK(Utils::isMainThread());
 
-    if (_driver_worker == nullptr) {
+    if (_workers.isEmpty()) {
         Core::messageDispatcher()->postMessage(this, sender_ptr, ErrorMessage(message.messageId(), Error("database driver not installed")));
         return;
     }
@@ -628,45 +750,380 @@ void DatabaseManager::sl_message_dispatcher_inbound_advanced(const zf::I_ObjectE
 
     Core::messageDispatcher()->waitForExternalEventsStart();
 
-    Z_CHECK(QMetaObject::invokeMethod(_driver_worker, "sl_executeCommands", Qt::AutoConnection,
-                                      Q_ARG(QList<zf::Message>, QList<zf::Message> {message}),
-                                      Q_ARG(QList<zf::Uid>, QList<zf::Uid> {sender_uid})));
+    if (!batchKey(message).isEmpty()) {
+        // ждем окончания окна группировки: за это время могут прийти такие же запросы
+        _batch << QPair<Message, Uid> {message, sender_uid};
+        if (!_batch_timer->isActive())
+            _batch_timer->start();
+        return;
+    }
+
+    // команды, накопленные ранее, должны уйти драйверу раньше этой
+    sl_flushBatch();
+    dispatchCommand(message, sender_uid);
 
     //    qDebug() << "DatabaseManager message from" << sender.toPrintable() << message.toPrintable()
     //             << "forwarded to driver";
 }
 
+void DatabaseManager::sl_flushBatch()
+{
+    _batch_timer->stop();
+
+    if (_destroyed || _batch.isEmpty())
+        return;
+
+    auto batch = _batch;
+    _batch.clear();
+
+    // группы отправляются в порядке поступления первой команды группы
+    QStringList keys;
+    QHash<QString, QList<QPair<Message, Uid>>> groups;
+    for (auto& b : qAsConst(batch)) {
+        QString key = batchKey(b.first);
+        if (!groups.contains(key))
+            keys << key;
+        groups[key] << b;
+    }
+
+    for (auto& key : qAsConst(keys)) {
+        const auto& group = groups[key];
+        if (group.count() == 1) {
+            dispatchCommand(group.first().first, group.first().second);
+            continue;
+        }
+
+        QList<Message> commands;
+        for (auto& g : group) {
+            commands << g.first;
+        }
+
+        Message merged = mergeCommands(commands);
+        _coalesced[merged.messageId()] = group;
+        dispatchCommand(merged, group.first().second);
+    }
+}
+
+void DatabaseManager::dispatchCommand(const Message& message, const Uid& sender_uid)
+{
+    if (message.messageType() == MessageType::DBCommandReconnect && _workers.count() > 1) {
+        broadcastCommand(message, sender_uid);
+        return;
+    }
+
+    bool is_write;
+    UidList entities = commandEntities(message, is_write);
+    int worker_index = selectWorker(message, entities, is_write);
+
+    _workers[worker_index].active++;
+    _command_workers[message.messageId()] = worker_index;
+    if (is_write) {
+        // пока запись не завершена, все команды по этим сущностям идут в тот же обработчик
+        _command_write_entities[message.messageId()] = entities;
+        for (auto& u : qAsConst(entities)) {
+            auto it = _write_affinity.find(u);
+            if (it == _write_affinity.end())
+                _write_affinity[u] = {worker_index, 1};
+            else
+                it.value().second++;
+        }
+    }
+
+    Z_CHECK(QMetaObject::invokeMethod(_workers.at(worker_index).worker, "sl_executeCommands", Qt::AutoConnection,
+                                      Q_ARG(QList<zf::Message>, QList<zf::Message> {message}),
+                                      Q_ARG(QList<zf::Uid>, QList<zf::Uid> {sender_uid})));
+}
+
+void DatabaseManager::broadcastCommand(const Message& message, const Uid& sender_uid)
+{
+    Z_CHECK(message.messageType() == MessageType::DBCommandReconnect);
+
+    _broadcast[message.messageId()].pending = _workers.count();
+
+    for (int i = 0; i < _workers.count(); i++) {
+        // основной обработчик получает исходную команду, остальные - ее копии со своими id
+        Message command = message;
+        if (i > 0) {
+            command = DBCommandReconnectMessage(true);
+            _broadcast_parts[command.messageId()] = message.messageId();
+        }
+
+        _workers[i].active++;
+        _command_workers[command.messageId()] = i;
+
+        Z_CHECK(QMetaObject::invokeMethod(_workers.at(i).worker, "sl_executeCommands", Qt::AutoConnection,
+                                          Q_ARG(QList<zf::Message>, QList<zf::Message> {command}),
+                                          Q_ARG(QList<zf::Uid>, QList<zf::Uid> {sender_uid})));
+    }
+}
+
+QString DatabaseManager::batchKey(const Message& message)
+{
+    if (message.messageType() == MessageType::DBCommandGetAccessRights)
+        return "AR_" + DBCommandGetAccessRightsMessage(message).login();
+
+    if (message.messageType() != MessageType::DBCommandGetEntity)
+        return QString();
+
+    DBCommandGetEntityMessage msg(message);
+    for (auto& p : msg.parameters()) {
+        // команды с произвольными параметрами не объединяем
+        if (!p.isEmpty())
+            return QString();
+    }
+
+    // объединяются только запросы с одинаковым набором свойств для всех сущностей
+    auto properties = msg.properties();
+    DataPropertySet common = properties.isEmpty() ? DataPropertySet() : properties.first();
+    for (auto& p : qAsConst(properties)) {
+        if (p != common)
+            return QString();
+    }
+
+    QList<DataProperty> sorted = common.values();
+    std::sort(sorted.begin(), sorted.end());
+
+    QByteArray signature;
+    QDataStream st(&signature, QIODevice::WriteOnly);
+    st.setVersion(Consts::DATASTREAM_VERSION);
+    for (auto& p : qAsConst(sorted)) {
+        st << p;
+    }
+
+    return "E_" + QString::fromLatin1(signature.toHex());
+}
+
+Message DatabaseManager::mergeCommands(const QList<Message>& commands)
+{
+    Z_CHECK(!commands.isEmpty());
+
+    UidList uids;
+    QSet<Uid> uids_set;
+    for (auto& c : commands) {
+        UidList c_uids = (c.messageType() == MessageType::DBCommandGetAccessRights) ? DBCommandGetAccessRightsMessage(c).entityUids()
+                                                                                    : DBCommandGetEntityMessage(c).entityUids();
+        for (auto& u : qAsConst(c_uids)) {
+            if (uids_set.contains(u))
+                continue;
+            uids_set << u;
+            uids << u;
+        }
+    }
+
+    const Message& first = commands.first();
+    if (first.messageType() == MessageType::DBCommandGetAccessRights)
+        return DBCommandGetAccessRightsMessage(uids, DBCommandGetAccessRightsMessage(first).login());
+
+    Z_CHECK(first.messageType() == MessageType::DBCommandGetEntity);
+    auto properties = DBCommandGetEntityMessage(first).properties();
+    if (properties.isEmpty())
+        return DBCommandGetEntityMessage(uids);
+
+    QList<DataPropertySet> merged_properties;
+    for (int i = 0; i < uids.count(); i++) {
+        merged_properties << properties.first();
+    }
+    return DBCommandGetEntityMessage(uids, merged_properties);
+}
+
+Message DatabaseManager::splitFeedback(const Message& feedback, const Message& command)
+{
+    if (feedback.messageType() == MessageType::DBEventEntityLoaded && command.messageType() == MessageType::DBCommandGetEntity) {
+        DBEventEntityLoadedMessage msg(feedback);
+        UidList uids = msg.entityUids();
+        DataContainerList data = msg.data();
+        AccessRightsList direct_rights = msg.directRights();
+        AccessRightsList relation_rights = msg.relationRights();
+
+        QHash<Uid, int> index;
+        for (int i = uids.count() - 1; i >= 0; i--) {
+            index[uids.at(i)] = i;
+        }
+
+        UidList c_uids;
+        DataContainerList c_data;
+        AccessRightsList c_direct_rights;
+        AccessRightsList c_relation_rights;
+        auto requested = DBCommandGetEntityMessage(command).entityUids();
+        for (auto& u : qAsConst(requested)) {
+            int i = index.value(u, -1);
+            if (i < 0)
+                return Message();
+
+            c_uids << u;
+            c_data << data.at(i);
+            if (!direct_rights.isEmpty())
+                c_direct_rights << direct_rights.at(i);
+            if (!relation_rights.isEmpty())
+                c_relation_rights << relation_rights.at(i);
+        }
+
+        return DBEventEntityLoadedMessage(command.messageId(), c_uids, c_data, c_direct_rights, c_relation_rights);
+    }
+
+    if (feedback.messageType() == MessageType::DBEventAccessRights && command.messageType() == MessageType::DBCommandGetAccessRights) {
+        DBEventAccessRightsMessage msg(feedback);
+        UidList uids = msg.entityUids();
+        AccessRightsList direct_rights = msg.directRights();
+        AccessRightsList relation_rights = msg.relationRights();
+
+        QHash<Uid, int> index;
+        for (int i = uids.count() - 1; i >= 0; i--) {
+            index[uids.at(i)] = i;
+        }
+
+        UidList c_uids;
+        AccessRightsList c_direct_rights;
+        AccessRightsList c_relation_rights;
+        auto requested = DBCommandGetAccessRightsMessage(command).entityUids();
+        for (auto& u : qAsConst(requested)) {
+            int i = index.value(u, -1);
+            if (i < 0)
+                return Message();
+
+            c_uids << u;
+            c_direct_rights << direct_rights.at(i);
+            c_relation_rights << relation_rights.at(i);
+        }
+
+        return DBEventAccessRightsMessage(command.messageId(), c_uids, c_direct_rights, c_relation_rights);
+    }
+
+    // прочие ответы (например о ходе выполнения) передаем как есть
+    return Message(feedback.messageType(), feedback.messageCode(), command.messageId(), feedback.rawData());
+}
+
+UidList DatabaseManager::commandEntities(const Message& message, bool& is_write)
+{
+    is_write = false;
+
+    switch (message.messageType()) {
+        case MessageType::DBCommandWriteEntity:
+            is_write = true;
+            return DBCommandWriteEntityMessage(message).entityUids();
+        case MessageType::DBCommandRemoveEntity:
+            is_write = true;
+            return DBCommandRemoveEntityMessage(message).entityUidList();
+        case MessageType::DBCommandUpdateEntities:
+            is_write = true;
+            return DBCommandUpdateEntitiesMessage(message).entityUids();
+        case MessageType::DBCommandGetEntity:
+            return DBCommandGetEntityMessage(message).entityUids();
+        case MessageType::DBCommandIsEntityExists:
+            return DBCommandIsEntityExistsMessage(message).entityUidList();
+        case MessageType::DBCommandGetAccessRights:
+            return DBCommandGetAccessRightsMessage(message).entityUids();
+        default:
+            return {};
+    }
+}
+
+int DatabaseManager::selectWorker(const Message& message, const UidList& entities, bool is_write) const
+{
+    Q_UNUSED(is_write)
+    Z_CHECK(!_workers.isEmpty());
+
+    /* команды произвольного вида и запрос информации о подключении выполняет основной обработчик
+     * переподключение при нескольких обработчиках рассылается всем (broadcastCommand) */
+    if (message.messageType() == MessageType::General || message.messageType() == MessageType::DBCommandReconnect
+        || message.messageType() == MessageType::DBCommandGetConnectionInformation)
+        return 0;
+
+    // долгие команды не должны блокировать общие обработчики
+    if (message.messageType() == MessageType::DBCommandGenerateReport && _workers.count() > _general_worker_count)
+        return leastLoadedWorker(_general_worker_count, _workers.count() - _general_worker_count);
+
+    // если по сущности есть незавершенная запись, то команда должна выполниться после нее
+    for (auto& u : entities) {
+        auto it = _write_affinity.constFind(u);
+        if (it != _write_affinity.constEnd())
+            return it.value().first;
+    }
+
+    return leastLoadedWorker(0, _general_worker_count);
+}
+
+int DatabaseManager::leastLoadedWorker(int from, int count) const
+{
+    Z_CHECK(count > 0 && from + count <= _workers.count());
+
+    int res = from;
+    for (int i = from + 1; i < from + count; i++) {
+        if (_workers.at(i).active < _workers.at(res).active)
+            res = i;
+    }
+    return res;
+}
+
+void DatabaseManager::commandFinished(const MessageID& command_id)
+{
+    auto it = _command_workers.find(command_id);
+    if (it == _command_workers.end())
+        return;
+
+    _workers[it.value()].active--;
+    _command_workers.erase(it);
+
+    auto entities = _command_write_entities.take(command_id);
+    for (auto& u : qAsConst(entities)) {
+        auto a = _write_affinity.find(u);
+        if (a == _write_affinity.end())
+            continue;
+
+        if (--a.value().second == 0)
+            _write_affinity.erase(a);
+    }
+}
+
 void DatabaseManager::freeResources()
 {
     _destroyed = true;
 
-    if (_driver_worker != nullptr)
-        _driver_worker->shutdown();
+    for (auto& w : qAsConst(_workers)) {
+        if (w.worker != nullptr)
+            w.worker->shutdown();
+    }
 
     if (_driver != nullptr)
         _driver->shutdown();
 
-    if (_driver_thread != nullptr && _driver_thread->isRunning()) {
-        _driver_thread->requestInterruption();
-        _driver_thread->quit();
+    for (auto& w : _workers) {
+        if (w.thread == nullptr || !w.thread->isRunning())
+            continue;
+
+        w.thread->requestInterruption();
+        w.thread->quit();
+    }
+
+    for (auto& w : _workers) {
+        if (w.thread == nullptr || !w.thread->isRunning())
+            continue;
 
         if (_terminate_timeout_ms > 0) {
-            if (!_driver_thread->wait(_terminate_timeout_ms)) {
+            if (!w.thread->wait(_terminate_timeout_ms)) {
                 Core::logError("Driver terminated by timeout");
-                _driver_thread->terminate();
-                _driver_thread->wait();
+                w.thread->terminate();
+                w.thread->wait();
             }
         } else
-            _driver_thread->wait();
+            w.thread->wait();
 
-        delete _driver_thread;
-        _driver_thread = nullptr;
+        delete w.thread;
+        w.thread = nullptr;
 
-        if (_driver_worker != nullptr) {
-            _driver_worker->objectExtensionDestroy();
-            _driver_worker = nullptr;
+        if (w.worker != nullptr) {
+            w.worker->objectExtensionDestroy();
+            w.worker = nullptr;
         }
     }
+
+    _command_workers.clear();
+    _command_write_entities.clear();
+    _write_affinity.clear();
+    _batch.clear();
+    _coalesced.clear();
+    _broadcast.clear();
+    _broadcast_parts.clear();
 }
 
 void DatabaseManager::sendFeedback(const MessageID& feedback_id, const Message& message)
@@ -10,6 +10,7 @@
 #include "zf_message.h"
 #include "zf_object_extension.h"
 #include <QThread>
+#include <QTimer>
 
 namespace zf
 {
@@ -124,6 +125,8 @@ public:
     void registerUpdateLink(const EntityCode& source_entity_code, const EntityCode& target_entity_code);
     //! Зарегистрировать обновление одной сущности при изменении другой
     void registerUpdateLink(const QList<EntityCode>& source_entity_codes, const EntityCode& target_entity_code);
+    //! Конкретные сущности, зарегистрированные через registerUpdateLink как зависимые от указанной
+    UidList updateLinkTargets(const Uid& source_entity) const;
 
     //! Информация о подключении к БД
     const ConnectionInformation* connectionInformation() const;
@@ -159,8 +162,14 @@ public:
     //! Вызывать после того, как будет готова работа с базой данных (установлен драйвер, логин и пароль)
     Error databaseInitialized();
 
-    //! Драйвер БД - обработчик
+    //! Драйвер БД - основной обработчик
     DatabaseDriverWorker* worker() const;
+    //! Драйвер БД - все обработчики. Первый из них основной
+    QList<DatabaseDriverWorker*> workers() const;
+
+    /*! Окно группировки команд (мс). Одинаковые запросы сущностей и прав доступа, поступившие в течение окна,
+     * объединяются в один запрос к драйверу. 0 - в пределах одного цикла обработки событий */
+    void setCommandBatchWindow(int ms);
 
 private slots:
     //! Получены сообщения от сервера БД
@@ -169,6 +178,8 @@ private slots:
     void sl_message_dispatcher_inbound(const zf::Uid& sender, const zf::Message& message, zf::SubscribeHandle subscribe_handle);
     void sl_message_dispatcher_inbound_advanced(const zf::I_ObjectExtension* sender_ptr, const zf::Uid& sender_uid,
                                                 const zf::Message& message, zf::SubscribeHandle subscribe_handle);
+    //! Отправить драйверу команды, накопленные за окно группировки
+    void sl_flushBatch();
 
 private:
     void freeResources();
@@ -185,6 +196,29 @@ private:
     //! Обновить сущности, зарегистрированные через registerUpdateLink
     void processUpdateLink(const UidList& entity, const EntityCodeList& codes);
 
+    //! Сущности, которые затрагивает команда
+    static UidList commandEntities(const Message& message,
+                                   //! Команда изменяет сущности
+                                   bool& is_write);
+    //! Выбрать обработчик для команды. Возвращает индекс в _workers
+    int selectWorker(const Message& message, const UidList& entities, bool is_write) const;
+    //! Наименее загруженный обработчик из указанного диапазона
+    int leastLoadedWorker(int from, int count) const;
+    //! Команда завершена - освободить обработчик
+    void commandFinished(const MessageID& command_id);
+    //! Передать команду обработчику драйвера
+    void dispatchCommand(const Message& message, const Uid& sender_uid);
+    //! Передать команду всем обработчикам (переподключение: у каждого обработчика свое подключение к БД)
+    void broadcastCommand(const Message& message, const Uid& sender_uid);
+
+    //! Ключ группировки команды. Пустая строка, если команда не группируется
+    static QString batchKey(const Message& message);
+    //! Объединить команды с одинаковым ключом группировки в одну
+    static Message mergeCommands(const QList<Message>& commands);
+    //! Выделить из ответа на объединенную команду ответ на исходную команду. Если в ответе нет данных по какой-либо
+    //! сущности исходной команды, то возвращает невалидное сообщение
+    static Message splitFeedback(const Message& feedback, const Message& command);
+
     //! обновление одной сущности при изменении другой - информация
     struct UpdateLinkInfo
     {
@@ -216,14 +250,52 @@ private:
 
     //! Драйвер БД
     DatabaseDriver* _driver = nullptr;
-    //! Драйвер БД - обработчик
-    QPointer<DatabaseDriverWorker> _driver_worker;
+    //! Обработчик драйвера БД
+    struct WorkerInfo
+    {
+        QPointer<DatabaseDriverWorker> worker;
+        //! Поток, в котором работает обработчик
+        QThread* thread = nullptr;
+        //! Количество команд в работе
+        int active = 0;
+    };
+    //! Обработчики драйвера БД. Сначала общие, затем выделенные для отчетов
+    QList<WorkerInfo> _workers;
+    //! Количество общих обработчиков
+    int _general_worker_count = 0;
+    //! Команды в работе. Ключ - id команды, значение - индекс обработчика
+    QHash<MessageID, int> _command_workers;
+    //! Сущности, изменяемые командами в работе. Ключ - id команды
+    QHash<MessageID, UidList> _command_write_entities;
+    //! Сущности, по которым есть незавершенные команды на запись. Значение - индекс обработчика и количество команд
+    QHash<Uid, QPair<int, int>> _write_affinity;
+
+    //! Команды, ожидающие окончания окна группировки, и их отправители
+    QList<QPair<Message, Uid>> _batch;
+    //! Таймер окна группировки
+    QTimer* _batch_timer = nullptr;
+    //! Объединенные команды. Ключ - id команды, переданной драйверу, значение - исходные команды и их отправители
+    QHash<MessageID, QList<QPair<Message, Uid>>> _coalesced;
+
+    //! Команда, разосланная всем обработчикам
+    struct BroadcastInfo
+    {
+        //! Количество обработчиков, которые еще не ответили
+        int pending = 0;
+        //! Ответ основного обработчика
+        Message feedback;
+        //! Ошибки всех обработчиков
+        Error error;
+    };
+    //! Команды, разосланные всем обработчикам. Ключ - id исходной команды
+    QHash<MessageID, BroadcastInfo> _broadcast;
+    //! Копии разосланных команд. Ключ - id копии, значение - id исходной команды
+    QHash<MessageID, MessageID> _broadcast_parts;
+
     //! БД была инициализщирована
     bool _database_initialized = false;
     //! Удален
     bool _destroyed = false;
-    //! Поток, в котором работает драйвер БД
-    QThread* _driver_thread = nullptr;
 
     //! Информация о подключении к БД
     ConnectionInformation _connection_information;
@@ -1,4 +1,5 @@
 #include "zf_database_driver_config.h"
+#include "zf_defs.h"
 
 namespace zf
 {
@@ -32,4 +33,26 @@ void DatabaseDriverConfig::setRequestTimeout(int request_timeout)
     _request_timeout = request_timeout;
 }
 
+int DatabaseDriverConfig::workerCount() const
+{
+    return _worker_count;
+}
+
+void DatabaseDriverConfig::setWorkerCount(int worker_count)
+{
+    Z_CHECK(worker_count > 0);
+    _worker_count = worker_count;
+}
+
+int DatabaseDriverConfig::reportWorkerCount() const
+{
+    return _report_worker_count;
+}
+
+void DatabaseDriverConfig::setReportWorkerCount(int report_worker_count)
+{
+    Z_CHECK(report_worker_count >= 0);
+    _report_worker_count = report_worker_count;
+}
+
 } // namespace zf
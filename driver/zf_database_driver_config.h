@@ -27,6 +27,18 @@ public:
     //! Задать время ожидания ответа от сервера (мс)
     void setRequestTimeout(int request_timeout);
 
+    /*! Количество обработчиков драйвера (DatabaseDriverWorker). Каждый работает в своем потоке со своим подключением к БД.
+     * Чтение выполняется параллельно, запись по одной сущности - последовательно в одном обработчике */
+    int workerCount() const;
+    //! Количество обработчиков драйвера
+    void setWorkerCount(int worker_count);
+
+    /*! Количество обработчиков драйвера, выделенных для долгих команд (генерация отчетов). Если 0, то отчеты
+     * выполняются общими обработчиками */
+    int reportWorkerCount() const;
+    //! Количество обработчиков драйвера, выделенных для долгих команд
+    void setReportWorkerCount(int report_worker_count);
+
 private:
     //! Размера кэша файлов шаблонов отчета
     int _template_cache_size = 100;
@@ -35,5 +47,10 @@ private:
 
     //! Время ожидания ответа от сервера (мс)
     int _request_timeout = 2000;
+
+    //! Количество обработчиков драйвера
+    int _worker_count = 1;
+    //! Количество обработчиков драйвера, выделенных для долгих команд
+    int _report_worker_count = 0;
 };
 } // namespace zf
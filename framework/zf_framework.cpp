@@ -7,6 +7,7 @@
 #include "zf_core_messages.h"
 #include "zf_item_delegate.h"
 #include "zf_dialog_configuration.h"
+#include "zf_model_disk_cache.h"
 #include "zf_http_headers.h"
 #include "zf_exception.h"
 #include "zf_catalog_info.h"
@@ -48,6 +49,8 @@ const int Framework::PROCESS_EVENTS_TIMEOUT_MS = 100;
 const int Framework::MODEL_KEEPER_ONE_STEP = 100;
 //!  Сколько сообщений буфера обрабатывает MessageDispatcher за один раз
 const int Framework::MESSAGE_DISPATCHER_ONE_STEP = 100;
+//! Порог количества массовых событий в буфере MessageDispatcher, после которого отправляется сигнал о переполнении
+const int Framework::MESSAGE_DISPATCHER_HIGH_WATER_MARK = 10000;
 //! Менеджер обратных вызовов для внутреннего использования
 ObjectExtensionPtr<CallbackManager> Framework::_callback_manager;
 //! Генератор последовательностей для внутреннего использования
@@ -629,6 +632,12 @@ QString Framework::dialogConfigFile() const
     return Utils::dataLocation() + QStringLiteral("/dialog_config");
 }
 
+ModelDiskCache* Framework::modelDiskCache() const
+{
+    Z_CHECK(Utils::isMainThread());
+    return _model_disk_cache.get();
+}
+
 Error Framework::getModels(const I_ObjectExtension* requester, const UidList& entity_uid_list, const QList<LoadOptions>& load_options_list,
     const QList<DataPropertySet>& properties_list, const QList<bool>& all_if_empty_list, QList<ModelPtr>& models, MessageID& feedback_message_id)
 {
@@ -1216,6 +1225,17 @@ void Framework::bootstrapAccessibility()
 
 void Framework::loadSystemData()
 {
+    // файл кэша находится в папке пользователя, поэтому открывается заново при смене пользователя
+    _model_disk_cache.reset();
+    if (!Core::currentUserLogin().isEmpty()) {
+        auto cache = std::make_unique<ModelDiskCache>(Utils::dataLocation() + QStringLiteral("/model_cache/models.dat"), Core::buildVersion());
+        Error error = cache->open();
+        if (error.isError())
+            Core::logError(error);
+        else
+            _model_disk_cache = std::move(cache);
+    }
+
     _dialog_configuration = std::make_unique<DialogConfigurationRepository>();
     if (!Core::mode().testFlag(CoreMode::Library) && QFile::exists(dialogConfigFile())) {
         QFile f(dialogConfigFile());
@@ -26,6 +26,7 @@ class ModuleManager;
 class I_DatabaseDriver;
 class DialogConfigurationRepository;
 class SharedPtrDeleter;
+class ModelDiskCache;
 
 class Framework : public QObject, public I_ObjectExtension
 {
@@ -37,6 +38,8 @@ public: // константы для тонкой настройки
     static const int MODEL_KEEPER_ONE_STEP;
     //!  Сколько сообщений буфера обрабатывает MessageDispatcher за один раз
     static const int MESSAGE_DISPATCHER_ONE_STEP;
+    //! Порог количества массовых событий в буфере MessageDispatcher, после которого отправляется сигнал о переполнении
+    static const int MESSAGE_DISPATCHER_HIGH_WATER_MARK;
 
     //! Ключи системного менеджера обратных вызовов (Framework::internalCallbackManager())
     //! Вынесены в одно место чтобы не было случайного пересечения ключей при наследовании
@@ -338,6 +341,10 @@ public:
     //! Файл настройки диалогов
     QString dialogConfigFile() const;
 
+    //! Локальный кэш моделей между запусками программы (DatabaseObjectOption::LocalCache). Открывается в loadSystemData
+    //! для текущего пользователя. nullptr до входа пользователя или если файл кэша не удалось открыть
+    ModelDiskCache* modelDiskCache() const;
+
     //! Значение в каталоге по ID строки. Если каталог не загружен или в процессе загрузки, то пустое значение
     QVariant catalogValue(
         //! Код сущности каталога
@@ -545,6 +552,8 @@ private:
     mutable std::unique_ptr<LocalSettingsManager> _local_settings;
     //! Хранилище информации о свойствах диалогов
     mutable std::unique_ptr<DialogConfigurationRepository> _dialog_configuration;
+    //! Локальный кэш моделей
+    std::unique_ptr<ModelDiskCache> _model_disk_cache;
 
     //! Приложение открыто (главное окно открыто и не находится в состоянии закрытия)
     bool _is_active = false;
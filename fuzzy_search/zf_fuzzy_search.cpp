@@ -1,7 +1,7 @@
 #include "zf_fuzzy_search.h"
-#include <QSet>
 #include <QMultiMap>
-#include <QVector>
+#include <QVarLengthArray>
+#include <QtConcurrent>
 
 //! Фонетические группы
 const QMultiMap<QChar, int> FuzzySearch::_phonetic_groups {
@@ -12,48 +12,73 @@ const QMultiMap<QChar, int> FuzzySearch::_phonetic_groups {
     {L'а', 10}, {L'о', 10}, {L'у', 10}, {L'е', 11}, {L'и', 11}, {L'ю', 12}, {L'у', 12}, {L'э', 13}, {L'е', 13}, {L'е', 14},
     {L'и', 14}, {L'я', 15}, {L'а', 15}, {L'ё', 16}, {L'о', 16}, {L'ы', 17}, {L'и', 17},
 };
-bool FuzzySearch::_is_phonetic_groups_prepared = false;
-QSet<QString> FuzzySearch::_phonetic_groups_prepared;
 
-QVector<double>* FuzzySearch::_words_rate = nullptr;
-QVector<int>* FuzzySearch::_words_lenght = nullptr;
-QVector<QVector<int>>* FuzzySearch::_matrix = nullptr;
+//! Стоимость, которая заведомо больше любого допустимого расстояния
+static const int _infinite_cost = 1 << 28;
+//! Стоимость замены символов, отличия в которых принципиальны
+static const int _non_letter_cost = 9999;
 
-QMutex FuzzySearch::_phonetic_groups_mutex;
-QMutex FuzzySearch::_words_rate_mutex;
-QMutex FuzzySearch::_matrix_mutex;
+int FuzzySearch::letterIndex(const QChar& c)
+{
+    ushort u = c.unicode();
+    if (u >= 'a' && u <= 'z')
+        return u - 'a';
+    if (u >= 0x0430 && u <= 0x044F) // а-я
+        return 26 + (u - 0x0430);
+    if (u == 0x0451) // ё
+        return _letter_count - 1;
+    return -1;
+}
 
-void FuzzySearch::preparePhoneticGroups()
+const FuzzySearch::CostTable& FuzzySearch::costTable()
 {
-    _is_phonetic_groups_prepared = true;
+    // инициализация локальной статической переменной потокобезопасна, далее доступ только на чтение
+    static const CostTable table = createCostTable();
+    return table;
+}
+
+FuzzySearch::CostTable FuzzySearch::createCostTable()
+{
+    CostTable table;
+    table.fill(2);
+
+    for (int i = 0; i < _letter_count; i++) {
+        table[i * _letter_count + i] = 0;
+    }
 
+    // буквы из одной фонетической группы заменяются дешевле
     for (auto it1 = _phonetic_groups.constBegin(); it1 != _phonetic_groups.constEnd(); ++it1) {
         for (auto it2 = _phonetic_groups.constBegin(); it2 != _phonetic_groups.constEnd(); ++it2) {
-            if (it1.key() == it2.key())
+            if (it1.key() == it2.key() || it1.value() != it2.value())
                 continue;
 
-            _phonetic_groups_prepared << QString(it1.key()) + QString(it2.key());
+            int i1 = letterIndex(it1.key());
+            int i2 = letterIndex(it2.key());
+            Z_CHECK(i1 >= 0 && i2 >= 0);
+            table[i1 * _letter_count + i2] = 1;
         }
     }
+
+    return table;
 }
 
-int FuzzySearch::cost_helper(const QChar& c1, const QChar& c2)
+int FuzzySearch::cost_helper(const CostTable& table, const QChar& c1, const QChar& c2)
 {
     if (c1 == c2)
         return 0;
 
-    if (!c1.isLetter() || !c2.isLetter())
-        return 9999; // отличия не в буквах принципиальны
+    int i1 = letterIndex(c1);
+    int i2 = letterIndex(c2);
+    if (i1 >= 0 && i2 >= 0)
+        return table[i1 * _letter_count + i2];
 
-    QMutexLocker lock(&_phonetic_groups_mutex);
-    if (!_is_phonetic_groups_prepared) {
-        preparePhoneticGroups();
-    }
+    if (!c1.isLetter() || !c2.isLetter())
+        return _non_letter_cost; // отличия не в буквах принципиальны
 
-    return _phonetic_groups_prepared.contains(QString(c1) + QString(c2)) ? 1 : 2;
+    return 2;
 }
 
-double FuzzySearch::compareText(const QString& s1, const QString& s2)
+double FuzzySearch::compareText(const QString& s1, const QString& s2, double min_rate)
 {
     QString str1 = s1.simplified().toLower();
     QString str2 = s2.simplified().toLower();
@@ -111,173 +136,148 @@ double FuzzySearch::compareText(const QString& s1, const QString& s2)
     int count = s1_words_prep->count();
     int max_length = 0; // макс. длина строк
 
-    QVector<double>* words_rate; // рейтинг по каждому слову
-    QVector<int>* words_lenght; // макс. длина из каждой пары строк
-
-    _words_rate_mutex.lock();
-    bool words_rate_allocated;
-    if (count <= _max_word_count) {
-        if (!_words_rate) {
-            _words_rate = new QVector<double>(_max_word_count);
-            _words_lenght = new QVector<int>(_max_word_count);
-        }
-
-        words_rate = _words_rate;
-        words_lenght = _words_lenght;
-        words_rate_allocated = false;
-
-    } else {
-        words_rate = new QVector<double>(count);
-        words_lenght = new QVector<int>(count);
-        words_rate_allocated = true;
-    }
-    _words_rate_mutex.unlock();
-
+    // макс. длина из каждой пары строк. Память выделяется на стеке, поэтому разделяемые буферы не нужны
+    QVarLengthArray<int, _max_word_count> words_lenght(count);
     for (int i = 0; i < count; i++) {
         int length = qMax(s1_words_prep->at(i).length(), s2_words_prep->at(i).length());
         max_length = qMax(max_length, length);
-        (*words_lenght)[i] = length;
-        (*words_rate)[i] = compareWord_helper(s1_words_prep->at(i), s2_words_prep->at(i), false);
+        words_lenght[i] = length;
+    }
+
+    // макс. вклад в рейтинг слов, которые еще не сравнивались
+    double rest_rate = 0;
+    if (min_rate > 0) {
+        for (int i = 0; i < count; i++) {
+            rest_rate += 100.0 * words_lenght.at(i) / static_cast<double>(max_length);
+        }
     }
 
     double rate = 0;
     for (int i = 0; i < count; i++) {
-        rate += words_rate->at(i) * words_lenght->at(i) / static_cast<double>(max_length);
-    }
+        double weight = words_lenght.at(i) / static_cast<double>(max_length);
+        rate += compareWord_helper(s1_words_prep->at(i), s2_words_prep->at(i), false, 0) * weight;
 
-    if (words_rate_allocated) {
-        delete words_rate;
-        delete words_lenght;
+        if (min_rate > 0) {
+            // даже если остальные слова совпадут полностью, нужная схожесть не будет достигнута
+            rest_rate -= 100.0 * weight;
+            if ((rate + rest_rate) / static_cast<double>(count) < min_rate)
+                return 0;
+        }
     }
 
-    return rate / static_cast<double>(count); //-V773
+    return rate / static_cast<double>(count);
 }
 
-double FuzzySearch::compareWord(const QString& s1, const QString& s2)
+double FuzzySearch::compareWord(const QString& s1, const QString& s2, double min_rate)
 {
-    return compareWord_helper(s1, s2, true);
+    return compareWord_helper(s1, s2, true, min_rate);
+}
+
+QVector<double> FuzzySearch::compareTextParallel(const QString& s, const QStringList& values, double min_rate)
+{
+    std::function<double(const QString&)> compare_func = [s, min_rate](const QString& value) -> double {
+        return compareText(s, value, min_rate);
+    };
+
+    return QtConcurrent::blockingMapped<QVector<double>>(values, compare_func);
 }
 
-double FuzzySearch::compareWord_helper(const QString& s1, const QString& s2, bool to_lower)
+double FuzzySearch::compareWord_helper(const QString& s1, const QString& s2, bool to_lower, double min_rate)
 {
-    const QString* str1;
-    const QString* str2;
+    QString s1_lower;
+    QString s2_lower;
+    const QString* str1 = &s1;
+    const QString* str2 = &s2;
     if (to_lower) {
-        str1 = new QString(s1.toLower().simplified());
-        str2 = new QString(s2.toLower().simplified());
-    } else {
-        str1 = &s1;
-        str2 = &s2;
+        s1_lower = s1.toLower().simplified();
+        s2_lower = s2.toLower().simplified();
+        str1 = &s1_lower;
+        str2 = &s2_lower;
     }
 
+    const QChar* a = str1->constData();
+    const QChar* b = str2->constData();
     int m = str1->size();
     int n = str2->size();
     int max_size = qMax(m, n);
 
-    QVector<QVector<int>>* matrix;
-
-    bool matrix_allocated;
-    if (_max_word_lenght >= max_size) {
-        _matrix_mutex.lock();
-        if (!_matrix)
-            _matrix = new QVector<QVector<int>>(_max_word_lenght + 1, QVector<int>(_max_word_lenght + 1));
-
-        matrix = _matrix;
-        _matrix_mutex.unlock();
-        matrix_allocated = false;
+    if (max_size == 0)
+        return 100;
 
-    } else {
-        matrix = new QVector<QVector<int>>(m + 1, QVector<int>(n + 1));
-        matrix_allocated = true;
+    // Если в любом слове есть цифры, то проводить полное сравнение
+    bool digits = false;
+    for (int i = 0; i < m && !digits; ++i) {
+        digits = a[i].isDigit();
+    }
+    for (int j = 0; j < n && !digits; ++j) {
+        digits = b[j].isDigit();
     }
+    if (digits)
+        return *str1 == *str2 ? 100 : 0;
 
-    bool dig1 = false;
-    bool dig2 = false;
+    int max_rate = 2 * max_size;
+    // макс. расстояние, при котором схожесть не ниже min_rate
+    int max_distance = min_rate > 0 ? static_cast<int>(max_rate * (100.0 - min_rate) / 100.0) : max_rate;
+    // каждая вставка/удаление стоит 2, поэтому разница в длине дает нижнюю границу расстояния
+    if (2 * qAbs(m - n) > max_distance)
+        return 0;
 
-    for (int i = 0; i <= m; ++i) {
-        (*matrix)[i][0] = i << 1;
+    // считаем только ячейки в полосе вокруг диагонали: смещение от нее стоит не меньше 2 за шаг
+    int band = max_distance / 2;
 
-        if (i < m) {
-            if (str1->at(i).isDigit())
-                dig1 = true;
-        }
-    }
+    // три строки матрицы: текущая и две предыдущие (нужны для учета обмена)
+    QVarLengthArray<int, 3 * (_max_word_lenght + 1)> buffer(3 * (n + 1));
+    int* prev2 = buffer.data();
+    int* prev = prev2 + n + 1;
+    int* cur = prev + n + 1;
 
     for (int j = 0; j <= n; ++j) {
-        if (j > 0)
-            (*matrix)[0][j] = j << 1;
-
-        if (j < n) {
-            if (str2->at(j).isDigit())
-                dig2 = true;
-        }
+        prev[j] = j << 1;
     }
 
-    // Если в любом слове есть цифры, то проводить полное сравнение
-    if (dig1 || dig2) {
-        if (m != n) {
-            if (matrix_allocated)
-                delete matrix;
-
-            if (to_lower) {
-                delete str1;
-                delete str2;
-            }
-            return 0; //-V773
-        }
-
-        for (int i = 0; i < n; ++i) {
-            if (str1->at(i) != str2->at(i)) {
-                if (matrix_allocated)
-                    delete matrix;
+    const CostTable& table = costTable();
 
-                if (to_lower) {
-                    delete str1;
-                    delete str2;
-                }
-                return 0;
-            }
-        }
-        if (matrix_allocated)
-            delete matrix;
+    // минимум предыдущей строки (строка 0 начинается с нуля)
+    int prev_row_min = 0;
+    for (int i = 1; i <= m; ++i) {
+        int j_from = qMax(1, i - band);
+        int j_to = qMin(n, i + band);
 
-        if (to_lower) {
-            delete str1;
-            delete str2;
-        }
-        return 100;
-    }
+        cur[j_from - 1] = (j_from == 1) ? (i << 1) : _infinite_cost;
+        if (j_to < n)
+            cur[j_to + 1] = _infinite_cost;
 
-    for (int j = 1; j <= n; ++j) {
-        for (int i = 1; i <= m; ++i) {
+        int row_min = cur[j_from - 1];
+        for (int j = j_from; j <= j_to; ++j) {
             // Учтем вставки, удаления и замены
-            int rcost = cost_helper(str1->at(i - 1), str2->at(j - 1));
-            int dist0 = (*matrix)[i - 1][j] + 2;
-            int dist1 = (*matrix)[i][j - 1] + 2;
-            int dist2 = (*matrix)[i - 1][j - 1] + rcost;
-            (*matrix)[i][j] = qMin(dist0, std::min(dist1, dist2));
+            int rcost = cost_helper(table, a[i - 1], b[j - 1]);
+            int dist = qMin(qMin(prev[j] + 2, cur[j - 1] + 2), prev[j - 1] + rcost);
             // Учтем обмен
-            if (i > 1 && j > 1 && str1->at(i - 1) == str2->at(j - 2) && str1->at(i - 2) == str2->at(j - 1)) {
-                (*matrix)[i][j] = qMin((*matrix)[i][j], (*matrix)[i - 2][j - 2] + 1);
-            }
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                dist = qMin(dist, prev2[j - 2] + 1);
+
+            cur[j] = dist;
+            row_min = qMin(row_min, dist);
         }
-    }
 
-    if (to_lower) {
-        delete str1;
-        delete str2;
+        // все пути уже дороже допустимого - дальше можно не считать. Обмен берет значение через строку, поэтому
+        // расстояние может снова уменьшиться, пока минимум предыдущей строки в пределах допустимого
+        if (row_min > max_distance && prev_row_min > max_distance)
+            return 0;
+        prev_row_min = row_min;
+
+        int* tmp = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = tmp;
     }
 
     // нормализация
-    int abs_rate = (*matrix)[m][n];
-    int max_rate = 2 * max_size;
-
-    if (matrix_allocated)
-        delete matrix;
+    int abs_rate = prev[n];
 
     if (abs_rate == 0)
         return 100;
-    else if (abs_rate >= max_rate)
+    else if (abs_rate >= max_rate || abs_rate > max_distance)
         return 0;
 
     // Если не точное совпадение, то нельзя выдавать 100%
@@ -1,53 +1,56 @@
 #pragma once
 
 #include <QString>
+#include <array>
 #include "zf.h"
 
 /*! Алгоритм нечеткого поиска
  * Для сравнения двух строк на "похожесть" используется модифициованный метод "Расстояние Дамерау-Левенштейна" с
  * нормализацией результата. В метод вычисления "расстояния" между строками добавлен учет похожести звучания отдельных
- * букв т.е. стоимость замены 'о' на 'я' будет выше чем замена 'о' на 'а' */
+ * букв т.е. стоимость замены 'о' на 'я' будет выше чем замена 'о' на 'а'
+ * Все методы реентерабельны и не используют блокировок, поэтому могут вызываться параллельно из любого количества потоков */
 class ZCORESHARED_EXPORT FuzzySearch
 {
 public:
     //! Схожесть строки 0-100%
     //! Изменяет схожесть по отдельным словам и затем вычисляет среднее с учетом "веса"(длины) каждой строки
     //! Потокобезопасно
-    static double compareText(const QString& s1, const QString& s2);
+    static double compareText(const QString& s1, const QString& s2,
+        //! Минимальная схожесть 0-100%. Если схожесть заведомо ниже, то расчет прерывается и возвращается 0
+        double min_rate = 0);
     //! Схожесть отдельного слова 0-100%. Потокобезопасно
-    static double compareWord(const QString& s1, const QString& s2);
+    static double compareWord(const QString& s1, const QString& s2,
+        //! Минимальная схожесть 0-100%. Если схожесть заведомо ниже, то расчет прерывается и возвращается 0
+        double min_rate = 0);
+
+    //! Схожесть строки с каждой строкой из списка 0-100%. Расчет выполняется параллельно в пуле потоков
+    static QVector<double> compareTextParallel(const QString& s, const QStringList& values,
+        //! Минимальная схожесть 0-100%. Если схожесть ниже, то для строки возвращается 0
+        double min_rate = 0);
 
 private:
+    //! Количество букв, для которых заранее рассчитана стоимость замены: латиница, кириллица и 'ё'
+    static const int _letter_count = 26 + 32 + 1;
+    //! Таблица стоимости замены букв. Индекс: letterIndex(c1) * _letter_count + letterIndex(c2)
+    typedef std::array<quint8, _letter_count * _letter_count> CostTable;
+
     //! Схожесть отдельного слова 0-100%
-    static double compareWord_helper(const QString& s1, const QString& s2, bool to_lower);
+    static double compareWord_helper(const QString& s1, const QString& s2, bool to_lower, double min_rate);
 
     //! Не нормализованная "стоимость" замены символа для алгоритма вычисления схожести строк
-    static int cost_helper(const QChar& c1, const QChar& c2);
-    //! Сформировать всевозможные комбинации пар символов на основе фонетических групп
-    static void preparePhoneticGroups();
+    static int cost_helper(const CostTable& table, const QChar& c1, const QChar& c2);
+    //! Позиция буквы в таблице стоимости замены. Если буквы нет в таблице, то -1
+    static int letterIndex(const QChar& c);
+    //! Таблица стоимости замены букв. Формируется один раз при первом обращении
+    static const CostTable& costTable();
+    //! Сформировать таблицу стоимости замены на основе фонетических групп
+    static CostTable createCostTable();
 
     //! Фонетические группы
     static const QMultiMap<QChar, int> _phonetic_groups;
-    //! _phonetic_groups_prepared был заполнен данными
-    static bool _is_phonetic_groups_prepared;
-    //! Фонетические группы, подготовленные для быстрого поиска
-    static QSet<QString> _phonetic_groups_prepared;
-
-    //! Макс. кол-во слов в строке
-    static const int _max_word_count = 1024;
-    //! Макс. длина слова
-    static const int _max_word_lenght = 256;
-
-    //! Рейтинг по каждому слову. Выделение памяти для оптимизации
-    static QVector<double>* _words_rate;
-    //! Макс. длина из каждой пары строк. Выделение памяти для оптимизации
-    static QVector<int>* _words_lenght;
 
-    //! Память для работы compareWord. Выделение памяти для оптимизации
-    static QVector<QVector<int>>* _matrix;
-
-    static QMutex _phonetic_groups_mutex;
-    static QMutex _words_rate_mutex;
-    static QMutex _matrix_mutex;
+    //! Макс. длина слова, для которой память под расчет выделяется на стеке
+    static const int _max_word_lenght = 256;
+    //! Макс. кол-во слов в строке, для которого память под расчет выделяется на стеке
+    static const int _max_word_count = 64;
 };
-
@@ -0,0 +1,221 @@
+#include "zf_fuzzy_search_index.h"
+#include "zf_fuzzy_search.h"
+
+#include <algorithm>
+
+FuzzySearchIndex::FuzzySearchIndex()
+{
+}
+
+int FuzzySearchIndex::count() const
+{
+    return _records.count();
+}
+
+bool FuzzySearchIndex::contains(int id) const
+{
+    return _records.contains(id);
+}
+
+void FuzzySearchIndex::setRecord(int id, const QStringList& fields)
+{
+    if (_records.contains(id))
+        removeRecord(id);
+
+    Record record;
+    for (auto& f : fields) {
+        QString s = normalize(f);
+        if (s.isEmpty())
+            continue;
+
+        if (!record.text.isEmpty())
+            record.text += QChar(' ');
+        record.text += s;
+        record.words << s.split(QChar(' '), QString::SkipEmptyParts);
+    }
+
+    QVector<Trigram> trigrams = recordTrigrams(record);
+    for (auto t : qAsConst(trigrams)) {
+        _trigrams[t].append(id);
+    }
+
+    _records[id] = record;
+}
+
+void FuzzySearchIndex::removeRecord(int id)
+{
+    auto it = _records.find(id);
+    if (it == _records.end())
+        return;
+
+    QVector<Trigram> trigrams = recordTrigrams(it.value());
+    for (auto t : qAsConst(trigrams)) {
+        auto t_it = _trigrams.find(t);
+        if (t_it == _trigrams.end())
+            continue;
+
+        t_it.value().removeOne(id);
+        if (t_it.value().isEmpty())
+            _trigrams.erase(t_it);
+    }
+
+    _records.erase(it);
+}
+
+void FuzzySearchIndex::clear()
+{
+    _records.clear();
+    _trigrams.clear();
+}
+
+QList<FuzzySearchIndex::Match> FuzzySearchIndex::search(const QString& text, double min_rate, int limit) const
+{
+    QList<Match> res;
+
+    QString s = normalize(text);
+    if (s.isEmpty())
+        return res;
+
+    if (s.length() < 3) {
+        // для короткого запроса триграммы есть только у начала слова, поэтому ищем вхождение подстроки
+        for (auto it = _records.constBegin(); it != _records.constEnd(); ++it) {
+            if (!it.value().text.contains(s))
+                continue;
+
+            Match m;
+            m.id = it.key();
+            m.rate = 100;
+            res << m;
+        }
+
+        std::sort(res.begin(), res.end(), [](const Match& m1, const Match& m2) -> bool { return m1.id < m2.id; });
+
+        if (limit >= 0 && res.count() > limit)
+            res.erase(res.begin() + limit, res.end());
+
+        return res;
+    }
+
+    QStringList words = s.split(QChar(' '), QString::SkipEmptyParts);
+
+    // триграммы запроса. Последнее слово может быть введено не полностью
+    QVector<Trigram> trigrams;
+    for (int i = 0; i < words.count(); i++) {
+        wordTrigrams(words.at(i), i == words.count() - 1, trigrams);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // одна опечатка портит не более трех триграмм
+    int min_hits = qMax(1, trigrams.count() - 3);
+
+    QHash<int, int> hits;
+    for (auto t : qAsConst(trigrams)) {
+        auto it = _trigrams.constFind(t);
+        if (it == _trigrams.constEnd())
+            continue;
+
+        for (int id : it.value()) {
+            hits[id]++;
+        }
+    }
+
+    for (auto it = hits.constBegin(); it != hits.constEnd(); ++it) {
+        if (it.value() < min_hits)
+            continue;
+
+        double r = rate(_records.value(it.key()), s, words, min_rate);
+        if (r < min_rate)
+            continue;
+
+        Match m;
+        m.id = it.key();
+        m.rate = r;
+        res << m;
+    }
+
+    std::sort(res.begin(), res.end(), [](const Match& m1, const Match& m2) -> bool {
+        if (m1.rate != m2.rate)
+            return m1.rate > m2.rate;
+        return m1.id < m2.id;
+    });
+
+    if (limit >= 0 && res.count() > limit)
+        res.erase(res.begin() + limit, res.end());
+
+    return res;
+}
+
+double FuzzySearchIndex::recordRate(int id, const QString& text, double min_rate) const
+{
+    auto it = _records.constFind(id);
+    if (it == _records.constEnd())
+        return 0;
+
+    QString s = normalize(text);
+    if (s.isEmpty())
+        return 0;
+
+    double r = rate(it.value(), s, s.split(QChar(' '), QString::SkipEmptyParts), min_rate);
+    return r < min_rate ? 0 : r;
+}
+
+QString FuzzySearchIndex::normalize(const QString& s)
+{
+    return s.simplified().toLower();
+}
+
+void FuzzySearchIndex::wordTrigrams(const QString& word, bool is_prefix, QVector<Trigram>& trigrams)
+{
+    // начало слова дополняется пробелами, чтобы короткие запросы тоже давали триграммы
+    QString padded = QStringLiteral("  ") + word;
+    if (!is_prefix)
+        padded += QChar(' ');
+
+    for (int i = 0; i + 2 < padded.size(); i++) {
+        trigrams << ((static_cast<Trigram>(padded.at(i).unicode()) << 32) | (static_cast<Trigram>(padded.at(i + 1).unicode()) << 16)
+                     | static_cast<Trigram>(padded.at(i + 2).unicode()));
+    }
+}
+
+QVector<FuzzySearchIndex::Trigram> FuzzySearchIndex::recordTrigrams(const Record& record)
+{
+    QVector<Trigram> trigrams;
+    for (auto& w : record.words) {
+        wordTrigrams(w, false, trigrams);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+double FuzzySearchIndex::rate(const Record& record, const QString& text, const QStringList& words, double min_rate)
+{
+    // точное вхождение
+    if (record.text.contains(text))
+        return 100;
+
+    // для каждого искомого слова ищем наиболее похожее слово записи. Слово записи сравнивается целиком и
+    // по началу той же длины (запрос может быть введен не полностью)
+    double total = 0;
+    for (int i = 0; i < words.count(); i++) {
+        const QString& w = words.at(i);
+        double best = 0;
+        for (auto& rw : record.words) {
+            best = qMax(best, FuzzySearch::compareWord(w, rw, min_rate));
+            if (rw.length() > w.length())
+                best = qMax(best, FuzzySearch::compareWord(w, rw.left(w.length()), min_rate));
+            if (best >= 100)
+                break;
+        }
+
+        // точное совпадение только при полном вхождении текста
+        total += qMin(best, 99.9);
+
+        // даже если остальные слова совпадут полностью, нужная схожесть не будет достигнута
+        if ((total + 100.0 * (words.count() - i - 1)) / words.count() < min_rate)
+            return 0;
+    }
+
+    return total / words.count();
+}
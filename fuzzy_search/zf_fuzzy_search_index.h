@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include "zf.h"
+
+/*! Индекс для нечеткого поиска по большому количеству записей
+ * Для каждого слова записи хранятся триграммы. При поиске по триграммам отбираются записи-кандидаты, которые
+ * затем ранжируются через FuzzySearch. Поддерживает добавление, изменение и удаление записей без перестроения индекса */
+class ZCORESHARED_EXPORT FuzzySearchIndex
+{
+public:
+    //! Результат поиска
+    struct Match
+    {
+        //! Идентификатор записи
+        int id = -1;
+        //! Схожесть 0-100%
+        double rate = 0;
+    };
+
+    FuzzySearchIndex();
+
+    //! Количество записей
+    int count() const;
+    //! Содержит запись
+    bool contains(int id) const;
+
+    //! Добавить или заменить запись
+    void setRecord(int id,
+        //! Текстовые поля записи. Поиск ведется по всем полям
+        const QStringList& fields);
+    //! Удалить запись
+    void removeRecord(int id);
+    //! Очистить индекс
+    void clear();
+
+    /*! Поиск записей. Результат отсортирован по убыванию схожести, при равной схожести - по возрастанию id
+     * Запись, содержащая искомый текст целиком, имеет схожесть 100%. Запрос короче трех символов ищется только как подстрока */
+    QList<Match> search(const QString& text,
+        //! Минимальная схожесть 0-100%
+        double min_rate = 70,
+        //! Макс. количество результатов. Если -1, то без ограничений
+        int limit = -1) const;
+    //! Схожесть конкретной записи с текстом 0-100%. Если записи нет или схожесть меньше min_rate, то 0
+    double recordRate(int id, const QString& text, double min_rate = 70) const;
+
+private:
+    //! Триграмма, упакованная в целое число
+    typedef quint64 Trigram;
+
+    //! Данные записи
+    struct Record
+    {
+        //! Все поля через пробел в нижнем регистре (для поиска подстроки)
+        QString text;
+        //! Слова записи в нижнем регистре
+        QStringList words;
+    };
+
+    //! Нормализация текста для поиска
+    static QString normalize(const QString& s);
+    //! Триграммы слова. Если is_prefix, то слово может быть введено не полностью
+    static void wordTrigrams(const QString& word, bool is_prefix, QVector<Trigram>& trigrams);
+    //! Уникальные триграммы записи
+    static QVector<Trigram> recordTrigrams(const Record& record);
+    //! Схожесть записи с искомыми словами
+    static double rate(const Record& record, const QString& text, const QStringList& words, double min_rate);
+
+    //! Записи. Ключ - id
+    QHash<int, Record> _records;
+    //! Триграмма - список id записей
+    QHash<Trigram, QVector<int>> _trigrams;
+};
@@ -5981,58 +5981,63 @@ void Utils::setTabOrder(const QList<QWidget*> widgets)
 }
 
 QVariant Utils::valueToLanguage(const LanguageMap* value, QLocale::Language language)
+{
+    const QVariant* v = findValueToLanguage(value, language);
+    return v == nullptr ? QVariant() : *v;
+}
+
+const QVariant* Utils::findValueToLanguage(const LanguageMap* value, QLocale::Language language)
 {
     Z_CHECK_NULL(value);
 
+    if (value->isEmpty())
+        return nullptr;
+
+    // всего одна запись - нет выбора
+    if (value->count() == 1)
+        return &value->first();
+
     QLocale::Language def_lang = Core::language(LocaleType::UserInterface);
 
-    if (!value->isEmpty()) {
-        // всего одна запись - нет выбора
-        if (value->count() == 1)
-            return value->first();
-
-        if (language == QLocale::AnyLanguage)
-            language = def_lang;
-
-        // точное совпадение
-        auto it = value->find(language);
-        if (it != value->end())
-            return it.value();
-
-        // язык UI
-        it = value->find(def_lang);
-        if (it != value->end())
-            return it.value();
-
-        // сохранено как значение для любого языка
-        it = value->find(QLocale::AnyLanguage);
-        if (it != value->end())
-            return it.value();
-
-        // сохранено под языком по умолчанию
-        it = value->find(Core::defaultLanguage());
-        if (it != value->end())
-            return it.value();
-
-        // может есть русский
-        if (def_lang != QLocale::Russian && Core::defaultLanguage() != QLocale::Russian) {
-            it = value->find(QLocale::Russian);
-            if (it != value->end())
-                return it.value();
-        }
+    if (language == QLocale::AnyLanguage)
+        language = def_lang;
 
-        // может есть английский
-        if (def_lang != QLocale::English && Core::defaultLanguage() != QLocale::English) {
-            it = value->find(QLocale::English);
-            if (it != value->end())
-                return it.value();
-        }
+    // точное совпадение
+    auto it = value->constFind(language);
+    if (it != value->constEnd())
+        return &it.value();
 
-        // первый попавшийся
-        return value->first();
+    // язык UI
+    it = value->constFind(def_lang);
+    if (it != value->constEnd())
+        return &it.value();
 
-    } else
-        return QVariant();
+    // сохранено как значение для любого языка
+    it = value->constFind(QLocale::AnyLanguage);
+    if (it != value->constEnd())
+        return &it.value();
+
+    // сохранено под языком по умолчанию
+    it = value->constFind(Core::defaultLanguage());
+    if (it != value->constEnd())
+        return &it.value();
+
+    // может есть русский
+    if (def_lang != QLocale::Russian && Core::defaultLanguage() != QLocale::Russian) {
+        it = value->constFind(QLocale::Russian);
+        if (it != value->constEnd())
+            return &it.value();
+    }
+
+    // может есть английский
+    if (def_lang != QLocale::English && Core::defaultLanguage() != QLocale::English) {
+        it = value->constFind(QLocale::English);
+        if (it != value->constEnd())
+            return &it.value();
+    }
+
+    // первый попавшийся
+    return &value->first();
 }
 
 QVariant Utils::valueToLanguage(const LanguageMap& value, QLocale::Language language)
@@ -32,6 +32,13 @@ Error Utils::itemModelToCSV(const QAbstractItemModel* model, QIODevice* device,
     Z_CHECK(isMainThread());
 
     QTextCodec* codec = QTextCodec::codecForName(Consts::FILE_ENCODING.toLatin1());
+    Z_CHECK_NULL(codec);
+    // Кодировщик один на весь файл, чтобы BOM и состояние кодека не дублировались между блоками
+    std::unique_ptr<QTextEncoder> encoder(codec->makeEncoder());
+
+    // Текст накапливается в буфере и кодируется/записывается блоками по Consts::CSV_BUFFER_SIZE
+    QString buffer;
+    buffer.reserve(Consts::CSV_BUFFER_SIZE + Consts::CSV_BUFFER_SIZE / 8);
 
     // Заголовок
     QMap<int, QString> hMap;
@@ -49,22 +56,21 @@ Error Utils::itemModelToCSV(const QAbstractItemModel* model, QIODevice* device,
             continue;
 
         if (started)
-            device->write(codec->fromUnicode(QString(Consts::CSV_SEPARATOR)));
+            buffer += Consts::CSV_SEPARATOR;
 
-        QString val = hMap.value(col).simplified();
         // CSV заключает в ковычки каждую строку данных
         // Если в ней есть ковычки, они заменяются на двойные
-        val = putInQuotes(val, '"');
-
-        device->write(codec->fromUnicode(val));
+        buffer += putInQuotes(hMap.value(col).simplified(), '"');
         started = true;
     }
-    device->write(codec->fromUnicode(QString('\n')));
+    buffer += QChar('\n');
 
     // Строки
-    itemModelToCSV_helper(model, device, hMap, codec, visible_info, QModelIndex(), timeout_ms, original_uid);
+    Error error = itemModelToCSV_helper(model, device, hMap, encoder.get(), visible_info, QModelIndex(), original_uid, timeout_ms, buffer);
+    if (error.isError())
+        return error;
 
-    return Error();
+    return flushCSVBuffer(device, encoder.get(), buffer, true);
 }
 
 Error Utils::itemModelFromCSV(FlatItemModel* model, const QString& file_name, const QMap<QString, int>& columns_mapping,
@@ -80,18 +86,22 @@ Error Utils::itemModelFromCSV(FlatItemModel* model, const QString& file_name, co
     return itemModelFromCSV(model, &f, columns_mapping, codec);
 }
 
-void Utils::itemModelToCSV_helper(const QAbstractItemModel* model, QIODevice* device, const QMap<int, QString>& hMap, QTextCodec* codec,
-                                  const I_DatasetVisibleInfo* visible_info, const QModelIndex& parent, bool original_uid, int timeout_ms)
+Error Utils::itemModelToCSV_helper(const QAbstractItemModel* model, QIODevice* device, const QMap<int, QString>& hMap,
+                                   QTextEncoder* encoder, const I_DatasetVisibleInfo* visible_info, const QModelIndex& parent,
+                                   bool original_uid, int timeout_ms, QString& buffer)
 {
+    Error error;
     bool started = false;
-    for (int row = 0; row < model->rowCount(parent); row++) {
+    int row_count = model->rowCount(parent);
+    int column_count = model->columnCount();
+    for (int row = 0; row < row_count; row++) {
         started = false;
-        for (int col = 0; col < model->columnCount(); col++) {
+        for (int col = 0; col < column_count; col++) {
             if (!hMap.contains(col))
                 continue;
 
             if (started)
-                device->write(codec->fromUnicode(QString(Consts::CSV_SEPARATOR)));
+                buffer += Consts::CSV_SEPARATOR;
 
             QModelIndex index = model->index(row, col, parent);
             QVariant data;
@@ -120,19 +130,39 @@ void Utils::itemModelToCSV_helper(const QAbstractItemModel* model, QIODevice* de
                     data.clear();
             }
 
-            QString val = Utils::variantToString(data).simplified();
-
             // CSV заключает в ковычки каждую строку данных
             // Если в ней есть ковычки, они заменяются на двойные
-            putInQuotes(val, '"');
-
-            device->write(codec->fromUnicode(val));
+            buffer += putInQuotes(Utils::variantToString(data).simplified(), '"');
             started = true;
         }
-        device->write(codec->fromUnicode(QString('\n')));
+        buffer += QChar('\n');
+
+        // строка целиком в буфере - можно сбросить на диск, не разрывая ее между блоками
+        error = flushCSVBuffer(device, encoder, buffer, false);
+        if (error.isError())
+            return error;
 
-        itemModelToCSV_helper(model, device, hMap, codec, visible_info, model->index(row, 0, parent), timeout_ms, original_uid);
+        error = itemModelToCSV_helper(model, device, hMap, encoder, visible_info, model->index(row, 0, parent), original_uid, timeout_ms, buffer);
+        if (error.isError())
+            return error;
     }
+
+    return Error();
+}
+
+Error Utils::flushCSVBuffer(QIODevice* device, QTextEncoder* encoder, QString& buffer, bool force)
+{
+    if (buffer.isEmpty() || (!force && buffer.size() < Consts::CSV_BUFFER_SIZE))
+        return Error();
+
+    QByteArray encoded = encoder->fromUnicode(buffer);
+    // clear освобождает память, а нам нужно сохранить зарезервированный объем
+    buffer.resize(0);
+
+    if (device->write(encoded) != encoded.size())
+        return Error::fileIOError(device);
+
+    return Error();
 }
 
 Error Utils::itemModelFromCSV(FlatItemModel* model, QIODevice* device, const QMap<QString, int>& columns_mapping, const QString& codec)
@@ -155,15 +185,20 @@ Error Utils::itemModelFromCSV(FlatItemModel* model, QIODevice* device, const QMa
     int file_column_count = 0;
     QMap<int, int> file_column_mapping;
 
-    model->setRowCount(0);
     model->setColumnCount(model_column_count);
 
+    // Строки накапливаются в модели без подписчиков и передаются в model за один раз (один сигнал modelReset)
+    std::unique_ptr<FlatItemModel> loaded = std::make_unique<FlatItemModel>(0, model_column_count);
+    loaded->setLanguage(model->language());
+    loaded->blockSignals(true);
+
     QTextStream in(device);
     in.setCodec(QTextCodec::codecForName(codec.toLatin1()));
 
-    while (!in.atEnd()) {
+    QString line;
+    while (in.readLineInto(&line)) {
         file_row++;
-        QString line = in.readLine().trimmed();
+        line = line.trimmed();
 
         if (line.isEmpty())
             continue;
@@ -174,8 +209,10 @@ Error Utils::itemModelFromCSV(FlatItemModel* model, QIODevice* device, const QMa
             // Первая строка - заголовок
             header_processed = true;
             file_column_count = data.count();
-            if (file_column_count == 0)
+            if (file_column_count == 0) {
+                model->setRowCount(0);
                 return {};
+            }
 
             for (int col = 0; col < file_column_count; col++) {
                 int model_col = columns_mapping_prepared.value(data.at(col).toUpper(), -1);
@@ -188,7 +225,11 @@ Error Utils::itemModelFromCSV(FlatItemModel* model, QIODevice* device, const QMa
             continue;
         }
 
+        int row = loaded->appendRow();
         for (auto i = file_column_mapping.begin(); i != file_column_mapping.end(); ++i) {
+            if (i.key() >= data.count())
+                continue;
+
             QString cell_text = data.at(i.key()).trimmed();
             QVariant v = variantFromString(cell_text);
             if (v.type() == QVariant::String) {
@@ -197,12 +238,12 @@ Error Utils::itemModelFromCSV(FlatItemModel* model, QIODevice* device, const QMa
                 v = cell_text.replace("\"\"", "\"").simplified();
             }
 
-            model->setData(model->rowCount() - 1, i.value(), v);
+            loaded->setData(row, i.value(), v);
         }
-
-        model->appendRow();
     }
 
+    model->moveRowsData(loaded.release());
+
     return Error();
 }
 
@@ -233,6 +233,9 @@ enum class DatabaseObjectOption
     AllowSaveNotDatached = 0x0080,
     //! Не содержит данных (не надо грузить из БД). Несовместимо с CustomLoad
     Dummy = 0x0100,
+    /*! Хранить загруженные данные в локальном кэше между запусками программы
+     * При загрузке данные из кэша отдаются сразу, после чего в фоне выполняется перезагрузка из БД */
+    LocalCache = 0x0200,
 };
 Q_ENUM_NS(DatabaseObjectOption)
 Q_DECLARE_FLAGS(DatabaseObjectOptions, DatabaseObjectOption)
@@ -267,6 +270,8 @@ Q_DECLARE_FLAGS(HighlightDialogOptions, HighlightDialogOption)
 //! Свойства загрузки из БД
 enum class LoadOption
 {
+    //! Не использовать локальный кэш (DatabaseObjectOption::LocalCache)
+    IgnoreLocalCache = 0x0001,
 };
 Q_ENUM_NS(LoadOption)
 Q_DECLARE_FLAGS(LoadOptions, LoadOption)
@@ -809,6 +814,8 @@ enum class SharedObjectEventType
     DetachedCloned = 10,
     Destroy = 11,
     DestroyDetached = 12,
+    //! Вытеснен из кэша при превышении лимита памяти
+    EvictFromCache = 13,
 };
 Q_ENUM_NS(SharedObjectEventType)
 
@@ -1367,6 +1374,7 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(zf::InformationTypes);
 Q_DECLARE_OPERATORS_FOR_FLAGS(zf::DataTypes);
 Q_DECLARE_OPERATORS_FOR_FLAGS(zf::PropertyOptions);
 Q_DECLARE_OPERATORS_FOR_FLAGS(zf::DatabaseObjectOptions);
+Q_DECLARE_OPERATORS_FOR_FLAGS(zf::LoadOptions);
 Q_DECLARE_OPERATORS_FOR_FLAGS(zf::ModuleDataOptions);
 Q_DECLARE_OPERATORS_FOR_FLAGS(zf::XML_ParserOptions);
 Q_DECLARE_OPERATORS_FOR_FLAGS(zf::XML_DocProperties);
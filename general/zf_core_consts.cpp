@@ -31,6 +31,8 @@ const QString Consts::CORE_INTERNAL_CODE = "metastaff";
 const QString Consts::CORE_DEV_CODE = "core";
 //! Разделитель при выводе в CSV файлы
 const QChar Consts::CSV_SEPARATOR = ';';
+//! Размер буфера (символов) при выводе в CSV файлы
+const int Consts::CSV_BUFFER_SIZE = 1024 * 1024;
 
 /*! Роль в которой хранится уникальный идентификатор строки набора данных. Для хранения выбирается колонка с
  * минимальным номером */
@@ -38,6 +40,8 @@ const int Consts::UNIQUE_ROW_COLUMN_ROLE = Qt::UserRole + USHRT_MAX;
 
 //! Версия QDataStream
 const QDataStream::Version Consts::DATASTREAM_VERSION = QDataStream::Qt_5_12;
+//! Размер сериализованного сообщения (байт), начиная с которого оно сжимается
+const int Consts::MESSAGE_COMPRESS_THRESHOLD = 16 * 1024;
 
 //! Символ для подсчета размера строки (N)
 const QChar Consts::AVERAGE_CHAR = 'N';
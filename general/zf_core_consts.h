@@ -48,6 +48,8 @@ public:
 
     //! Версия QDataStream
     static const QDataStream::Version DATASTREAM_VERSION; // QDataStream::Qt_5_14
+    //! Размер сериализованного сообщения (байт), начиная с которого оно сжимается
+    static const int MESSAGE_COMPRESS_THRESHOLD;
 
     //! Символ для подсчета размера строки (N)
     static const QChar AVERAGE_CHAR;
@@ -67,6 +69,8 @@ public:
 
     //! Разделитель при выводе в CSV файлы
     static const QChar CSV_SEPARATOR;
+    //! Размер буфера (символов) при выводе в CSV файлы. При его заполнении данные кодируются и записываются за один раз
+    static const int CSV_BUFFER_SIZE;
 };
 
 //! Команды модулей
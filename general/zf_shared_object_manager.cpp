@@ -15,6 +15,7 @@ SharedObjectManager::SharedObjectManager(const QMap<int, int>& cache_config, int
 SharedObjectManager::~SharedObjectManager()
 {
     blockCache();
+    _destroying = true;
 
     //   отключено, т.к. во первых не нужно т.к. и так все очистится при завершении программы, а во вторых вызывает виртуальный метод, который уже вызвать нельзя
     //    _hash.clear();
@@ -77,6 +78,14 @@ QList<QObjectPtr> SharedObjectManager::activeObjects() const
     return res;
 }
 
+bool SharedObjectManager::isObjectAvailable(const Uid& uid) const
+{
+    Z_CHECK(Utils::isMainThread());
+    // QCache::object меняет порядок вытеснения, поэтому проверяем по учету памяти: он ведется для всех объектов, полностью
+    // перемещенных в кэш
+    return validHashItem(uid) != nullptr || _cache_memory.contains(uid);
+}
+
 void SharedObjectManager::clearCache()
 {
     for (auto i = _cache.constBegin(); i != _cache.constEnd(); ++i) {
@@ -111,6 +120,7 @@ void SharedObjectManager::clearCache(const Uid& uid)
         if (info != nullptr) {
             if ((*info)->object() != nullptr) {
                 writeHistory(SharedObjectEventType::RemoveFromCache, uid);
+                unregisterCacheMemory(uid);
                 (*info)->clear();
             }
         }
@@ -134,10 +144,55 @@ int SharedObjectManager::cacheSize(int object_type) const
 
 void SharedObjectManager::disableCache(int object_type)
 {
+    auto cache = _cache.value(object_type);
+    if (cache) {
+        // объекты удаляются не из-за вытеснения
+        const QList<Uid> keys = cache->keys();
+        for (const Uid& uid : keys) {
+            unregisterCacheMemory(uid);
+        }
+    }
+
     _cache.remove(object_type);
     _cache_config[object_type] = 0;
 }
 
+SharedObjectManager::CacheStatistics SharedObjectManager::cacheStatistics(int object_type) const
+{
+    return _cache_statistics.value(object_type);
+}
+
+QMap<int, SharedObjectManager::CacheStatistics> SharedObjectManager::cacheStatistics() const
+{
+    return _cache_statistics;
+}
+
+void SharedObjectManager::resetCacheStatistics()
+{
+    for (auto i = _cache_statistics.begin(); i != _cache_statistics.end(); ++i) {
+        i.value().hits = 0;
+        i.value().misses = 0;
+        i.value().evictions = 0;
+    }
+}
+
+void SharedObjectManager::setCacheMemoryLimit(qint64 bytes)
+{
+    Z_CHECK(bytes >= 0);
+    _cache_memory_limit = bytes;
+    shrinkCacheMemory();
+}
+
+qint64 SharedObjectManager::cacheMemoryLimit() const
+{
+    return _cache_memory_limit;
+}
+
+qint64 SharedObjectManager::cacheMemorySize() const
+{
+    return _cache_memory_size;
+}
+
 const QContiguousCache<QPair<SharedObjectEventType, Uid>>& SharedObjectManager::history() const
 {
     return _history;
@@ -148,10 +203,17 @@ void SharedObjectManager::prepareSharedPointerObject(const std::shared_ptr<QObje
     Q_UNUSED(object);
 }
 
+qint64 SharedObjectManager::objectMemorySize(QObject* object) const
+{
+    Q_UNUSED(object);
+    return 0;
+}
+
 void SharedObjectManager::removeObject(const Uid& uid)
 {
     blockCache();
     _hash.remove(uid);
+    _cache_reused.remove(uid);
     clearCache(uid);
     writeHistory(SharedObjectEventType::RemoveFromStorage, uid);
     unBlockCache();
@@ -186,7 +248,18 @@ QObjectPtr SharedObjectManager::getObject(const Uid& uid, bool is_detached, bool
         // создаем элемент хэша
         ObjectHashInfoPtr new_hash_item = (is_detached || !is_main_thread) ? nullptr : Z_MAKE_SHARED(ObjectHashInfo);
         // ищем в кэше
-        ObjectCacheInfo* cache_item = is_temporary || is_detached || !is_main_thread ? nullptr : validCacheItem(uid);
+        bool use_cache = !is_temporary && !is_detached && is_main_thread;
+        ObjectCacheInfo* cache_item = use_cache ? validCacheItem(uid) : nullptr;
+        if (use_cache) {
+            int type = extractType(uid);
+            if (_cache_config.value(type, _default_cache_size) > 0) {
+                if (cache_item != nullptr)
+                    _cache_statistics[type].hits++;
+                else
+                    _cache_statistics[type].misses++;
+            }
+        }
+
         if (cache_item != nullptr) {
             // забираем из кэша как есть
             result_object = takeFromCache(uid);
@@ -233,8 +306,16 @@ void SharedObjectManager::markAsTemporary(QObject* object) const
     Q_UNUSED(object)
 }
 
+void SharedObjectManager::onObjectEvent(SharedObjectEventType type, const Uid& uid) const
+{
+    Q_UNUSED(type)
+    Q_UNUSED(uid)
+}
+
 void SharedObjectManager::writeHistory(SharedObjectEventType type, const Uid& uid1, const Uid& uid2) const
 {
+    onObjectEvent(type, uid1);
+
     if (_history.capacity() == 0)
         return;
 
@@ -336,6 +417,7 @@ void SharedObjectManager::noReferenceObject(QObject* object) const
         writeHistory(SharedObjectEventType::Remove, uid);
 
         _hash.remove(uid);
+        _cache_reused.remove(uid);
 
         if (cache_item != nullptr)
             cache->remove(uid);
@@ -348,7 +430,7 @@ void SharedObjectManager::noReferenceObject(QObject* object) const
 
     // помещаем в кэш
     if (cache_item == nullptr) {
-        cache_item = new ObjectCacheInfoPtr(Z_MAKE_SHARED(ObjectCacheInfo));
+        cache_item = new ObjectCacheInfoPtr(Z_MAKE_SHARED(ObjectCacheInfo, this, uid, extractType(uid)));
 
 #ifdef RNIKULENKOV
         if (cache->count() == cache->maxCost() && !cache->contains(uid))
@@ -371,6 +453,7 @@ void SharedObjectManager::noReferenceObject(QObject* object) const
     if ((*cache_item)->object() != nullptr) {
         // полностью перемещено в кэш
         _hash.remove(uid);
+        registerCacheMemory(uid, extractType(uid), objectMemorySize(object));
     }
 
     unBlockCache();
@@ -425,6 +508,9 @@ QObjectPtr SharedObjectManager::takeFromCache(const Uid& uid) const
     if (cache_item != nullptr) {
         Z_CHECK_NULL(cache_item->object());
         object = *(cache_item->object());
+        // повторно использованный объект при возврате в кэш попадет в защищенную от вытеснения часть
+        unregisterCacheMemory(uid);
+        _cache_reused << uid;
         _cache.value(extractType(uid))->remove(uid);
         writeHistory(SharedObjectEventType::TakeFromCache, uid);
 
@@ -436,7 +522,103 @@ QObjectPtr SharedObjectManager::takeFromCache(const Uid& uid) const
     return object;
 }
 
-SharedObjectManager::ObjectCacheInfo::ObjectCacheInfo()
+void SharedObjectManager::registerCacheMemory(const Uid& uid, int type, qint64 size) const
+{
+    Z_CHECK(size >= 0);
+    unregisterCacheMemory(uid);
+
+    _cache_memory[uid] = {type, size};
+    _cache_memory_size += size;
+
+    auto& statistics = _cache_statistics[type];
+    statistics.count++;
+    statistics.memory_size += size;
+
+    if (_cache_reused.remove(uid))
+        _cache_protected << uid;
+    else
+        _cache_probation << uid;
+
+    shrinkCacheMemory();
+}
+
+bool SharedObjectManager::unregisterCacheMemory(const Uid& uid) const
+{
+    auto info = _cache_memory.find(uid);
+    if (info == _cache_memory.end())
+        return false;
+
+    _cache_memory_size -= info->size;
+
+    auto& statistics = _cache_statistics[info->type];
+    statistics.count--;
+    statistics.memory_size -= info->size;
+
+    _cache_memory.erase(info);
+
+    if (!_cache_probation.removeOne(uid))
+        _cache_protected.removeOne(uid);
+
+    return true;
+}
+
+void SharedObjectManager::cacheItemReleased(const Uid& uid, int type) const
+{
+    if (_destroying)
+        return;
+
+    // учет памяти не был снят - значит QCache вытеснил объект по количеству
+    if (unregisterCacheMemory(uid))
+        _cache_statistics[type].evictions++;
+}
+
+void SharedObjectManager::shrinkCacheMemory() const
+{
+    if (_cache_memory_limit <= 0 || _cache_memory_size <= _cache_memory_limit)
+        return;
+
+    // повторно используемые объекты не должны занимать больше 3/4 лимита, иначе наиболее старые из них
+    // становятся первыми кандидатами на вытеснение
+    qint64 protected_size = 0;
+    for (const Uid& uid : qAsConst(_cache_protected)) {
+        protected_size += _cache_memory.value(uid).size;
+    }
+    while (protected_size > _cache_memory_limit / 4 * 3 && !_cache_protected.isEmpty()) {
+        Uid uid = _cache_protected.takeFirst();
+        protected_size -= _cache_memory.value(uid).size;
+        _cache_probation.prepend(uid);
+    }
+
+    while (_cache_memory_size > _cache_memory_limit) {
+        Uid uid;
+        if (!_cache_probation.isEmpty())
+            uid = _cache_probation.first();
+        else if (!_cache_protected.isEmpty())
+            uid = _cache_protected.first();
+        else
+            break;
+
+        int type = _cache_memory.value(uid).type;
+        _cache_statistics[type].evictions++;
+        unregisterCacheMemory(uid);
+        writeHistory(SharedObjectEventType::EvictFromCache, uid);
+
+        blockCache();
+        auto cache = _cache.value(type);
+        if (cache) {
+            ObjectCacheInfoPtr* info = cache->object(uid);
+            if (info != nullptr)
+                (*info)->clear();
+            cache->remove(uid);
+        }
+        unBlockCache();
+    }
+}
+
+SharedObjectManager::ObjectCacheInfo::ObjectCacheInfo(const SharedObjectManager* manager, const Uid& uid, int type)
+    : _manager(manager)
+    , _uid(uid)
+    , _type(type)
 {
 }
 
@@ -450,6 +632,9 @@ void SharedObjectManager::ObjectCacheInfo::clear()
     if (_object != nullptr) {
         delete _object;
         _object = nullptr;
+
+        if (_manager != nullptr)
+            _manager->cacheItemReleased(_uid, _type);
     }
 }
 
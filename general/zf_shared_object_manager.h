@@ -74,6 +74,8 @@ public:
 
     //! Получить список используемых объектов
     QList<QObjectPtr> activeObjects() const;
+    //! Объект используется или находится в кэше. Не влияет на порядок вытеснения из кэша
+    bool isObjectAvailable(const Uid& uid) const;
 
     //! Очистить кэш полностью
     void clearCache();
@@ -89,6 +91,35 @@ public:
     //! Запретить кэширование для данного типа сущностей
     void disableCache(int object_type);
 
+    //! Статистика кэша
+    struct CacheStatistics
+    {
+        //! Объект взят из кэша
+        qint64 hits = 0;
+        //! Объекта не было в кэше
+        qint64 misses = 0;
+        //! Объект вытеснен из кэша (по количеству или лимиту памяти)
+        qint64 evictions = 0;
+        //! Количество объектов в кэше
+        int count = 0;
+        //! Оценка памяти, занимаемой объектами в кэше (байт)
+        qint64 memory_size = 0;
+    };
+    //! Статистика кэша для объектов определенного типа
+    CacheStatistics cacheStatistics(int object_type) const;
+    //! Статистика кэша по всем типам объектов. Ключ - тип объекта
+    QMap<int, CacheStatistics> cacheStatistics() const;
+    //! Сбросить счетчики статистики кэша
+    void resetCacheStatistics();
+
+    /*! Ограничение памяти для всех кэшей (байт). 0 - без ограничений.
+     * При превышении вытесняются в первую очередь объекты, которые ни разу не брались из кэша повторно,
+     * затем наиболее давно использованные из остальных */
+    void setCacheMemoryLimit(qint64 bytes);
+    qint64 cacheMemoryLimit() const;
+    //! Оценка памяти, занимаемой всеми объектами в кэше (байт)
+    qint64 cacheMemorySize() const;
+
     //! История последних операций для отладки
     const QContiguousCache<QPair<SharedObjectEventType, Uid>>& history() const;
 
@@ -115,6 +146,10 @@ protected:
     virtual void markAsTemporary(QObject* object) const;
     //! Можно ли разделять объект между потоками
     virtual bool isShareBetweenThreads(const Uid& uid) const = 0;
+    //! Оценка памяти, занимаемой объектом (байт). Вызывается при помещении объекта в кэш. 0 - неизвестно
+    virtual qint64 objectMemorySize(QObject* object) const;
+    //! Вызывается при каждой операции с объектом, независимо от размера буфера history
+    virtual void onObjectEvent(SharedObjectEventType type, const Uid& uid) const;
 
     //! Удалить объект из хэша и кэша
     void removeObject(const Uid& uid);
@@ -146,7 +181,7 @@ private:
     //! Информация по кэшируемым моделям
     struct ObjectCacheInfo
     {
-        ObjectCacheInfo();
+        ObjectCacheInfo(const SharedObjectManager* manager, const Uid& uid, int type);
         ~ObjectCacheInfo();
 
         void clear();
@@ -155,6 +190,9 @@ private:
 
     private:
         QObjectPtr* _object = nullptr;
+        const SharedObjectManager* _manager = nullptr;
+        Uid _uid;
+        int _type = 0;
     };
     typedef std::shared_ptr<SharedObjectManager::ObjectCacheInfo> ObjectCacheInfoPtr;
     typedef QCache<Uid, SharedObjectManager::ObjectCacheInfoPtr> ObjectCache;
@@ -175,12 +213,45 @@ private:
     //! Забрать объект из кэша. Если нет в кэше, то возвращает nullptr
     QObjectPtr takeFromCache(const Uid& uid) const;
 
+    //! Учесть память объекта, помещенного в кэш, и вытеснить лишнее при превышении лимита
+    void registerCacheMemory(const Uid& uid, int type, qint64 size) const;
+    //! Перестать учитывать память объекта. Возвращает false, если объект не учитывался
+    bool unregisterCacheMemory(const Uid& uid) const;
+    //! Объект удален из кэша через ObjectCacheInfo::clear. Если учет памяти не был снят заранее, то объект вытеснен QCache
+    void cacheItemReleased(const Uid& uid, int type) const;
+    //! Вытеснить объекты при превышении лимита памяти
+    void shrinkCacheMemory() const;
+
     //! Используемые в настоящий момент объекты
     mutable QHash<Uid, ObjectHashInfoPtr> _hash;
     //! Какие типы объектов надо кэшировать. Ключ - тип объекта, значение - количество объектов в кэше
     QMap<int, int> _cache_config;
     //! Размер кэша по умолчанию
     int _default_cache_size;
+
+    //! Учет памяти объекта в кэше
+    struct CacheMemoryInfo
+    {
+        int type = 0;
+        qint64 size = 0;
+    };
+    //! Объекты в кэше с оценкой памяти. Объявлено до _cache, т.к. при удалении _cache вызывается cacheItemReleased
+    mutable QHash<Uid, CacheMemoryInfo> _cache_memory;
+    //! Порядок вытеснения объектов, которые ни разу не брались из кэша повторно. В начале - самые старые
+    mutable QList<Uid> _cache_probation;
+    //! Порядок вытеснения объектов, которые брались из кэша. В начале - самые старые
+    mutable QList<Uid> _cache_protected;
+    //! Объекты, взятые из кэша и еще не вернувшиеся в него
+    mutable QSet<Uid> _cache_reused;
+    //! Оценка памяти всех объектов в кэше
+    mutable qint64 _cache_memory_size = 0;
+    //! Ограничение памяти для всех кэшей
+    qint64 _cache_memory_limit = 0;
+    //! Статистика по типам объектов
+    mutable QMap<int, CacheStatistics> _cache_statistics;
+    //! Менеджер удаляется
+    bool _destroying = false;
+
     //! Кэш по типу объекта
     mutable QMap<int, std::shared_ptr<ObjectCache>> _cache;
     //! Блокировка помещения в кэш - счетчик
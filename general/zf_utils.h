@@ -38,6 +38,7 @@ class QTabBar;
 class QGridLayout;
 class QNetworkProxy;
 class QCollator;
+class QTextEncoder;
 class SimpleCrypt;
 
 namespace QtCharts
@@ -1686,6 +1687,8 @@ public:
     //! Получить значение на указанном языке
     static QVariant valueToLanguage(const LanguageMap* value, QLocale::Language language);
     static QVariant valueToLanguage(const LanguageMap& value, QLocale::Language language);
+    //! Найти значение на указанном языке без копирования. Если не найдено - nullptr
+    static const QVariant* findValueToLanguage(const LanguageMap* value, QLocale::Language language);
 
 private:
     //! Поиск layout в котором находится виджет
@@ -1720,10 +1723,16 @@ private:
         const QAbstractItemModel* source, QAbstractItemModel* destination, const QModelIndex& source_index, const QModelIndex& destination_index);
 
     //! Выгрузка модели в CSV
-    static void itemModelToCSV_helper(const QAbstractItemModel* model, QIODevice* device, const QMap<int, QString>& hMap, QTextCodec* codec,
-        const I_DatasetVisibleInfo* visible_info, const QModelIndex& parent,
+    static Error itemModelToCSV_helper(const QAbstractItemModel* model, QIODevice* device, const QMap<int, QString>& hMap,
+        QTextEncoder* encoder, const I_DatasetVisibleInfo* visible_info, const QModelIndex& parent,
         //! Выгружать идентификаторы как есть, без преобразования в визуальный формат
-        bool original_uid, int timeout_ms);
+        bool original_uid, int timeout_ms,
+        //! Накопленный текст. Кодируется и записывается при превышении Consts::CSV_BUFFER_SIZE
+        QString& buffer);
+    //! Закодировать накопленный текст и записать его в устройство одним вызовом
+    static Error flushCSVBuffer(QIODevice* device, QTextEncoder* encoder, QString& buffer,
+        //! Записывать независимо от размера буфера
+        bool force);
     //! Выгрузка модели в Excel
     static void itemModelToExcel_helper(const QAbstractItemModel* model, QXlsx::Worksheet* workbook, const I_DatasetVisibleInfo* visible_info, int& export_row,
         const QMap<int, QPair<QString, int>>& hMap, const QModelIndex& parent,
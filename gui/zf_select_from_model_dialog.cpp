@@ -9,6 +9,7 @@
 #include "zf_callback.h"
 #include "zf_translation.h"
 #include "zf_i_cell_column_check.h"
+#include "zf_fuzzy_search_index.h"
 
 #include <QClipboard>
 #include <QMovie>
@@ -56,6 +57,28 @@ public:
         bool& exclude_hierarchy) const override;
     //! Уникальный ключ строки
     RowID getRowID(int source_row, const QModelIndex& source_parent) const override;
+    //! При фильтрации строки упорядочиваются по убыванию схожести с текстом фильтра внутри выбранной сортировки
+    bool lessThan(const QModelIndex& source_left, const QModelIndex& source_right) const override;
+    //! Сортировка, выбранная пользователем
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    //! Тексты колонок фильтрации для строки. Возвращает false, если данные для расшифровки еще не загружены
+    bool filterTexts(int source_row, const QModelIndex& source_parent, QStringList& texts) const;
+
+    //! Подготовить индекс нечеткого поиска (строится один раз, затем обновляется по сигналам модели)
+    void updateSearchIndex();
+    //! Очистить индекс нечеткого поиска. Будет построен заново при следующей фильтрации
+    void clearSearchIndex();
+    //! Добавить в индекс строки родителя и их дочерние строки
+    void indexRows(const QModelIndex& source_parent, int first, int last);
+    //! Добавить или обновить строку в индексе
+    void indexRow(int source_row, const QModelIndex& source_parent);
+    //! Удалить из индекса строки родителя и их дочерние строки
+    void unindexRows(const QModelIndex& source_parent, int first, int last);
+    //! Схожесть строки с текстом фильтра
+    double searchRate(const QModelIndex& source_index) const;
+    //! Ключ строки в индексе нечеткого поиска
+    QPersistentModelIndex searchKey(int source_row, const QModelIndex& source_parent) const;
 
     //! Заголовок с отображаемой информацией
     QHeaderView* _header_view;
@@ -88,6 +111,27 @@ public:
     QList<QAbstractProxyModel*> _external_proxy_chain;
 
     QAbstractItemModel* _source_item_model = nullptr;
+
+    //! Индекс нечеткого поиска по колонкам фильтрации
+    FuzzySearchIndex _search_index;
+    //! Индекс построен
+    bool _search_index_ready = false;
+    //! Скрытые колонки фильтрации на момент построения индекса
+    QList<bool> _search_hidden_columns;
+    /*! Соответствие строки и идентификатора записи в индексе. RowID не подходит: без DataFilter он позиционный и
+     * сдвигается при вставке и удалении строк */
+    QHash<QPersistentModelIndex, int> _search_ids;
+    //! Следующий свободный идентификатор записи в индексе
+    int _search_next_id = 0;
+    //! Строки, которые не удалось проиндексировать, т.к. не были загружены данные для расшифровки
+    QList<QPersistentModelIndex> _search_pending;
+    //! Результат поиска для текущего текста фильтра: идентификатор записи в индексе - схожесть
+    QHash<int, double> _search_rates;
+    //! Колонка сортировки не выбрана и строки упорядочены только по схожести
+    bool _is_rate_sort = false;
+
+    //! Минимальная схожесть строки с текстом фильтра
+    static const int _search_min_rate = 75;
 };
 
 SelectionProxyItemModel::SelectionProxyItemModel(QHeaderView* header_view, View* view, const QList<int>& filter_columns_pos,
@@ -162,6 +206,26 @@ SelectionProxyItemModel::SelectionProxyItemModel(QHeaderView* header_view, View*
     if (_view != nullptr)
         _item_view = _view->object<QAbstractItemView>(_dataset_property);
 
+    // индекс поиска должен обновляться раньше, чем прокси начнет фильтрацию по сигналам модели, поэтому подключаемся до setSourceModel
+    connect(_source_item_model, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex& top_left, const QModelIndex& bottom_right) {
+        if (!_search_index_ready)
+            return;
+        for (int row = top_left.row(); row <= bottom_right.row(); row++) {
+            indexRow(row, top_left.parent());
+        }
+    });
+    connect(_source_item_model, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex& parent, int first, int last) {
+        if (_search_index_ready)
+            indexRows(parent, first, last);
+    });
+    connect(_source_item_model, &QAbstractItemModel::rowsAboutToBeRemoved, this, [this](const QModelIndex& parent, int first, int last) {
+        if (_search_index_ready)
+            unindexRows(parent, first, last);
+    });
+    connect(_source_item_model, &QAbstractItemModel::modelReset, this, [this]() { clearSearchIndex(); });
+    connect(_source_item_model, &QAbstractItemModel::layoutChanged, this, [this]() { clearSearchIndex(); });
+    connect(_source_item_model, &QAbstractItemModel::rowsMoved, this, [this]() { clearSearchIndex(); });
+
     setUseCache(true);
     setSourceModel(_source_item_model);
 }
@@ -182,10 +246,38 @@ void SelectionProxyItemModel::setFilterText(const QString& filter_text)
     _filter_text = f;
     beginResetModel();
     resetCache();
+
+    _search_rates.clear();
+    if (!_filter_text.isEmpty()) {
+        updateSearchIndex();
+        auto matches = _search_index.search(_filter_text, _search_min_rate);
+        _search_rates.reserve(matches.count());
+        for (auto& m : qAsConst(matches)) {
+            _search_rates[m.id] = m.rate;
+        }
+    }
+
     endResetModel();
 
     //    invalidateFilter();
 
+    if (_filter_text.isEmpty()) {
+        // возвращаем порядок модели, если сортировку по схожести включали сами
+        if (_is_rate_sort) {
+            _is_rate_sort = false;
+            LeafFilterProxyModel::sort(-1);
+        }
+
+    } else if (_is_rate_sort || sortColumn() < 0) {
+        // колонка сортировки не выбрана - упорядочиваем только по схожести
+        _is_rate_sort = true;
+        LeafFilterProxyModel::sort(0);
+
+    } else {
+        // сохраняем выбранную сортировку, схожесть учитывается только при равенстве значений
+        LeafFilterProxyModel::sort(sortColumn(), sortOrder());
+    }
+
     _is_filtering = false;
 }
 
@@ -226,7 +318,36 @@ bool SelectionProxyItemModel::filterAcceptsRowItself(int source_row, const QMode
     if (_filter_text.isEmpty())
         return true;
 
-    bool all_false = true;
+    int search_id = _search_ids.value(searchKey(source_row, source_parent), -1);
+    if (search_id >= 0) {
+        if (!_search_rates.contains(search_id))
+            return false;
+
+    } else {
+        // строка не проиндексирована (не загружены данные для расшифровки) - ищем вхождение текста напрямую
+        QStringList texts;
+        if (!filterTexts(source_row, source_parent, texts))
+            return false;
+
+        bool all_false = true;
+        for (auto& converted : qAsConst(texts)) {
+            if (converted.contains(_filter_text, Qt::CaseInsensitive)) {
+                all_false = false;
+                break;
+            }
+        }
+
+        if (all_false)
+            return false;
+    }
+
+    return LeafFilterProxyModel::filterAcceptsRowItself(source_row, source_parent, exclude_hierarchy);
+}
+
+bool SelectionProxyItemModel::filterTexts(int source_row, const QModelIndex& source_parent, QStringList& texts) const
+{
+    texts.clear();
+
     QVariant value;
     QString converted;
     for (int i = 0; i < _filter_columns_pos.count(); i++) {
@@ -250,16 +371,145 @@ bool SelectionProxyItemModel::filterAcceptsRowItself(int source_row, const QMode
             converted = value.toString().trimmed();
         }
 
-        if (converted.contains(_filter_text, Qt::CaseInsensitive)) {
-            all_false = false;
-            break;
+        texts << converted;
+    }
+
+    return true;
+}
+
+bool SelectionProxyItemModel::lessThan(const QModelIndex& source_left, const QModelIndex& source_right) const
+{
+    if (_filter_text.isEmpty())
+        return LeafFilterProxyModel::lessThan(source_left, source_right);
+
+    if (!_is_rate_sort) {
+        if (LeafFilterProxyModel::lessThan(source_left, source_right))
+            return true;
+        if (LeafFilterProxyModel::lessThan(source_right, source_left))
+            return false;
+    }
+
+    double left_rate = searchRate(source_left);
+    double right_rate = searchRate(source_right);
+    if (left_rate != right_rate) {
+        // при обратной сортировке Qt инвертирует результат, а наиболее похожие строки должны оставаться первыми
+        return (sortOrder() == Qt::AscendingOrder || _is_rate_sort) ? left_rate > right_rate : left_rate < right_rate;
+    }
+
+    // при равной схожести сохраняем порядок модели
+    return source_left.row() < source_right.row();
+}
+
+void SelectionProxyItemModel::sort(int column, Qt::SortOrder order)
+{
+    _is_rate_sort = false;
+    LeafFilterProxyModel::sort(column, order);
+}
+
+double SelectionProxyItemModel::searchRate(const QModelIndex& source_index) const
+{
+    int search_id = _search_ids.value(searchKey(source_index.row(), source_index.parent()), -1);
+    // непроиндексированные строки видны только при точном вхождении текста
+    return search_id < 0 ? 100 : _search_rates.value(search_id, 0);
+}
+
+void SelectionProxyItemModel::updateSearchIndex()
+{
+    QList<bool> hidden_columns;
+    for (int pos : qAsConst(_filter_columns_pos)) {
+        hidden_columns << _header_view->isSectionHidden(pos);
+    }
+
+    if (_search_index_ready && hidden_columns == _search_hidden_columns) {
+        // дозаполняем строки, для которых ранее не были загружены данные
+        auto pending = _search_pending;
+        _search_pending.clear();
+        for (auto& index : qAsConst(pending)) {
+            if (index.isValid())
+                indexRow(index.row(), index.parent());
+        }
+        return;
+    }
+
+    clearSearchIndex();
+    _search_hidden_columns = hidden_columns;
+    _search_index_ready = true;
+    indexRows(QModelIndex(), 0, _source_item_model->rowCount() - 1);
+}
+
+void SelectionProxyItemModel::clearSearchIndex()
+{
+    _search_index_ready = false;
+    _search_index.clear();
+    _search_ids.clear();
+    _search_pending.clear();
+    _search_next_id = 0;
+}
+
+void SelectionProxyItemModel::indexRows(const QModelIndex& source_parent, int first, int last)
+{
+    for (int row = first; row <= last; row++) {
+        indexRow(row, source_parent);
+
+        QModelIndex index = _source_item_model->index(row, 0, source_parent);
+        int child_count = _source_item_model->rowCount(index);
+        if (child_count > 0)
+            indexRows(index, 0, child_count - 1);
+    }
+}
+
+void SelectionProxyItemModel::indexRow(int source_row, const QModelIndex& source_parent)
+{
+    QPersistentModelIndex row_id = searchKey(source_row, source_parent);
+
+    QStringList texts;
+    if (!filterTexts(source_row, source_parent, texts)) {
+        // строка будет проиндексирована при следующей фильтрации
+        if (_search_ids.contains(row_id)) {
+            int search_id = _search_ids.take(row_id);
+            _search_index.removeRecord(search_id);
+            _search_rates.remove(search_id);
         }
+        _search_pending << row_id;
+        return;
     }
 
-    if (all_false)
-        return false;
+    int search_id = _search_ids.value(row_id, -1);
+    if (search_id < 0) {
+        search_id = _search_next_id++;
+        _search_ids[row_id] = search_id;
+    }
+    _search_index.setRecord(search_id, texts);
 
-    return LeafFilterProxyModel::filterAcceptsRowItself(source_row, source_parent, exclude_hierarchy);
+    if (!_filter_text.isEmpty()) {
+        double rate = _search_index.recordRate(search_id, _filter_text, _search_min_rate);
+        if (rate > 0)
+            _search_rates[search_id] = rate;
+        else
+            _search_rates.remove(search_id);
+    }
+}
+
+void SelectionProxyItemModel::unindexRows(const QModelIndex& source_parent, int first, int last)
+{
+    for (int row = first; row <= last; row++) {
+        QModelIndex index = _source_item_model->index(row, 0, source_parent);
+        int child_count = _source_item_model->rowCount(index);
+        if (child_count > 0)
+            unindexRows(index, 0, child_count - 1);
+
+        QPersistentModelIndex row_id = searchKey(row, source_parent);
+        if (_search_ids.contains(row_id)) {
+            int search_id = _search_ids.take(row_id);
+            _search_index.removeRecord(search_id);
+            _search_rates.remove(search_id);
+        }
+    }
+}
+
+QPersistentModelIndex SelectionProxyItemModel::searchKey(int source_row, const QModelIndex& source_parent) const
+{
+    return QPersistentModelIndex(_source_item_model->index(source_row, 0, source_parent));
 }
 
 RowID SelectionProxyItemModel::getRowID(int source_row, const QModelIndex& source_parent) const
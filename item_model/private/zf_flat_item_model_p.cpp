@@ -226,6 +226,17 @@ LanguageMap _FlatIndexData::values(int role) const
     return {};
 }
 
+const QVariant* _FlatIndexData::value(int role, QLocale::Language language) const
+{
+    for (auto i = _data.cbegin(); i != _data.cend(); ++i) {
+        if ((*i)->role != role)
+            continue;
+        return (*i)->findValue(language);
+    }
+
+    return nullptr;
+}
+
 void _FlatIndexData::remove(int role)
 {
     for (int i = 0; i < _data.size(); ++i) {
@@ -321,7 +332,8 @@ QMap<int, QVariant> _FlatIndexData::toMap(QLocale::Language language) const
     QMap<int, QVariant> res;
 
     for (auto i = _data.cbegin(); i != _data.cend(); ++i) {
-        res[(*i)->role] = Utils::valueToLanguage((*i)->toLanguageMap(), language);
+        const QVariant* v = (*i)->findValue(language);
+        res[(*i)->role] = (v == nullptr ? QVariant() : *v);
     }
 
     return res;
@@ -773,6 +785,17 @@ QVariant* _FlatIndexDataValues::getValue(QLocale::Language language) const
     return nullptr;
 }
 
+const QVariant* _FlatIndexDataValues::findValue(QLocale::Language language) const
+{
+    // единственное значение возвращается для любого языка (аналогично Utils::valueToLanguage)
+    if (single_value != nullptr)
+        return single_value;
+    if (multi_values != nullptr)
+        return Utils::findValueToLanguage(multi_values, language);
+
+    return nullptr;
+}
+
 void _FlatIndexDataValues::setValue(QLocale::Language lang, const QVariant& value)
 {
     if (multi_values != nullptr) {
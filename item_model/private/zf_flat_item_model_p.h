@@ -16,6 +16,8 @@ struct _FlatIndexDataValues
     ~_FlatIndexDataValues();
 
     QVariant* getValue(QLocale::Language language) const;
+    //! Значение для указанного языка с учетом правил Utils::valueToLanguage. Без копирования данных
+    const QVariant* findValue(QLocale::Language language) const;
     void setValue(QLocale::Language lang, const QVariant& value);
     void setValues(const LanguageMap& v);
 
@@ -44,6 +46,8 @@ public:
     QList<int> roles() const;
 
     LanguageMap values(int role) const;
+    //! Прямой доступ к значению роли на указанном языке без создания LanguageMap. Если значения нет - nullptr
+    const QVariant* value(int role, QLocale::Language language) const;
     void remove(int role);
     //! Возвращает указатель на вектор со списком очищенных ролей или nullptr. За удаление отвечает вызывающий
     QVector<int>* clear(bool take_data);
@@ -94,6 +98,8 @@ public:
     bool hasRowData(int row) const;
     //! Получить строку
     _FlatRowData* getRow(int row) const;
+    //! Получить строку, если под нее выделена память. Иначе nullptr
+    _FlatRowData* findRowData(int row) const { return hasRowData(row) ? _rows.at(row) : nullptr; }
 
     //! Задать количество строк
     void setRowCount(int n);
@@ -192,6 +198,8 @@ public:
 
     //! Получить значение элемента строки
     _FlatIndexData* getData(int column) const;
+    //! Получить значение элемента строки, если под него выделена память. Иначе nullptr
+    _FlatIndexData* findData(int column) const { return column < _data.size() ? _data.at(column) : nullptr; }
     //! Задать количество колонок
     void setColumnCount(int n);
 
@@ -174,10 +174,7 @@ QVariant FlatItemModel::data(const QModelIndex& index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    if (role == Qt::DisplayRole)
-        role = Qt::EditRole;
-
-    return Utils::valueToLanguage(indexData(index)->values(role), _language_force ? *_language_force : _language);
+    return dataInternal(indexData(index), role, _language_force ? *_language_force : _language);
 }
 
 bool FlatItemModel::setData(const QModelIndex& index, const QVariant& value, int role)
@@ -209,7 +206,15 @@ bool FlatItemModel::setData(const QModelIndex& index, const QVariant& value, int
 
 QVariant FlatItemModel::data(int row, int column, int role, const QModelIndex& parent) const
 {
-    return data(index(row, column, parent), role);
+    if (!hasIndex(row, column, parent))
+        return QVariant();
+
+    // не используем index(), чтобы не выделять память под пустые строки и ячейки при чтении
+    _FlatRowData* row_data = getRows(parent)->findRowData(row);
+    if (row_data == nullptr)
+        return QVariant();
+
+    return dataInternal(row_data->findData(column), role, _language_force ? *_language_force : _language);
 }
 
 QVariant FlatItemModel::data(int row, int column, const QModelIndex& parent) const
@@ -950,6 +955,27 @@ void FlatItemModel::moveData(FlatItemModel* source)
     endResetModel();
 }
 
+void FlatItemModel::moveRowsData(FlatItemModel* source)
+{
+    Z_CHECK_NULL(source);
+    Z_CHECK(source != this);
+    Z_CHECK(source->_column_count == _column_count);
+
+    beginResetModel();
+
+    // старые строки и вертикальные заголовки уходят в source и удаляются вместе с ней
+    std::swap(_rows, source->_rows);
+    std::swap(_v_headers, source->_v_headers);
+    _rows->setItemModel(this);
+    source->_rows->setItemModel(source);
+
+    clearMatchCache();
+
+    endResetModel();
+
+    delete source;
+}
+
 QModelIndexList FlatItemModel::match(const QModelIndex& start, int role, const QVariant& value, int hits, Qt::MatchFlags flags) const
 {
     if (!flags.testFlag(Qt::MatchFixedString) || !flags.testFlag(Qt::MatchRecursive) || start.parent().isValid() || start.row() > 0)
@@ -978,18 +1004,10 @@ QModelIndexList FlatItemModel::match(const QModelIndex& start, int role, const Q
 
 QVariant FlatItemModel::dataHelper(const QModelIndex& index, int role, QLocale::Language language) const
 {
-    auto old_lang = _language_force;
-    _language_force = Z_NEW(QLocale::Language, language);
-
-    QVariant value = data(index, role);
-
-    Z_DELETE(_language_force);
-    if (old_lang)
-        _language_force = old_lang;
-    else
-        _language_force = nullptr;
+    if (!index.isValid())
+        return QVariant();
 
-    return value;
+    return dataInternal(indexData(index), role, language);
 }
 
 LanguageMap FlatItemModel::dataHelperLanguageMap(const QModelIndex& index, int role) const
@@ -1178,6 +1196,18 @@ _FlatIndexData* FlatItemModel::indexData(const QModelIndex& index)
     return static_cast<_FlatIndexData*>(index.internalPointer());
 }
 
+QVariant FlatItemModel::dataInternal(const _FlatIndexData* data, int role, QLocale::Language language)
+{
+    if (data == nullptr)
+        return QVariant();
+
+    if (role == Qt::DisplayRole)
+        role = Qt::EditRole;
+
+    const QVariant* value = data->value(role, language);
+    return value == nullptr ? QVariant() : *value;
+}
+
 void FlatItemModel::moveHeaders(Qt::Orientation orientation, int source, int count, int destination)
 {
     int max_count = (orientation == Qt::Vertical ? rowCount() : columnCount());
@@ -1297,7 +1327,8 @@ QVariant FlatRow::data(int column, int role, QLocale::Language language) const
     if (role == Qt::DisplayRole)
         role = Qt::EditRole;
 
-    return Utils::valueToLanguage(_data->getData(column)->values(role), language);
+    const QVariant* value = _data->getData(column)->value(role, language);
+    return value == nullptr ? QVariant() : *value;
 }
 
 bool FlatRow::setData(int column, const QVariant& value, int role, QLocale::Language language)
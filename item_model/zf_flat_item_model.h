@@ -396,6 +396,13 @@ public:
     void moveData(
         //! После выполнения метода указатель source становится недействительным!
         FlatItemModel* source);
+    //! Переместить строки из указанной модели. В отличие от moveData, заголовки колонок, флаги и язык остаются
+    //! текущими. Количество колонок должно совпадать. Модель source при этом УДАЛЯЕТСЯ
+    //! Генерирует сигнал modelReset. Используется для массового заполнения: source заполняется без подписчиков,
+    //! а затем ее строки передаются в эту модель за один раз
+    void moveRowsData(
+        //! После выполнения метода указатель source становится недействительным!
+        FlatItemModel* source);
 
     //! Поиск. В отличие от стандартного поиска добавлено кэширование в случае:
     //! start - корневой индекс, Qt::MatchFixedString и Qt::MatchCaseSensitive
@@ -456,6 +463,8 @@ private:
 
     //! Преобразование индекса в структуру с данными
     static _FlatIndexData* indexData(const QModelIndex& index);
+    //! Чтение значения ячейки без промежуточных копий LanguageMap и выделения памяти
+    static QVariant dataInternal(const _FlatIndexData* data, int role, QLocale::Language language);
 
     //! Перемещение заголовков
     void moveHeaders(Qt::Orientation orientation, int source, int count, int destination);
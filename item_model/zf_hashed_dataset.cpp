@@ -5,9 +5,194 @@
 #include <QAbstractItemModel>
 #include <QDebug>
 #include <QSharedData>
+#include <QtEndian>
+#include <cmath>
+#include <limits>
 
 namespace zf
 {
+HashedDatasetKey::HashedDatasetKey()
+{
+}
+
+HashedDatasetKey::HashedDatasetKey(const HashedDatasetKey& k)
+    : _data(k._data)
+    , _hash(k._hash)
+{
+}
+
+HashedDatasetKey::HashedDatasetKey(const QByteArray& data)
+    : _data(data)
+    , _hash(::qHash(data))
+{
+}
+
+HashedDatasetKey& HashedDatasetKey::operator=(const HashedDatasetKey& k)
+{
+    _data = k._data;
+    _hash = k._hash;
+    return *this;
+}
+
+bool HashedDatasetKey::operator==(const HashedDatasetKey& k) const
+{
+    return _hash == k._hash && _data == k._data;
+}
+
+bool HashedDatasetKey::operator!=(const HashedDatasetKey& k) const
+{
+    return !operator==(k);
+}
+
+bool HashedDatasetKey::isEmpty() const
+{
+    return _data.isEmpty();
+}
+
+uint HashedDatasetKey::hashValue() const
+{
+    return _hash;
+}
+
+HashedDatasetKey HashedDatasetKey::fromValues(const QVariantList& values, const QList<bool>& case_insensitive)
+{
+    Z_CHECK(case_insensitive.isEmpty() || values.count() == case_insensitive.count());
+
+    QByteArray data;
+    data.reserve(values.count() * 12);
+
+    int n = 0;
+    for (auto i = values.constBegin(); i != values.constEnd(); ++i) {
+        appendValue(data, *i, case_insensitive.isEmpty() ? false : case_insensitive.at(n));
+        n++;
+    }
+
+    return HashedDatasetKey(data);
+}
+
+HashedDatasetKey HashedDatasetKey::fromString(const QString& s)
+{
+    if (s.isEmpty())
+        return HashedDatasetKey();
+
+    QByteArray data;
+    appendBytes(data, ValueType::Custom, reinterpret_cast<const char*>(s.constData()), s.size() * static_cast<int>(sizeof(QChar)));
+    return HashedDatasetKey(data);
+}
+
+void HashedDatasetKey::appendValue(QByteArray& data, const QVariant& value, bool case_insensitive)
+{
+    switch (value.userType()) {
+        case QMetaType::UnknownType:
+            data.append(static_cast<char>(ValueType::Null));
+            return;
+
+        case QMetaType::Bool:
+            // логическое выражение FALSE рассматриваем как NULL или пустую строку
+            if (value.toBool())
+                appendText(data, value.toString(), false);
+            else
+                data.append(static_cast<char>(ValueType::Null));
+            return;
+
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::Long:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::ULong:
+        case QMetaType::UChar:
+        case QMetaType::SChar:
+            appendInteger(data, value.toLongLong());
+            return;
+
+        case QMetaType::ULongLong: {
+            quint64 v = value.toULongLong();
+            if (v <= static_cast<quint64>(std::numeric_limits<qint64>::max()))
+                appendInteger(data, static_cast<qint64>(v));
+            else
+                appendText(data, value.toString(), false);
+            return;
+        }
+
+        case QMetaType::Double:
+        case QMetaType::Float: {
+            // целое значение должно совпадать с аналогичным целым числом и его строковым представлением
+            double v = value.toDouble();
+            if (std::isfinite(v) && std::trunc(v) == v && std::fabs(v) < 1e15)
+                appendInteger(data, static_cast<qint64>(v));
+            else
+                appendText(data, value.toString(), false);
+            return;
+        }
+
+        case QMetaType::QString:
+            appendText(data, value.toString(), case_insensitive);
+            return;
+
+        default:
+            break;
+    }
+
+    if (Uid::isUidVariant(value)) {
+        Uid uid = Uid::fromVariant(value);
+        if (!uid.isValid()) {
+            data.append(static_cast<char>(ValueType::Null));
+        } else {
+            // сериализованное значение кэшируется внутри Uid
+            QByteArray serialized = uid.serialize();
+            appendBytes(data, ValueType::Uid, serialized.constData(), serialized.size());
+        }
+        return;
+    }
+
+    appendText(data, value.toString(), case_insensitive);
+}
+
+void HashedDatasetKey::appendText(QByteArray& data, const QString& text, bool case_insensitive)
+{
+    QString s = text.trimmed();
+    if (s.isEmpty()) {
+        data.append(static_cast<char>(ValueType::Null));
+        return;
+    }
+
+    // строковое представление целого числа должно совпадать с самим числом
+    QChar first = s.at(0);
+    if (first.isDigit() || (first == QChar('-') && s.size() > 1)) {
+        bool ok;
+        qint64 v = s.toLongLong(&ok);
+        if (ok && QString::number(v) == s) {
+            appendInteger(data, v);
+            return;
+        }
+    }
+
+    if (case_insensitive)
+        s = s.toLower();
+
+    appendBytes(data, ValueType::String, reinterpret_cast<const char*>(s.constData()), s.size() * static_cast<int>(sizeof(QChar)));
+}
+
+void HashedDatasetKey::appendInteger(QByteArray& data, qint64 value)
+{
+    char bytes[sizeof(qint64)];
+    qToLittleEndian(value, bytes);
+    data.append(static_cast<char>(ValueType::Integer));
+    data.append(bytes, sizeof(qint64));
+}
+
+void HashedDatasetKey::appendBytes(QByteArray& data, ValueType type, const char* bytes, int size)
+{
+    // длина нужна, чтобы последовательность значений однозначно разбиралась на части
+    char size_bytes[sizeof(qint32)];
+    qToLittleEndian(static_cast<qint32>(size), size_bytes);
+    data.append(static_cast<char>(type));
+    data.append(size_bytes, sizeof(qint32));
+    data.append(bytes, size);
+}
+
 HashedDataset::HashedDataset(const QAbstractItemModel* dataset, const QList<int>& keyColumns, const QList<int>& roles)
     : _item_model(dataset)
     , _key_columns(keyColumns)
@@ -93,6 +278,9 @@ bool HashedDataset::isAutoUpdate() const
 void HashedDataset::setAutoUpdate(bool b)
 {
     _is_auto_update = b;
+
+    if (_is_auto_update && _rows_outdated)
+        clear();
 }
 
 QList<int> HashedDataset::keyColumns() const
@@ -134,7 +322,7 @@ Rows HashedDataset::findRows(const QVariantList& values) const
     if (!_hash_generated)
         const_cast<HashedDataset*>(this)->updateHash();
 
-    QString key = generateKey(values);
+    HashedDatasetKey key = generateKey(values);
     if (key.isEmpty())
         return Rows();
     else {
@@ -215,17 +403,26 @@ Rows HashedDataset::findRows(const QVariant& value1, const QVariant& value2, con
 }
 
 Rows HashedDataset::findRowsByHash(const QString& hash_key) const
+{
+    Z_CHECK(!hash_key.isEmpty());
+    return findRowsByHash(HashedDatasetKey::fromString(hash_key));
+}
+
+Rows HashedDataset::findRowsByHash(const HashedDatasetKey& hash_key) const
 {
     Z_CHECK(!hash_key.isEmpty());
 
     if (!_hash_generated)
         const_cast<HashedDataset*>(this)->updateHash();
 
+    const_cast<HashedDataset*>(this)->renumberRows();
+
     QList<HashData*> data = _hash.values(hash_key);
     Rows res;
     for (auto i = data.constBegin(); i != data.constEnd(); ++i) {
-        Z_CHECK((*i)->index.isValid());
-        res.append((*i)->index);
+        QModelIndex index = _item_model->index((*i)->row, 0, (*i)->parent);
+        Z_CHECK(index.isValid());
+        res.append(index);
     }
 
     return res;
@@ -235,6 +432,7 @@ int HashedDataset::uniqueRowCount() const
 {
     if (!_hash_generated)
         const_cast<HashedDataset*>(this)->updateHash();
+    const_cast<HashedDataset*>(this)->updateUniqueValues();
     return _unique_values.count();
 }
 
@@ -242,6 +440,7 @@ QVariantList HashedDataset::uniqueRowValues(int i) const
 {
     if (!_hash_generated)
         const_cast<HashedDataset*>(this)->updateHash();
+    const_cast<HashedDataset*>(this)->updateUniqueValues();
     Z_CHECK(i >= 0 && i < _unique_values.count());
     return _unique_values.at(i);
 }
@@ -286,6 +485,88 @@ void HashedDataset::sl_itemDataChanged(const QModelIndex& topLeft, const QModelI
     clearIfNeedHelper(topLeft, bottomRight, false);
 }
 
+void HashedDataset::sl_rowsInserted(const QModelIndex& parent, int first, int last)
+{
+    if (!_hash_generated)
+        return;
+
+    if (!_is_auto_update) {
+        _rows_outdated = true;
+        return;
+    }
+
+    if (!isIncrementalUpdate(parent) || first > _root_rows.size()) {
+        clearHelper(false);
+        return;
+    }
+
+    // если в добавленных строках есть дочерние, то набор данных становится иерархическим
+    for (int row = first; row <= last; row++) {
+        if (_item_model->rowCount(_item_model->index(row, 0)) > 0) {
+            clearHelper(false);
+            return;
+        }
+    }
+
+    // порядок уникальных значений сохраняется только при добавлении в конец
+    if (first < _root_rows.size())
+        _unique_values_dirty = true;
+
+    _root_rows.insert(first, last - first + 1, nullptr);
+    for (int row = first; row <= last; row++) {
+        _root_rows[row] = createRowHash(row, QModelIndex());
+    }
+
+    _renumber_from = qMin(_renumber_from, first);
+}
+
+void HashedDataset::sl_rowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    if (!_hash_generated)
+        return;
+
+    if (!_is_auto_update) {
+        _rows_outdated = true;
+        return;
+    }
+
+    if (!isIncrementalUpdate(parent) || last >= _root_rows.size()) {
+        clearHelper(false);
+        return;
+    }
+
+    for (int row = first; row <= last; row++) {
+        removeRowHash(_root_rows.at(row));
+    }
+    _root_rows.remove(first, last - first + 1);
+
+    _unique_values_dirty = true;
+    _renumber_from = qMin(_renumber_from, first);
+}
+
+void HashedDataset::sl_rowsMoved(const QModelIndex& parent, int start, int end, const QModelIndex& destination, int row)
+{
+    if (!_hash_generated)
+        return;
+
+    if (!_is_auto_update) {
+        _rows_outdated = true;
+        return;
+    }
+
+    if (!isIncrementalUpdate(parent) || !isIncrementalUpdate(destination) || end >= _root_rows.size() || row > _root_rows.size()) {
+        clearHelper(false);
+        return;
+    }
+
+    // row указывает на позицию до перемещения
+    int count = end - start + 1;
+    Utils::moveVector(_root_rows, start, count, row > start ? row - count : row);
+
+    _unique_values_dirty = true;
+    _renumber_from = qMin(_renumber_from, qMin(start, row));
+}
+
 void HashedDataset::sl_allPropertiesUnBlocked()
 {
     clearHelper(false);
@@ -344,25 +625,36 @@ void HashedDataset::init()
     prepareCaseInsensitive();
 
     connect(_item_model, &QAbstractItemModel::dataChanged, this, &HashedDataset::sl_itemDataChanged);
-    connect(_item_model, &QAbstractItemModel::rowsInserted, this, [&]() { clearHelper(false); });
-    connect(_item_model, &QAbstractItemModel::rowsRemoved, this, [&]() { clearHelper(false); });
+    connect(_item_model, &QAbstractItemModel::rowsInserted, this, &HashedDataset::sl_rowsInserted);
+    connect(_item_model, &QAbstractItemModel::rowsRemoved, this, &HashedDataset::sl_rowsRemoved);
+    connect(_item_model, &QAbstractItemModel::rowsMoved, this, &HashedDataset::sl_rowsMoved);
     connect(_item_model, &QAbstractItemModel::modelReset, this, [&]() { clearHelper(false); });
-    connect(_item_model, &QAbstractItemModel::rowsMoved, this, [&]() { clearHelper(false); });
+    connect(_item_model, &QAbstractItemModel::layoutChanged, this, [&]() { clearHelper(false); });
     connect(_item_model, &QAbstractItemModel::columnsMoved, this, [&]() { clearHelper(false); });
 }
 
 void HashedDataset::clearHelper(bool force)
 {
-    if (!force && !_is_auto_update)
+    if (!_hash_generated)
         return;
 
-    if (!_hash_generated)
+    if (!force && !_is_auto_update) {
+        // структура набора данных могла измениться, поэтому _root_rows больше нельзя использовать для частичного обновления
+        _rows_outdated = true;
         return;
+    }
 
     _hash_generated = false;
-    qDeleteAll(_hash);
+    _rows_outdated = false;
+    qDeleteAll(_root_rows);
+    qDeleteAll(_child_rows);
+    _root_rows.clear();
+    _child_rows.clear();
     _hash.clear();
     _unique_values.clear();
+    _unique_values_dirty = false;
+    _has_children = false;
+    _renumber_from = std::numeric_limits<int>::max();
 }
 
 void HashedDataset::clear()
@@ -395,6 +687,12 @@ void HashedDataset::clearIfNeedHelper(const QModelIndex& topLeft, const QModelIn
     if (!_hash_generated)
         return;
 
+    // при отключенном автообновлении строки могли быть добавлены или удалены без изменения _root_rows
+    if (_rows_outdated) {
+        clear();
+        return;
+    }
+
     // для заблокированных наборов данных очищаем всегда
     if (_data_container == nullptr || !_data_container->isPropertyBlocked(_dataset_property)) {
         bool needUpdate = false;
@@ -408,6 +706,14 @@ void HashedDataset::clearIfNeedHelper(const QModelIndex& topLeft, const QModelIn
 
         if (!needUpdate)
             return;
+
+        if (isIncrementalUpdate(topLeft.parent()) && bottomRight.row() < _root_rows.size()) {
+            // обновляем только измененные строки
+            for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+                updateRowKey(row);
+            }
+            return;
+        }
     }
 
     clear();
@@ -415,8 +721,10 @@ void HashedDataset::clearIfNeedHelper(const QModelIndex& topLeft, const QModelIn
 
 void HashedDataset::updateHash()
 {
-    clear();    
-    _hash.reserve(_item_model->rowCount());
+    clear();
+    int row_count = _item_model->rowCount();
+    _hash.reserve(row_count);
+    _root_rows.reserve(row_count);
     updateHashHelper(QModelIndex());
     _hash_generated = true;
 }
@@ -424,29 +732,99 @@ void HashedDataset::updateHash()
 void HashedDataset::updateHashHelper(const QModelIndex& parent)
 {
     for (int row = 0; row < _item_model->rowCount(parent); row++) {
-        updateRowHash(row, parent);
+        HashData* data = createRowHash(row, parent);
+        if (parent.isValid()) {
+            _has_children = true;
+            _child_rows << data;
+        } else {
+            _root_rows << data;
+        }
+
         updateHashHelper(_item_model->index(row, 0, parent));
     }
 }
 
-void HashedDataset::updateRowHash(int row, const QModelIndex& parent)
+HashedDataset::HashData* HashedDataset::createRowHash(int row, const QModelIndex& parent)
 {
-    QString key = generateRowHashKey(row, parent);
-    if (!key.isEmpty()) {
-        if (!_hash.contains(key)) {
-            QVariantList values;
-            for (int i = 0; i < _key_columns.count(); i++) {
-                int col = _key_columns.at(i);
-                values << _item_model->index(row, col, parent).data(_roles.at(i));
-            }
-            _unique_values.append(values);
-        }
+    HashData* data = new HashData(row, parent, generateRowHashKey(row, parent));
+    if (!data->key.isEmpty()) {
+        if (!_unique_values_dirty && !_hash.contains(data->key))
+            _unique_values.append(rowKeyValues(row, parent));
+
+        _hash.insert(data->key, data);
+    }
+
+    return data;
+}
+
+void HashedDataset::removeRowHash(HashData* data)
+{
+    if (!data->key.isEmpty())
+        _hash.remove(data->key, data);
+    delete data;
+}
+
+void HashedDataset::updateRowKey(int row)
+{
+    HashData* data = _root_rows.at(row);
+    HashedDatasetKey key = generateRowHashKey(row, QModelIndex());
+    if (key == data->key)
+        return;
+
+    if (!data->key.isEmpty())
+        _hash.remove(data->key, data);
+
+    data->key = key;
+    if (!key.isEmpty())
+        _hash.insert(key, data);
 
-        _hash.insert(key, new HashData(_item_model->index(row, 0, parent)));
+    _unique_values_dirty = true;
+}
+
+bool HashedDataset::isIncrementalUpdate(const QModelIndex& parent) const
+{
+    // для заблокированных наборов данных очищаем всегда
+    return !parent.isValid() && !_has_children && (_data_container == nullptr || !_data_container->isPropertyBlocked(_dataset_property));
+}
+
+void HashedDataset::renumberRows()
+{
+    for (int i = _renumber_from; i < _root_rows.size(); i++) {
+        _root_rows.at(i)->row = i;
+    }
+    _renumber_from = std::numeric_limits<int>::max();
+}
+
+void HashedDataset::updateUniqueValues()
+{
+    if (!_unique_values_dirty)
+        return;
+
+    // после изменения структуры порядок уникальных значений формируется заново по порядку строк
+    renumberRows();
+    _unique_values.clear();
+    QSet<HashedDatasetKey> keys;
+    for (HashData* data : qAsConst(_root_rows)) {
+        if (data->key.isEmpty() || keys.contains(data->key))
+            continue;
+
+        keys << data->key;
+        _unique_values << rowKeyValues(data->row, data->parent);
+    }
+
+    _unique_values_dirty = false;
+}
+
+QVariantList HashedDataset::rowKeyValues(int row, const QModelIndex& parent) const
+{
+    QVariantList values;
+    for (int i = 0; i < _key_columns.count(); i++) {
+        values << _item_model->index(row, _key_columns.at(i), parent).data(_roles.at(i));
     }
+    return values;
 }
 
-QString HashedDataset::generateRowHashKey(int row, const QModelIndex& parent) const
+HashedDatasetKey HashedDataset::generateRowHashKey(int row, const QModelIndex& parent) const
 {
     Z_CHECK(row >= 0 && row < _item_model->rowCount(parent));
 
@@ -458,7 +836,7 @@ QString HashedDataset::generateRowHashKey(int row, const QModelIndex& parent) co
         values << _item_model->index(row, col, parent).data(_roles.at(i));
     }
 
-    return _customize ? _customize->hashedDatasetkeyValuesToUniqueString(_customize_key, row, parent, values)
+    return _customize ? HashedDatasetKey::fromString(_customize->hashedDatasetkeyValuesToUniqueString(_customize_key, row, parent, values))
                       : generateKey(values);
 }
 
@@ -470,9 +848,9 @@ void HashedDataset::prepareCaseInsensitive()
     }
 }
 
-QString HashedDataset::generateKey(const QVariantList& values) const
+HashedDatasetKey HashedDataset::generateKey(const QVariantList& values) const
 {
-    return Utils::generateUniqueString(values, _case_insensitive_prepared);
+    return HashedDatasetKey::fromValues(values, _case_insensitive_prepared);
 }
 
 AutoHashedDataset::AutoHashedDataset(const QAbstractItemModel* dataset, bool take_ownership)
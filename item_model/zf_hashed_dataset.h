@@ -3,9 +3,68 @@
 #include "zf_data_structure.h"
 #include "zf_rows.h"
 #include <QSharedDataPointer>
+#include <limits>
 
 namespace zf
 {
+/*! Ключ хэша HashedDataset. Формируется напрямую из типизированных значений (целые числа, Uid, строки с учетом регистра)
+ * без преобразования в строку и вычисления криптографического хэша.
+ * Хранит компактное бинарное представление значений и заранее вычисленное значение qHash. При совпадении
+ * значения qHash ключи сравниваются побайтово, поэтому коллизии исключены */
+class ZCORESHARED_EXPORT HashedDatasetKey
+{
+public:
+    HashedDatasetKey();
+    HashedDatasetKey(const HashedDatasetKey& k);
+    HashedDatasetKey& operator=(const HashedDatasetKey& k);
+
+    bool operator==(const HashedDatasetKey& k) const;
+    bool operator!=(const HashedDatasetKey& k) const;
+
+    //! Пустой ключ
+    bool isEmpty() const;
+    //! Значение для qHash
+    uint hashValue() const;
+
+    /*! Сформировать ключ по набору значений. Правила сравнения совпадают с Utils::generateUniqueString:
+     * пробелы по краям строк игнорируются, NULL, пустая строка и false эквивалентны, число и его строковое
+     * представление эквивалентны */
+    static HashedDatasetKey fromValues(
+        //! Набор значений
+        const QVariantList& values,
+        //! Какие из значений не чувствительны к регистру (если не задано, то все чувствительны)
+        const QList<bool>& case_insensitive = QList<bool>());
+    //! Сформировать ключ из произвольной строки (например из I_HashedDatasetCutomize)
+    static HashedDatasetKey fromString(const QString& s);
+
+private:
+    HashedDatasetKey(const QByteArray& data);
+
+    //! Тип значения в бинарном представлении
+    enum class ValueType : char
+    {
+        Null = 0,
+        Integer = 1,
+        String = 2,
+        Uid = 3,
+        Custom = 4,
+    };
+
+    static void appendValue(QByteArray& data, const QVariant& value, bool case_insensitive);
+    static void appendText(QByteArray& data, const QString& text, bool case_insensitive);
+    static void appendInteger(QByteArray& data, qint64 value);
+    static void appendBytes(QByteArray& data, ValueType type, const char* bytes, int size);
+
+    //! Бинарное представление значений
+    QByteArray _data;
+    //! Значение для qHash
+    uint _hash = 0;
+};
+
+inline uint qHash(const HashedDatasetKey& key)
+{
+    return key.hashValue();
+}
 
 //! Интерфейс для кастомизации HashedDataset
 class ZCORESHARED_EXPORT I_HashedDatasetCutomize
@@ -69,7 +128,7 @@ public:
                                      //! Роли. Пусто или количество равно columns
                                      const QList<int>& roles = QList<int>());
     //! Сгенерировать хэш ключ по списку значений
-    QString generateKey(const QVariantList& values) const;
+    HashedDatasetKey generateKey(const QVariantList& values) const;
 
     //! Найти строки по набору ключевых полей
     Rows findRows(const QVariantList& values) const;
@@ -90,6 +149,8 @@ public:
                   const QVariant& value9) const;
 
     //! Поиск по конкретному хэш-ключу
+    Rows findRowsByHash(const HashedDatasetKey& hash_key) const;
+    //! Поиск по строке, сформированной через I_HashedDatasetCutomize
     Rows findRowsByHash(const QString& hash_key) const;
 
     //! Количество уникальных строк
@@ -115,7 +176,7 @@ public:
     //! Сбросить хэш. Будет сгенерирован при первом запросе findRows
     void clear();
 
-    //! Очистить хэш при необходимости
+    //! Очистить хэш при необходимости. Для неиерархических наборов данных хэш обновляется только для измененных строк
     void clearIfNeed(const QModelIndex& topLeft, const QModelIndex& bottomRight);
 
     //! Установить интерфейс кастомизации
@@ -127,6 +188,12 @@ private slots:
     // Реакция на сигналы QAbstractItemModel
     //! Поменялись данные
     void sl_itemDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    //! Добавлены строки
+    void sl_rowsInserted(const QModelIndex& parent, int first, int last);
+    //! Удалены строки
+    void sl_rowsRemoved(const QModelIndex& parent, int first, int last);
+    //! Перемещены строки
+    void sl_rowsMoved(const QModelIndex& parent, int start, int end, const QModelIndex& destination, int row);
 
     // Реакция на сигналы DataContainer
     /* эти сигналы пока не нужны
@@ -162,11 +229,25 @@ private:
 
     //! Сгенерировать хэш для всех строк указанного родителя (рекурсия)
     void updateHashHelper(const QModelIndex& parent);
-    //! Обновить хэш для указанной строки
-    void updateRowHash(int row, const QModelIndex& parent);
+
+    struct HashData;
+    //! Создать данные о строке и добавить их в хэш
+    HashData* createRowHash(int row, const QModelIndex& parent);
+    //! Удалить данные о строке из хэша
+    void removeRowHash(HashData* data);
+    //! Обновить ключ для строки верхнего уровня после изменения данных
+    void updateRowKey(int row);
+    //! Можно ли обновить хэш без полного перестроения
+    bool isIncrementalUpdate(const QModelIndex& parent) const;
+    //! Актуализировать номера строк верхнего уровня после вставки/удаления/перемещения
+    void renumberRows();
+    //! Актуализировать список уникальных значений
+    void updateUniqueValues();
+    //! Значения ключевых колонок строки
+    QVariantList rowKeyValues(int row, const QModelIndex& parent) const;
 
     //! Сгенерировать хэш ключ для строки набора данных
-    QString generateRowHashKey(int row, const QModelIndex& parent) const;
+    HashedDatasetKey generateRowHashKey(int row, const QModelIndex& parent) const;
 
     void prepareCaseInsensitive();
 
@@ -176,27 +257,47 @@ private:
     //! Роли для каждой колонки
     QList<int> _roles;
 
+    //! Данные о строке набора данных
     struct HashData
     {
-        HashData() {}
-        HashData(const QModelIndex& idx)
-            : index(idx)
+        HashData(int r, const QModelIndex& p, const HashedDatasetKey& k)
+            : row(r)
+            , parent(p)
+            , key(k)
         {
         }
 
-        QModelIndex index;
+        //! Номер строки. Для строк верхнего уровня актуален только до позиции _renumber_from
+        int row;
+        //! Родитель. Для строк верхнего уровня всегда невалидный
+        QModelIndex parent;
+        //! Ключ
+        HashedDatasetKey key;
     };
 
     //! Соответствие ключа и данных о строке набора данных
-    QMultiHash<QString, HashData*> _hash;
+    QMultiHash<HashedDatasetKey, HashData*> _hash;
+    //! Данные о строках верхнего уровня в порядке их следования в наборе данных. Владеет HashData
+    QVector<HashData*> _root_rows;
+    //! Данные о дочерних строках иерархических наборов данных. Владеет HashData
+    QVector<HashData*> _child_rows;
+    //! Набор данных иерархический. В этом случае при вставке/удалении/перемещении строк хэш очищается
+    bool _has_children = false;
+    //! Начиная с этой позиции в _root_rows номера строк надо актуализировать
+    int _renumber_from = std::numeric_limits<int>::max();
+
     //! Набор уникальных ключевых значений
     QList<QVariantList> _unique_values;
+    //! Набор уникальных ключевых значений надо сформировать заново
+    bool _unique_values_dirty = false;
 
     //! Имеется сгенерированный хэш
     bool _hash_generated = false;
 
     //! Надо ли автоматически перестраивать хэш при изменении данных
     bool _is_auto_update = true;
+    //! При отключенном автообновлении изменилась структура набора данных и _root_rows не соответствует строкам
+    bool _rows_outdated = false;
 
     const DataContainer* _data_container = nullptr;
     DataProperty _dataset_property;
@@ -3,6 +3,8 @@
 #include "zf_exception.h"
 #include "zf_translation.h"
 #include "zf_framework.h"
+#include "zf_database_messages.h"
+#include "zf_mm_messages.h"
 
 #include <QApplication>
 #include <QDebug>
@@ -19,6 +21,10 @@ MessageDispatcher::MessageDispatcher()
     : QObject()
     , _object_extension(new ObjectExtension(this))
 {    
+    qRegisterMetaType<zf::MessageDispatcher::Priority>();
+
+    _high_water_mark[static_cast<int>(Priority::Low)] = Framework::MESSAGE_DISPATCHER_HIGH_WATER_MARK;
+
     connect(&_buffer_callback_timer, &FeedbackTimer::timeout, this, &MessageDispatcher::sl_bufferCallbackTimeout);
 }
 
@@ -38,7 +44,10 @@ void MessageDispatcher::bootstrap()
     Z_CHECK(Utils::isMainThread());
 
     // регистрируем самого себя для эмуляции работы с синхронными сообщениями
-    Z_CHECK(registerObject(CoreUids::MESSAGE_DISPATCHER, this, "sl_message_dispatcher_inbound"));
+    Z_CHECK(registerObject(CoreUids::MESSAGE_DISPATCHER, this,
+        [this](const I_ObjectExtension*, const Uid& sender_uid, const Message& message, SubscribeHandle subscribe_handle) {
+            sl_message_dispatcher_inbound(sender_uid, message, subscribe_handle);
+        }));
 }
 
 bool MessageDispatcher::confirmMessageDelivery(const Message& message, const I_ObjectExtension* object)
@@ -123,6 +132,33 @@ bool MessageDispatcher::registerObject(const Uid& id, const I_ObjectExtension* o
     return true;
 }
 
+bool MessageDispatcher::registerObject(const Uid& id, const I_ObjectExtension* object, const MessageHandler& handler)
+{
+    Z_CHECK_NULL(object);
+    Z_CHECK(handler != nullptr);
+    Z_CHECK(id.isValid());
+    Z_CHECK_NULL(dynamic_cast<const QObject*>(object));
+
+    QMutexLocker lock(&_mutex);
+
+    I_ObjectExtension* notc_object = const_cast<I_ObjectExtension*>(object);
+
+    if (isObjectRegistered(object))
+        return false;
+
+    auto info = Z_MAKE_SHARED(ObjectInfo);
+    info->id = id;
+    info->object_prt = notc_object;
+    info->handler = handler;
+
+    _objects_by_id.insert(id, info);
+    _objects_by_ptr[notc_object] = info;
+
+    objectExtensionRegisterUseInternal(notc_object);
+
+    return true;
+}
+
 bool MessageDispatcher::unRegisterObject(const I_ObjectExtension* object)
 {
     if (!Core::isBootstraped())
@@ -145,11 +181,8 @@ bool MessageDispatcher::unRegisterObject(const I_ObjectExtension* object)
     Z_CHECK(_objects_by_id.remove(o_info->id, o_info));
 
     // удаляем данные по этому объекту из буфера
-    for (int i = _buffer.count() - 1; i >= 0; i--) {
-        auto b = _buffer.at(i);
-        if (b->reciever_info != nullptr && b->reciever_info->object_prt == object)
-            _buffer.removeAt(i);
-    }
+    removeFromBuffer(
+        [object](const BufferInfoPtr& b) { return b->reciever_info != nullptr && b->reciever_info->object_prt == object; });
 
     auto not_delivered_msg = _not_delivered.keys(object);
     for (auto& id : not_delivered_msg)
@@ -161,6 +194,9 @@ bool MessageDispatcher::unRegisterObject(const I_ObjectExtension* object)
         }
     }
 
+    // уже отправленное событие доставки ничего не найдет
+    o_info->inbound.clear();
+
     objectExtensionUnregisterUseInternal(notc_object);
 
     return true;
@@ -426,11 +462,7 @@ bool MessageDispatcher::unSubscribe(const QList<SubscribeHandle>& subscribe_hand
         Z_CHECK(c_info->subscribe.removeOne(s_info));
         Z_CHECK(c_info->subscribe_by_object.remove(s_info->object_info->object_prt, s_info) == 1);
 
-        for (int i = _buffer.count() - 1; i >= 0; i--) {
-            if (_buffer.at(i)->subcribe_handle == h) {
-                _buffer.removeAt(i);
-            }
-        }
+        removeFromBuffer([h](const BufferInfoPtr& b) { return b->subcribe_handle == h; });
 
         Z_CHECK(_subscribe_info.remove(h));
         Z_DELETE(h);
@@ -515,7 +547,7 @@ void MessageDispatcher::start()
 
     _stop_count--;
     if (_stop_count == 0) {
-        if (!_buffer.isEmpty())
+        if (!isBufferEmpty())
             _buffer_callback_timer.start();        
     }
 }
@@ -543,7 +575,7 @@ void MessageDispatcher::setEnabledReceivers(const UidList& entity_uids)
 
     _enabled_receivers = set;
 
-    if (!_buffer.isEmpty())
+    if (!isBufferEmpty())
         _buffer_callback_timer.start();    
 }
 
@@ -587,6 +619,81 @@ QList<MessageType> MessageDispatcher::blockedChanelMessageTypes(const MessageCha
     return info->blocked_types.keys();
 }
 
+void MessageDispatcher::setMessageTypePriority(MessageType t, Priority priority)
+{
+    QMutexLocker lock(&_mutex);
+    _message_type_priority[static_cast<int>(t)] = priority;
+}
+
+void MessageDispatcher::setChannelPriority(const MessageChannel& channel_id, Priority priority)
+{
+    Z_CHECK(channel_id.isValid());
+
+    QMutexLocker lock(&_mutex);
+    _channel_priority[channel_id] = priority;
+}
+
+MessageDispatcher::Priority MessageDispatcher::messagePriority(const MessageChannel& channel_id, const Message& message) const
+{
+    QMutexLocker lock(&_mutex);
+
+    auto type_priority = _message_type_priority.constFind(static_cast<int>(message.messageType()));
+    if (type_priority != _message_type_priority.constEnd())
+        return type_priority.value();
+
+    if (channel_id.isValid()) {
+        auto channel_priority = _channel_priority.constFind(channel_id);
+        if (channel_priority != _channel_priority.constEnd())
+            return channel_priority.value();
+    }
+
+    switch (message.messageType()) {
+        case MessageType::Confirm:
+        case MessageType::Error:
+        case MessageType::Progress:
+            return Priority::High;
+
+        case MessageType::DBEventEntityChanged:
+        case MessageType::DBEventEntityRemoved:
+        case MessageType::DBEventEntityCreated:
+        case MessageType::ModelInvalide:
+            return Priority::Low;
+
+        default:
+            break;
+    }
+
+    // ответы на команды не должны ждать массовых рассылок
+    return message.feedbackMessageId().isValid() ? Priority::High : Priority::Normal;
+}
+
+void MessageDispatcher::setHighWaterMark(Priority priority, int count)
+{
+    Z_CHECK(count >= 0);
+
+    QMutexLocker lock(&_mutex);
+    _high_water_mark[static_cast<int>(priority)] = count;
+    updateBackpressure();
+}
+
+int MessageDispatcher::highWaterMark(Priority priority) const
+{
+    QMutexLocker lock(&_mutex);
+    return _high_water_mark[static_cast<int>(priority)];
+}
+
+int MessageDispatcher::bufferCount(Priority priority) const
+{
+    QMutexLocker lock(&_mutex);
+    return _buffer[static_cast<int>(priority)].count();
+}
+
+bool MessageDispatcher::isOverloaded(Priority priority) const
+{
+    QMutexLocker lock(&_mutex);
+    return _overloaded[static_cast<int>(priority)];
+}
+
 void MessageDispatcher::postDebugMessage(const QString& sender, const QString& receiver, const MessagePtr& message,
                                          SubscribeHandle subscribe_handle)
 {
@@ -672,28 +779,139 @@ void MessageDispatcher::processBuffer(const QSet<MessageID>& force_messages)
     MessagePauseHelper ph;
     ph.pause();
 
+    // здесь нельзя делать processEvents!
+    bool has_more = false;
+    // ответы на команды обрабатываются без ограничения, чтобы массовые события не задерживали их
+    takeFromBuffer(_buffer[static_cast<int>(Priority::High)], force_messages, -1, has_more);
+
     int count = 0;
-    int not_enabled_count = 0;
-    while (!_buffer.isEmpty() && count < Framework::MESSAGE_DISPATCHER_ONE_STEP) {
-        // здесь нельзя делать processEvents!
-        if (!_enabled_receivers.isEmpty()) {
-            if (!_enabled_receivers.contains(_buffer.first()->reciever_info->id)) {
-                not_enabled_count++;
-                continue;
-            }
+    for (int i = static_cast<int>(Priority::Normal); i < PRIORITY_COUNT; i++) {
+        count += takeFromBuffer(_buffer[i], force_messages, Framework::MESSAGE_DISPATCHER_ONE_STEP - count, has_more);
+    }
+
+    if (has_more)
+        _buffer_callback_timer.start();
+
+    updateBackpressure();
+    processMessageQueue();
+}
+
+int MessageDispatcher::takeFromBuffer(QQueue<BufferInfoPtr>& lane, const QSet<MessageID>& force_messages, int max_count, bool& has_more)
+{
+    int count = 0;
+    int i = 0;
+    while (i < lane.count()) {
+        if (max_count >= 0 && count >= max_count) {
+            has_more = true;
+            break;
         }
 
-        auto b_info = _buffer.dequeue();        
-        if (force_messages.isEmpty() || force_messages.contains(b_info->message->messageId()))
-            enqueueMessage(b_info->sender_info, b_info->reciever_info, b_info->message, b_info->subcribe_handle);
+        auto b_info = lane.at(i);
+        if ((!_enabled_receivers.isEmpty() && !_enabled_receivers.contains(b_info->reciever_info->id))
+            || (!force_messages.isEmpty() && !force_messages.contains(b_info->message->messageId()))) {
+            i++;
+            continue;
+        }
 
+        lane.removeAt(i);
+        bufferItemRemoved(b_info);
+        enqueueMessage(b_info->sender_info, b_info->reciever_info, b_info->message, b_info->subcribe_handle);
         count++;
     }
 
-    if (_buffer.count() > not_enabled_count)
-        _buffer_callback_timer.start();
+    return count;
+}
 
-    processMessageQueue();
+void MessageDispatcher::enqueueBuffer(const BufferInfoPtr& b_info)
+{
+    if (b_info->coalesce) {
+        Uid key = b_info->coalesce_uids.isEmpty() ? Uid() : b_info->coalesce_uids.constFirst();
+        for (auto it = _coalesce.constFind(key); it != _coalesce.constEnd() && it.key() == key; ++it) {
+            auto b = it.value();
+            if (b->reciever_info == b_info->reciever_info && b->subcribe_handle == b_info->subcribe_handle
+                && b->sender_info == b_info->sender_info && b->message->messageType() == b_info->message->messageType()
+                && b->coalesce_uids == b_info->coalesce_uids && b->coalesce_by_user == b_info->coalesce_by_user
+                && b->coalesce_codes == b_info->coalesce_codes) {
+                // такое же событие уже ждет отправки этому получателю
+                return;
+            }
+        }
+        _coalesce.insert(key, b_info);
+    }
+
+    _buffer[static_cast<int>(b_info->priority)].enqueue(b_info);
+}
+
+void MessageDispatcher::removeFromBuffer(const std::function<bool(const BufferInfoPtr&)>& condition)
+{
+    for (auto& lane : _buffer) {
+        for (int i = lane.count() - 1; i >= 0; i--) {
+            auto b = lane.at(i);
+            if (!condition(b))
+                continue;
+
+            lane.removeAt(i);
+            bufferItemRemoved(b);
+        }
+    }
+}
+
+bool MessageDispatcher::isBufferEmpty() const
+{
+    for (auto& lane : _buffer) {
+        if (!lane.isEmpty())
+            return false;
+    }
+    return true;
+}
+
+void MessageDispatcher::bufferItemRemoved(const BufferInfoPtr& b_info)
+{
+    if (!b_info->coalesce)
+        return;
+
+    Uid key = b_info->coalesce_uids.isEmpty() ? Uid() : b_info->coalesce_uids.constFirst();
+    _coalesce.remove(key, b_info);
+}
+
+void MessageDispatcher::updateBackpressure()
+{
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        bool overloaded = false;
+        if (_high_water_mark[i] > 0) {
+            // гистерезис, чтобы сигнал не отправлялся на каждое сообщение около порога
+            int count = _buffer[i].count();
+            overloaded = _overloaded[i] ? count > _high_water_mark[i] / 2 : count >= _high_water_mark[i];
+        }
+
+        if (overloaded == _overloaded[i])
+            continue;
+
+        _overloaded[i] = overloaded;
+        emit sg_backpressure(static_cast<Priority>(i), overloaded);
+    }
+}
+
+bool MessageDispatcher::coalesceKey(const Message& message, UidList& uids, QList<bool>& by_user, EntityCodeList& codes)
+{
+    // объединяются только события без привязки к командам, повторная доставка которых ничего не меняет для получателя
+    if (message.feedbackMessageId().isValid())
+        return false;
+
+    if (message.messageType() == MessageType::DBEventEntityChanged) {
+        DBEventEntityChangedMessage msg(message);
+        uids = msg.entityUids();
+        by_user = msg.byUser();
+        codes = msg.entityCodes();
+        return true;
+    }
+
+    if (message.messageType() == MessageType::ModelInvalide) {
+        uids = ModelInvalideMessage(message).entityUidList();
+        return true;
+    }
+
+    return false;
 }
 
 QString MessageDispatcher::getObjectDescription(const Uid& uid, const I_ObjectExtension* obj)
@@ -768,6 +986,12 @@ void MessageDispatcher::putMessageToBuffer(const ObjectInfoPtr& sender, const Me
         }
     }
 
+    Priority priority = messagePriority(channel, message);
+    UidList coalesce_uids;
+    QList<bool> coalesce_by_user;
+    EntityCodeList coalesce_codes;
+    bool coalesce = coalesceKey(message, coalesce_uids, coalesce_by_user, coalesce_codes);
+
     for (int i = 0; i < receiver_info_list.count(); i++) {
         auto receiver_info = receiver_info_list.at(i);
 
@@ -780,12 +1004,22 @@ void MessageDispatcher::putMessageToBuffer(const ObjectInfoPtr& sender, const Me
 
         b_info->sender_info = sender;
         b_info->message = MessagePtr(message.clone());
+        b_info->priority = priority;
 
-        _buffer.enqueue(b_info);
+        if (coalesce) {
+            b_info->coalesce = true;
+            b_info->coalesce_uids = coalesce_uids;
+            b_info->coalesce_by_user = coalesce_by_user;
+            b_info->coalesce_codes = coalesce_codes;
+        }
+
+        enqueueBuffer(b_info);
     }
 
-    if (!receiver_info_list.isEmpty())
+    if (!receiver_info_list.isEmpty()) {
+        updateBackpressure();
         _buffer_callback_timer.start();
+    }
 }
 
 void MessageDispatcher::putMessageToBuffer_thread(const I_ObjectExtension* sender, const MessageChannel& channel,
@@ -842,28 +1076,90 @@ void MessageDispatcher::postMessageHelper(const ObjectInfoPtr& sender, ObjectInf
     auto qobj = dynamic_cast<QObject*>(receiver_info->object_prt);
     Z_CHECK_NULL(qobj);
 
-    if (!QMetaObject::invokeMethod(qobj, receiver_info->slot.constData(), Qt::QueuedConnection, Q_ARG(zf::Uid, sender->id),
-                                   Q_ARG(zf::Message, *message.get()), Q_ARG(zf::SubscribeHandle, subscribe_handle))) {
-        Z_HALT(QString("Message inbound slot %1 not found. Object: %2, uid: %3")
-                   .arg(receiver_info->slot.constData())
-                   .arg(qobj->objectName().isEmpty() ? QString(qobj->metaObject()->className())
-                                                     : QString(qobj->metaObject()->className()) + ":" + qobj->objectName())
-                   .arg(receiver_info->id.toPrintable()));
-    }
+    if (receiver_info->handler == nullptr && !receiver_info->slots_resolved)
+        resolveInboundSlots(receiver_info);
 
-    if (!receiver_info->slot_advanced.isEmpty()) {
-        if (!QMetaObject::invokeMethod(qobj, receiver_info->slot_advanced.constData(), Qt::QueuedConnection,
-                                       Q_ARG(const zf::I_ObjectExtension*, sender->object_prt), Q_ARG(zf::Uid, sender->id),
-                                       Q_ARG(zf::Message, *message.get()), Q_ARG(zf::SubscribeHandle, subscribe_handle))) {
+    auto item = Z_MAKE_SHARED(MessageQueueInfo);
+    item->sender = sender;
+    item->receiver_info = receiver_info;
+    item->message = message;
+    item->subscribe_handle = subscribe_handle;
+    receiver_info->inbound.enqueue(item);
+
+    if (receiver_info->delivery_posted)
+        return;
+
+    // одно событие на получателя доставит все сообщения, накопленные к моменту его обработки
+    receiver_info->delivery_posted = true;
+    ObjectInfoPtr r_info = receiver_info;
+    Z_CHECK(QMetaObject::invokeMethod(
+        qobj, [this, r_info]() { deliverInboundMessages(r_info); }, Qt::QueuedConnection));
+}
+
+void MessageDispatcher::resolveInboundSlots(const ObjectInfoPtr& receiver_info)
+{
+    // слоты ищутся при первой отправке, а не при регистрации, т.к. объект может регистрироваться из конструктора базового класса
+    auto qobj = dynamic_cast<QObject*>(receiver_info->object_prt);
+    Z_CHECK_NULL(qobj);
+
+    auto find_slot = [qobj, receiver_info](const QByteArray& slot, const char* params) -> QMetaMethod {
+        QByteArray signature = QMetaObject::normalizedSignature(QByteArray(slot + params).constData());
+        int index = qobj->metaObject()->indexOfMethod(signature.constData());
+        if (index < 0)
             Z_HALT(QString("Message inbound slot %1 not found. Object: %2, uid: %3")
-                       .arg(receiver_info->slot_advanced.constData())
+                       .arg(slot.constData())
                        .arg(qobj->objectName().isEmpty() ? QString(qobj->metaObject()->className())
                                                          : QString(qobj->metaObject()->className()) + ":" + qobj->objectName())
                        .arg(receiver_info->id.toPrintable()));
-        }
+
+        return qobj->metaObject()->method(index);
+    };
+
+    receiver_info->slot_method = find_slot(receiver_info->slot, "(zf::Uid,zf::Message,zf::SubscribeHandle)");
+    if (!receiver_info->slot_advanced.isEmpty())
+        receiver_info->slot_advanced_method
+            = find_slot(receiver_info->slot_advanced, "(const zf::I_ObjectExtension*,zf::Uid,zf::Message,zf::SubscribeHandle)");
+
+    receiver_info->slots_resolved = true;
+}
+
+void MessageDispatcher::deliverInboundMessages(const ObjectInfoPtr& receiver_info)
+{
+    QMutexLocker lock(&_mutex);
+
+    receiver_info->delivery_posted = false;
+
+    // сообщения, пришедшие во время обработки, будут доставлены следующим событием. Очередь общая, поэтому при вложенных
+    // циклах обработки событий порядок доставки сохраняется
+    int count = receiver_info->inbound.count();
+    while (count-- > 0 && !receiver_info->inbound.isEmpty() && !_deleted) {
+        auto item = receiver_info->inbound.dequeue();
+
+        lock.unlock();
+        invokeInbound(receiver_info, item);
+        lock.relock();
     }
 }
 
+void MessageDispatcher::invokeInbound(const ObjectInfoPtr& receiver_info, const MessageQueueInfoPtr& item)
+{
+    if (receiver_info->handler != nullptr) {
+        receiver_info->handler(item->sender->object_prt, item->sender->id, *item->message, item->subscribe_handle);
+        return;
+    }
+
+    auto qobj = dynamic_cast<QObject*>(receiver_info->object_prt);
+    Z_CHECK_NULL(qobj);
+
+    Z_CHECK(receiver_info->slot_method.invoke(qobj, Qt::DirectConnection, Q_ARG(zf::Uid, item->sender->id),
+        Q_ARG(zf::Message, *item->message), Q_ARG(zf::SubscribeHandle, item->subscribe_handle)));
+
+    if (receiver_info->slot_advanced_method.isValid())
+        Z_CHECK(receiver_info->slot_advanced_method.invoke(qobj, Qt::DirectConnection,
+            Q_ARG(const zf::I_ObjectExtension*, item->sender->object_prt), Q_ARG(zf::Uid, item->sender->id),
+            Q_ARG(zf::Message, *item->message), Q_ARG(zf::SubscribeHandle, item->subscribe_handle)));
+}
+
 MessageDispatcher::SubscribeInfo::~SubscribeInfo()
 {
 }
@@ -9,6 +9,7 @@
 
 #include <QEventLoop>
 #include <QHash>
+#include <QMetaMethod>
 #include <QObject>
 #include <QPointer>
 #include <QQueue>
@@ -51,6 +52,15 @@ namespace zf
         //! Идентификатор подписки на канал (только для рассылок через каналы)
         zf::SubscribeHandle subscribe_handle);
 
+Вместо слотов можно зарегистрировать обработчик MessageDispatcher::MessageHandler. Он вызывается напрямую в потоке получателя
+без поиска метода по имени.
+
+Сообщения доставляются получателю пакетами: на каждого получателя в очередь событий его потока помещается не более одного
+события за раз, которое доставляет все накопленные к этому моменту сообщения в порядке отправки.
+
+Буфер сообщений разделен на очереди по приоритетам (MessageDispatcher::Priority). Сначала обрабатываются ответы на команды,
+затем обычные сообщения и в последнюю очередь массовые события БД. Одинаковые события об изменении сущностей, ожидающие в буфере
+отправки одному получателю, объединяются. При переполнении очереди выше заданного порога отправляется сигнал sg_backpressure.
 */
 
 //! Диспетчер сообщений
@@ -65,6 +75,30 @@ public:
     explicit MessageDispatcher();
     ~MessageDispatcher();
 
+    //! Приоритет обработки сообщений в буфере
+    enum class Priority
+    {
+        //! Ответы на команды и прогресс
+        High = 0,
+        //! Обычные сообщения
+        Normal = 1,
+        //! Массовые события об изменении данных
+        Low = 2,
+    };
+    Q_ENUM(Priority)
+
+    //! Обработчик входящих сообщений. Вызывается в потоке получателя
+    typedef std::function<void(
+        //! Указатель на отправителя. ВАЖНО! Нет гарантии что в момент вызова это будет валидный указатель
+        const I_ObjectExtension* sender_ptr,
+        //! Отправитель
+        const Uid& sender_uid,
+        //! Сообщение
+        const Message& message,
+        //! Идентификатор подписки на канал (только для рассылок через каналы)
+        SubscribeHandle subscribe_handle)>
+        MessageHandler;
+
 public: // реализация I_ObjectExtension
     //! Удален ли объект
     bool objectExtensionDestroyed() const final;
@@ -131,6 +165,14 @@ public:
          * (const I_ObjectExtension* sender_ptr, const zf::Uid& sender_uid, const zf::Message& message, zf::SubscribeHandle subscribe_handle)
          * ВАЖНО: параметры должены выглядеть именно так как написано (не убирать namespace) */
         const QString& slot_advanced = QString());
+    //! Регистрация объекта в диспетчере с обработчиком сообщений вместо слота
+    bool registerObject(
+        //! Идентификатор, под которым объект будет зарегистрирован в диспетчере
+        const Uid& id,
+        //! Объект. Должен быть наследником QObject
+        const I_ObjectExtension* object,
+        //! Обработчик сообщений. Вызывается в потоке объекта
+        const MessageHandler& handler);
     //! Удаление регистрации объекта в диспетчере
     bool unRegisterObject(const I_ObjectExtension* object);
 
@@ -288,6 +330,30 @@ public:
     //! Виды сообщений заблокированных для указанного канала
     QList<MessageType> blockedChanelMessageTypes(const MessageChannel& channel_id) const;
 
+    //! Задать приоритет для вида сообщений. Имеет преимущество перед приоритетом канала
+    void setMessageTypePriority(MessageType t, Priority priority);
+    //! Задать приоритет для сообщений, рассылаемых через канал
+    void setChannelPriority(const MessageChannel& channel_id, Priority priority);
+    //! Приоритет, с которым сообщение будет обрабатываться в буфере
+    Priority messagePriority(
+        //! Канал. Если сообщение отправляется не через канал, то не валидный
+        const MessageChannel& channel_id, const Message& message) const;
+
+    /*! Порог количества сообщений в очереди с указанным приоритетом. При его превышении отправляется сигнал
+     * sg_backpressure(priority, true), а при снижении до половины порога - sg_backpressure(priority, false).
+     * 0 - без ограничений */
+    void setHighWaterMark(Priority priority, int count);
+    int highWaterMark(Priority priority) const;
+    //! Количество сообщений в очереди с указанным приоритетом
+    int bufferCount(Priority priority) const;
+    //! Превышен ли порог количества сообщений в очереди с указанным приоритетом
+    bool isOverloaded(Priority priority) const;
+
+signals:
+    //! Изменилось состояние переполнения очереди сообщений с указанным приоритетом
+    //! Отправители массовых сообщений могут приостанавливать рассылку пока overloaded == true
+    void sg_backpressure(zf::MessageDispatcher::Priority priority, bool overloaded);
+
 private slots:
     //! Колбек обработки буфера
     void sl_bufferCallbackTimeout();
@@ -356,6 +422,12 @@ private:
     //! Отправить сообщение получателю
     void postMessageHelper(const ObjectInfoPtr& sender, ObjectInfoPtr& receiver_info, const MessagePtr& message,
                            SubscribeHandle subscribe_handle);
+    //! Найти слоты получателя по имени. Выполняется один раз при первой отправке сообщения объекту
+    static void resolveInboundSlots(const ObjectInfoPtr& receiver_info);
+    //! Доставить получателю накопленные для него сообщения. Вызывается в потоке получателя
+    void deliverInboundMessages(const ObjectInfoPtr& receiver_info);
+    //! Вызвать обработчик сообщения у получателя
+    static void invokeInbound(const ObjectInfoPtr& receiver_info, const MessageQueueInfoPtr& item);
 
     //! Отправить отладочное сообщение в окно debug
     void postDebugMessage(const QString& sender, const QString& receiver, const MessagePtr& message, SubscribeHandle subscribe_handle);
@@ -365,6 +437,24 @@ private:
     ChannelInfoPtr channelInfo(MessageChannel id) const;
     //! Обработка буфера
     void processBuffer(const QSet<MessageID>& force_messages);
+    //! Забрать из очереди буфера сообщения для получателей и поставить их в очередь на отправку
+    int takeFromBuffer(QQueue<BufferInfoPtr>& lane, const QSet<MessageID>& force_messages,
+        //! Ограничение на количество. -1 - без ограничения
+        int max_count,
+        //! Устанавливается в true, если в очереди остались сообщения из-за ограничения
+        bool& has_more);
+    //! Поместить сообщение в буфер с объединением одинаковых событий об изменении сущностей
+    void enqueueBuffer(const BufferInfoPtr& b_info);
+    //! Удалить из буфера сообщения, удовлетворяющие условию
+    void removeFromBuffer(const std::function<bool(const BufferInfoPtr&)>& condition);
+    //! Буфер пуст
+    bool isBufferEmpty() const;
+    //! Сообщение удалено из буфера
+    void bufferItemRemoved(const BufferInfoPtr& b_info);
+    //! Проверить превышение порогов очередей буфера
+    void updateBackpressure();
+    //! Данные для объединения одинаковых событий. Возвращает false, если событие не объединяется
+    static bool coalesceKey(const Message& message, UidList& uids, QList<bool>& by_user, EntityCodeList& codes);
     //! Информация об объекте
     static QString getObjectDescription(const Uid& uid, const I_ObjectExtension* obj);
 
@@ -375,6 +465,18 @@ private:
         I_ObjectExtension* object_prt = nullptr;
         QByteArray slot;
         QByteArray slot_advanced;
+
+        //! Обработчик сообщений (если объект зарегистрирован без слота)
+        MessageHandler handler;
+        //! Найденные по имени слоты
+        bool slots_resolved = false;
+        QMetaMethod slot_method;
+        QMetaMethod slot_advanced_method;
+
+        //! Сообщения, ожидающие доставки в потоке получателя
+        QQueue<MessageQueueInfoPtr> inbound;
+        //! В очередь событий получателя уже помещено событие доставки
+        bool delivery_posted = false;
     };
     QMultiHash<Uid, ObjectInfoPtr> _objects_by_id;
     QHash<I_ObjectExtension*, ObjectInfoPtr> _objects_by_ptr;
@@ -418,9 +520,28 @@ private:
         SubscribeHandle subcribe_handle;
         ObjectInfoPtr sender_info;
         MessagePtr message;
+        Priority priority = Priority::Normal;
+
+        //! Данные для объединения одинаковых событий
+        bool coalesce = false;
+        UidList coalesce_uids;
+        QList<bool> coalesce_by_user;
+        EntityCodeList coalesce_codes;
     };
-    //! Буфер, в который попадают сообщения на отправку
-    QQueue<BufferInfoPtr> _buffer;
+    //! Количество приоритетов
+    static const int PRIORITY_COUNT = 3;
+    //! Буфер, в который попадают сообщения на отправку. Отдельная очередь для каждого приоритета
+    QQueue<BufferInfoPtr> _buffer[PRIORITY_COUNT];
+    //! Объединяемые события в буфере. Ключ - первый идентификатор сущности из события
+    QMultiHash<Uid, BufferInfoPtr> _coalesce;
+    //! Приоритеты для видов сообщений
+    QHash<int, Priority> _message_type_priority;
+    //! Приоритеты каналов
+    QHash<MessageChannel, Priority> _channel_priority;
+    //! Пороги количества сообщений в очередях
+    int _high_water_mark[PRIORITY_COUNT] = {0, 0, 0};
+    //! Признак переполнения очередей
+    bool _overloaded[PRIORITY_COUNT] = {false, false, false};
 
     //! Данные для синхронной отправки сообщений
     struct SendMessageInfo
@@ -11,6 +11,41 @@
 //! Версия структуры стрима
 static int _MESSAGE_STREAM_VERSION = 2;
 
+//! Сигнатура формата сериализации Message::toByteArray ("ZFMS")
+static const quint32 _MESSAGE_WIRE_MAGIC = 0x5A464D53;
+//! Версия формата сериализации Message::toByteArray
+static const quint16 _MESSAGE_WIRE_VERSION = 1;
+//! Размер заголовка: сигнатура, версия, флаги, размер конверта, размер тела, размер тела до сжатия
+static const int _MESSAGE_WIRE_HEADER_SIZE = 20;
+//! Флаг: тело сжато
+static const quint16 _MESSAGE_WIRE_COMPRESSED = 0x1;
+
+//! Заголовок сериализованного сообщения
+struct _MessageWireHeader
+{
+    quint16 version = 0;
+    quint16 flags = 0;
+    quint32 envelope_size = 0;
+    quint32 body_size = 0;
+    quint32 raw_size = 0;
+};
+
+//! Прочитать заголовок. Возвращает false, если данные не в формате Message::toByteArray
+static bool _readMessageWireHeader(const char* data, int size, _MessageWireHeader& header)
+{
+    if (data == nullptr || size < _MESSAGE_WIRE_HEADER_SIZE)
+        return false;
+
+    QDataStream ds(QByteArray::fromRawData(data, _MESSAGE_WIRE_HEADER_SIZE));
+    quint32 magic;
+    ds >> magic;
+    if (magic != _MESSAGE_WIRE_MAGIC)
+        return false;
+
+    ds >> header.version >> header.flags >> header.envelope_size >> header.body_size >> header.raw_size;
+    return ds.status() == QDataStream::Ok;
+}
+
 namespace zf
 {
 //! Данные для Message
@@ -407,20 +442,103 @@ Message& Message::setMessageId(const MessageID& id)
     return *this;
 }
 
-QByteArray Message::toByteArray() const
+QByteArray Message::toByteArray(int compress_threshold) const
 {
-    QByteArray data;
-    QDataStream ds(&data, QIODevice::WriteOnly);
-    ds.setVersion(Consts::DATASTREAM_VERSION);
-    ds << *this;
-    return qCompress(data);
+    if (compress_threshold < 0)
+        compress_threshold = Consts::MESSAGE_COMPRESS_THRESHOLD;
+
+    // все части пишутся в один буфер, заголовок заполняется в конце
+    QByteArray data(_MESSAGE_WIRE_HEADER_SIZE, '\0');
+    int envelope_size;
+    int raw_size;
+    {
+        QDataStream ds(&data, QIODevice::WriteOnly | QIODevice::Append);
+        ds.setVersion(Consts::DATASTREAM_VERSION);
+
+        toStreamInt(ds, _d->type);
+        ds << _d->code << _d->id << _d->feedback_message_id;
+        envelope_size = data.size() - _MESSAGE_WIRE_HEADER_SIZE;
+
+        ds << *this;
+        raw_size = data.size() - _MESSAGE_WIRE_HEADER_SIZE - envelope_size;
+    }
+
+    quint16 flags = 0;
+    int body_size = raw_size;
+    if (compress_threshold > 0 && raw_size >= compress_threshold) {
+        int body_pos = _MESSAGE_WIRE_HEADER_SIZE + envelope_size;
+        QByteArray compressed = qCompress(reinterpret_cast<const uchar*>(data.constData() + body_pos), raw_size, 1);
+        if (compressed.size() < raw_size) {
+            data.truncate(body_pos);
+            data.append(compressed);
+            flags |= _MESSAGE_WIRE_COMPRESSED;
+            body_size = compressed.size();
+        }
+    }
+
+    QByteArray header;
+    header.reserve(_MESSAGE_WIRE_HEADER_SIZE);
+    QDataStream hs(&header, QIODevice::WriteOnly);
+    hs << _MESSAGE_WIRE_MAGIC << _MESSAGE_WIRE_VERSION << flags << static_cast<quint32>(envelope_size) << static_cast<quint32>(body_size)
+       << static_cast<quint32>(raw_size);
+    Z_CHECK(header.size() == _MESSAGE_WIRE_HEADER_SIZE);
+    memcpy(data.data(), header.constData(), _MESSAGE_WIRE_HEADER_SIZE);
+
+    return data;
 }
 
 Message Message::fromByteArray(const QByteArray& data, Error& error)
+{
+    return fromRawData(data.constData(), data.size(), error);
+}
+
+Message Message::fromRawData(const char* data, int size, Error& error)
 {
     error.clear();
 
-    QByteArray uncompressed = qUncompress(data);
+    _MessageWireHeader header;
+    if (_readMessageWireHeader(data, size, header)) {
+        if (header.version != _MESSAGE_WIRE_VERSION) {
+            error = Error(ZF_TR(ZFT_WRONG_PROTOCOL_VERSION));
+            return Message();
+        }
+
+        qint64 body_pos = _MESSAGE_WIRE_HEADER_SIZE + static_cast<qint64>(header.envelope_size);
+        if (body_pos + header.body_size != size) {
+            error = Error::corruptedDataError("Message::fromByteArray corrupted");
+            return Message();
+        }
+
+        QByteArray body;
+        if (header.flags & _MESSAGE_WIRE_COMPRESSED) {
+            body = qUncompress(reinterpret_cast<const uchar*>(data + body_pos), static_cast<int>(header.body_size));
+            if (body.size() != static_cast<int>(header.raw_size)) {
+                error = Error::corruptedDataError("Message::fromByteArray corrupted");
+                return Message();
+            }
+        } else {
+            // без копирования
+            body = QByteArray::fromRawData(data + body_pos, static_cast<int>(header.body_size));
+        }
+
+        if (!isSupportedStreamVersion(body, false)) {
+            error = Error(ZF_TR(ZFT_WRONG_PROTOCOL_VERSION));
+            return Message();
+        }
+
+        QDataStream ds(body);
+        ds.setVersion(Consts::DATASTREAM_VERSION);
+        Message message;
+        ds >> message;
+        if (ds.status() != QDataStream::Ok) {
+            error = Error::corruptedDataError("Message::fromByteArray corrupted");
+            return Message();
+        }
+        return message;
+    }
+
+    // старый формат: сжатое целиком сообщение
+    QByteArray uncompressed = qUncompress(reinterpret_cast<const uchar*>(data), size);
 
     if (!isSupportedStreamVersion(uncompressed, false)) {
         error = Error(ZF_TR(ZFT_WRONG_PROTOCOL_VERSION));
@@ -438,8 +556,27 @@ Message Message::fromByteArray(const QByteArray& data, Error& error)
     return message;
 }
 
+bool Message::peekByteArray(
+    const char* data, int size, MessageType& type, MessageCode& code, MessageID& message_id, MessageID& feedback_message_id)
+{
+    _MessageWireHeader header;
+    if (!_readMessageWireHeader(data, size, header) || header.version != _MESSAGE_WIRE_VERSION
+        || _MESSAGE_WIRE_HEADER_SIZE + static_cast<qint64>(header.envelope_size) > size)
+        return false;
+
+    QDataStream ds(QByteArray::fromRawData(data + _MESSAGE_WIRE_HEADER_SIZE, static_cast<int>(header.envelope_size)));
+    ds.setVersion(Consts::DATASTREAM_VERSION);
+    fromStreamInt(ds, type);
+    ds >> code >> message_id >> feedback_message_id;
+    return ds.status() == QDataStream::Ok;
+}
+
 bool Message::isSupportedStreamVersion(const QByteArray& data, bool compressed)
 {
+    _MessageWireHeader header;
+    if (_readMessageWireHeader(data.constData(), data.size(), header))
+        return header.version == _MESSAGE_WIRE_VERSION;
+
     QDataStream ds(compressed ? qUncompress(data) : data);
     ds.setVersion(Consts::DATASTREAM_VERSION);
 
@@ -256,10 +256,18 @@ public:
     //! Вывести содержимое для отладки
     void debPrint() const;
 
-    //! Преобразовать в QByteArray
-    QByteArray toByteArray() const;
-    //! Восстановить из QByteArray
+    /*! Преобразовать в QByteArray. Формат: заголовок фиксированной длины (сигнатура, версия формата, флаги, размеры частей),
+     * конверт (тип, код, идентификаторы) и тело. Тело сжимается только если его размер не меньше compress_threshold */
+    QByteArray toByteArray(
+        //! Порог сжатия в байтах. -1 - Consts::MESSAGE_COMPRESS_THRESHOLD, 0 - не сжимать
+        int compress_threshold = -1) const;
+    //! Восстановить из QByteArray. Поддерживается и старый формат (qCompress всего сообщения)
     static Message fromByteArray(const QByteArray& data, Error& error);
+    //! Восстановить из области памяти (например отображенного в память файла). Несжатое тело читается без копирования
+    static Message fromRawData(const char* data, int size, Error& error);
+    //! Прочитать только конверт сериализованного сообщения без разбора данных. Возвращает false для старого формата или ошибки
+    static bool peekByteArray(const char* data, int size, MessageType& type, MessageCode& code, MessageID& message_id,
+        MessageID& feedback_message_id);
     //! Проверка сериализованного сообщения на поддерживаемую версию
     static bool isSupportedStreamVersion(const QByteArray& data, bool compressed);
 
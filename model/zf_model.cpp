@@ -1,6 +1,7 @@
 #include "zf_core.h"
 #include "zf_framework.h"
 #include "zf_translation.h"
+#include "zf_model_disk_cache.h"
 
 #include <QDebug>
 
@@ -977,6 +978,9 @@ void Model::processCommand(const Command& command_key, const std::shared_ptr<voi
                     emitStartLoad();
                     error = const_cast<Model*>(this)->onStartCustomLoad(load_data->options, load_data->properties);
 
+                } else if (loadFromLocalCache(custom_data)) {
+                    return;
+
                 } else {
                     postMessageCommand(ModuleCommands::Load, Core::databaseManager(),
                         DBCommandGetEntityMessage(entityUid(), load_data->properties, load_data->parameters), custom_data);
@@ -1056,6 +1060,40 @@ void Model::processCommand(const Command& command_key, const std::shared_ptr<voi
     }
 }
 
+bool Model::loadFromLocalCache(const std::shared_ptr<void>& custom_data)
+{
+    if (!_options.testFlag(DatabaseObjectOption::LocalCache) || _options.testFlag(DatabaseObjectOption::StandardLoadExtension) || isDetached()
+        || !entityUid().isPersistent())
+        return false;
+
+    auto load_data = std::reinterpret_pointer_cast<LoadInfo>(custom_data);
+    if (load_data->options.testFlag(LoadOption::IgnoreLocalCache) || !load_data->parameters.isEmpty())
+        return false;
+
+    auto cache = Core::fr()->modelDiskCache();
+    if (cache == nullptr || !cache->contains(entityUid()))
+        return false;
+
+    AccessRights direct_rights;
+    AccessRights relation_rights;
+    auto cached = cache->read(entityUid(), structure(), direct_rights, relation_rights);
+    if (cached == nullptr || !cached->initializedProperties().contains(load_data->properties))
+        return false;
+
+    load_data->from_local_cache = true;
+    startLoadHelper(load_data);
+    emitStartLoad();
+    finishLoadHelper(custom_data, DBEventEntityLoadedMessage(MessageID(), {entityUid()}, {*cached}, {direct_rights}, {relation_rights}), Error(),
+        AccessRights(), AccessRights());
+
+    // данные в кэше могли устареть, поэтому перечитываем их из БД в фоне
+    LoadOptions options = load_data->options | LoadOption::IgnoreLocalCache;
+    DataPropertySet properties = load_data->properties;
+    QTimer::singleShot(0, this, [this, options, properties]() { reload(options, properties); });
+
+    return true;
+}
+
 static void _update_invalidate_helper(const DataContainerPtr& data, const DataPropertySet& properties)
 {
     for (auto& p : qAsConst(properties)) {
@@ -1089,6 +1127,12 @@ Error Model::finishLoadHelper(const std::shared_ptr<void>& custom_data, const Me
             auto& model_data = m_data.constFirst();
 
             if (model_data.isValid()) {
+                if (_options.testFlag(DatabaseObjectOption::LocalCache) && !info->from_local_cache && info->parameters.isEmpty()
+                    && entityUid().isPersistent()) {
+                    if (auto cache = Core::fr()->modelDiskCache())
+                        cache->write(entityUid(), model_data, m.directRights().value(0), m.relationRights().value(0));
+                }
+
                 // копируем только те, что были загружены
                 data()->copyFrom(&model_data, info->properties.intersect(model_data.initializedProperties()), true, CloneContainerDatasetMode::MoveContent);
 
@@ -1113,6 +1157,12 @@ Error Model::finishLoadHelper(const std::shared_ptr<void>& custom_data, const Me
             _update_invalidate_helper(data(), info->properties);
             error_f = ErrorMessage(message).error();
 
+            // данные, показанные из локального кэша, не подтвердились
+            if (_options.testFlag(DatabaseObjectOption::LocalCache) && info->options.testFlag(LoadOption::IgnoreLocalCache)) {
+                if (auto cache = Core::fr()->modelDiskCache())
+                    cache->remove(entityUid());
+            }
+
         } else
             Z_HALT_INT;
 
@@ -508,6 +508,8 @@ private:
         DataPropertySet properties;
         LoadOptions options;
         QMap<QString, QVariant> parameters;
+        //! Данные получены из локального кэша (DatabaseObjectOption::LocalCache)
+        bool from_local_cache = false;
 
         bool contains(const LoadInfo* i) const;
         bool equal(const LoadInfo* i) const;
@@ -558,6 +560,8 @@ private:
     void setSyncError(const Error& error) const;
 
     void startLoadHelper(const std::shared_ptr<LoadInfo>& info) const;
+    //! Загрузить данные из локального кэша (DatabaseObjectOption::LocalCache). Возвращает истину, если загрузка выполнена
+    bool loadFromLocalCache(const std::shared_ptr<void>& custom_data);
     Error finishLoadHelper(const std::shared_ptr<void>& custom_data, const Message& message, const Error& error,
         //! Прямые права доступа (при CustomLoad)
         const AccessRights& custom_direct_rights,
@@ -0,0 +1,382 @@
+#include "zf_model_disk_cache.h"
+#include "zf_core.h"
+
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+namespace zf
+{
+//! Сигнатура файла
+static const quint32 _MAGIC = 0x5A4D4443;
+//! Версия формата файла
+static const quint32 _FORMAT_VERSION = 1;
+//! Минимальный объем устаревших записей для сжатия файла
+static const qint64 _COMPACT_MIN_GARBAGE = 1024 * 1024;
+
+ModelDiskCache::ModelDiskCache(const QString& file_name, const QString& version)
+    : _file_name(file_name)
+    , _version(version)
+{
+    Z_CHECK(!_file_name.isEmpty());
+    _writer.setMaxThreadCount(1);
+}
+
+ModelDiskCache::~ModelDiskCache()
+{
+    close();
+}
+
+Error ModelDiskCache::open()
+{
+    QMutexLocker lock(&_mutex);
+
+    if (_file.isOpen())
+        return {};
+
+    Error error = Utils::makeDir(QFileInfo(_file_name).absolutePath());
+    if (error.isError())
+        return error;
+
+    _file.setFileName(_file_name);
+    if (!_file.open(QFile::ReadWrite))
+        return Error::fileIOError(_file_name);
+
+    if (!readIndex())
+        error = writeHeader();
+
+    if (error.isError())
+        _file.close();
+
+    return error;
+}
+
+void ModelDiskCache::close()
+{
+    // фоновая запись блокирует _mutex, поэтому ждем ее до блокировки
+    _writer.waitForDone();
+
+    QMutexLocker lock(&_mutex);
+
+    if (!_file.isOpen())
+        return;
+
+    if (_garbage_size > _COMPACT_MIN_GARBAGE && _garbage_size > _live_size) {
+        Error error = compact();
+        if (error.isError())
+            Core::logError(error);
+    }
+
+    unmapFile();
+    _file.close();
+    _index.clear();
+    _live_size = 0;
+    _garbage_size = 0;
+}
+
+bool ModelDiskCache::isOpen() const
+{
+    QMutexLocker lock(&_mutex);
+    return _file.isOpen();
+}
+
+bool ModelDiskCache::contains(const Uid& entity_uid) const
+{
+    QMutexLocker lock(&_mutex);
+    return _index.contains(entity_uid);
+}
+
+DataContainerPtr ModelDiskCache::read(const Uid& entity_uid, const DataStructurePtr& data_structure, AccessRights& direct_rights, AccessRights& relation_rights) const
+{
+    Z_CHECK_NULL(data_structure);
+    QMutexLocker lock(&_mutex);
+
+    auto entry = _index.constFind(entity_uid);
+    if (entry == _index.constEnd())
+        return nullptr;
+
+    const uchar* map = mapFile();
+    if (map == nullptr)
+        return nullptr;
+
+    QByteArray payload = QByteArray::fromRawData(reinterpret_cast<const char*>(map) + entry->offset, static_cast<int>(entry->size));
+    QDataStream st(payload);
+    st.setVersion(Consts::DATASTREAM_VERSION);
+
+    Uid uid;
+    bool removed;
+    QByteArray stamp;
+    int structure_version;
+    st >> uid >> removed >> stamp >> structure_version;
+    if (st.status() != QDataStream::Ok || uid != entity_uid || removed || structure_version != data_structure->structureVersion())
+        return nullptr;
+
+    st >> direct_rights >> relation_rights;
+    if (st.status() != QDataStream::Ok)
+        return nullptr;
+
+    Error error;
+    auto data = DataContainer::fromStream(st, data_structure, error);
+    if (error.isError() || st.status() != QDataStream::Ok) {
+        if (error.isError())
+            Core::logError(error);
+        return nullptr;
+    }
+
+    return data;
+}
+
+void ModelDiskCache::write(const Uid& entity_uid, const DataContainer& data, const AccessRights& direct_rights, const AccessRights& relation_rights)
+{
+    Z_CHECK(entity_uid.isValid());
+    Z_CHECK(data.isValid());
+
+    QByteArray content;
+    {
+        QDataStream st(&content, QIODevice::WriteOnly);
+        st.setVersion(Consts::DATASTREAM_VERSION);
+        st << direct_rights << relation_rights;
+        data.toStream(st);
+        if (st.status() != QDataStream::Ok) {
+            Core::logError(QStringLiteral("ModelDiskCache: serialization error %1").arg(entity_uid.toPrintable()));
+            return;
+        }
+    }
+
+    int structure_version = data.structure()->structureVersion();
+    QtConcurrent::run(&_writer, [this, entity_uid, structure_version, content]() {
+        Error error = writeHelper(entity_uid, structure_version, content);
+        if (error.isError())
+            Core::logError(error);
+    });
+}
+
+void ModelDiskCache::remove(const Uid& entity_uid)
+{
+    QtConcurrent::run(&_writer, [this, entity_uid]() {
+        Error error = removeHelper(entity_uid);
+        if (error.isError())
+            Core::logError(error);
+    });
+}
+
+Error ModelDiskCache::writeHelper(const Uid& entity_uid, int structure_version, const QByteArray& content)
+{
+    QByteArray stamp = Utils::generateChecksum(content).toLatin1();
+
+    QMutexLocker lock(&_mutex);
+
+    if (!_file.isOpen())
+        return Error(QStringLiteral("ModelDiskCache: file not opened %1").arg(_file_name));
+
+    auto entry = _index.constFind(entity_uid);
+    if (entry != _index.constEnd() && entry->stamp == stamp)
+        return {};
+
+    QByteArray payload;
+    {
+        QDataStream st(&payload, QIODevice::WriteOnly);
+        st.setVersion(Consts::DATASTREAM_VERSION);
+        st << entity_uid << false << stamp << structure_version;
+    }
+    payload.append(content);
+
+    return appendRecord(entity_uid, stamp, payload);
+}
+
+Error ModelDiskCache::removeHelper(const Uid& entity_uid)
+{
+    QMutexLocker lock(&_mutex);
+
+    if (!_file.isOpen() || !_index.contains(entity_uid))
+        return {};
+
+    QByteArray payload;
+    {
+        QDataStream st(&payload, QIODevice::WriteOnly);
+        st.setVersion(Consts::DATASTREAM_VERSION);
+        st << entity_uid << true << QByteArray() << 0;
+    }
+
+    return appendRecord(entity_uid, QByteArray(), payload);
+}
+
+bool ModelDiskCache::readIndex()
+{
+    _index.clear();
+    _live_size = 0;
+    _garbage_size = 0;
+
+    if (_file.size() == 0)
+        return false;
+
+    const uchar* map = mapFile();
+    if (map == nullptr)
+        return false;
+
+    QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(map), static_cast<int>(_file.size()));
+    QDataStream st(raw);
+    st.setVersion(Consts::DATASTREAM_VERSION);
+
+    quint32 magic;
+    quint32 format_version;
+    QString version;
+    st >> magic >> format_version >> version;
+    if (st.status() != QDataStream::Ok || magic != _MAGIC || format_version != _FORMAT_VERSION || version != _version)
+        return false;
+
+    qint64 valid_size = st.device()->pos();
+    while (!st.atEnd()) {
+        qint64 size;
+        st >> size;
+        qint64 offset = st.device()->pos();
+        if (st.status() != QDataStream::Ok || size <= 0 || offset + size > raw.size())
+            break; // запись не дописана до конца
+
+        Uid uid;
+        bool removed;
+        QByteArray stamp;
+        st >> uid >> removed >> stamp;
+        if (st.status() != QDataStream::Ok || !uid.isValid())
+            break;
+
+        auto old = _index.constFind(uid);
+        if (old != _index.constEnd()) {
+            _live_size -= old->size;
+            _garbage_size += old->size;
+        }
+
+        if (removed) {
+            _index.remove(uid);
+            _garbage_size += size;
+
+        } else {
+            _index[uid] = {offset, size, stamp};
+            _live_size += size;
+        }
+
+        if (!st.device()->seek(offset + size))
+            break;
+        valid_size = offset + size;
+    }
+
+    if (valid_size < _file.size()) {
+        // отбрасываем недописанный хвост
+        unmapFile();
+        if (!_file.resize(valid_size))
+            return false;
+    }
+
+    return true;
+}
+
+Error ModelDiskCache::writeHeader()
+{
+    unmapFile();
+    _index.clear();
+    _live_size = 0;
+    _garbage_size = 0;
+
+    if (!_file.resize(0) || !_file.seek(0))
+        return Error::fileIOError(_file_name);
+
+    QDataStream st(&_file);
+    st.setVersion(Consts::DATASTREAM_VERSION);
+    st << _MAGIC << _FORMAT_VERSION << _version;
+    if (st.status() != QDataStream::Ok || !_file.flush())
+        return Error::fileIOError(_file_name);
+
+    return {};
+}
+
+Error ModelDiskCache::appendRecord(const Uid& entity_uid, const QByteArray& stamp, const QByteArray& payload)
+{
+    unmapFile();
+
+    qint64 record_pos = _file.size();
+    if (!_file.seek(record_pos))
+        return Error::fileIOError(_file_name);
+
+    QDataStream st(&_file);
+    st.setVersion(Consts::DATASTREAM_VERSION);
+    st << static_cast<qint64>(payload.size());
+    qint64 offset = _file.pos();
+
+    if (st.status() != QDataStream::Ok || _file.write(payload) != payload.size() || !_file.flush()) {
+        _file.resize(record_pos);
+        return Error::fileIOError(_file_name);
+    }
+
+    auto old = _index.constFind(entity_uid);
+    if (old != _index.constEnd()) {
+        _live_size -= old->size;
+        _garbage_size += old->size;
+    }
+
+    if (stamp.isEmpty()) {
+        // удаление
+        _index.remove(entity_uid);
+        _garbage_size += payload.size();
+
+    } else {
+        _index[entity_uid] = {offset, payload.size(), stamp};
+        _live_size += payload.size();
+    }
+
+    return {};
+}
+
+const uchar* ModelDiskCache::mapFile() const
+{
+    if (_map == nullptr && _file.isOpen() && _file.size() > 0)
+        _map = _file.map(0, _file.size());
+
+    return _map;
+}
+
+void ModelDiskCache::unmapFile() const
+{
+    if (_map == nullptr)
+        return;
+
+    _file.unmap(_map);
+    _map = nullptr;
+}
+
+Error ModelDiskCache::compact()
+{
+    const uchar* map = mapFile();
+    if (map == nullptr)
+        return Error::fileIOError(_file_name);
+
+    QSaveFile target(_file_name);
+    if (!target.open(QIODevice::WriteOnly))
+        return Error::fileIOError(_file_name);
+
+    QDataStream st(&target);
+    st.setVersion(Consts::DATASTREAM_VERSION);
+    st << _MAGIC << _FORMAT_VERSION << _version;
+
+    for (auto i = _index.constBegin(); i != _index.constEnd(); ++i) {
+        st << i.value().size;
+        if (target.write(reinterpret_cast<const char*>(map) + i.value().offset, i.value().size) != i.value().size) {
+            target.cancelWriting();
+            break;
+        }
+    }
+
+    if (st.status() != QDataStream::Ok)
+        target.cancelWriting();
+
+    // файл будет заменен, поэтому текущий надо закрыть до commit
+    unmapFile();
+    _file.close();
+
+    if (!target.commit())
+        return Error::fileIOError(_file_name);
+
+    return {};
+}
+
+} // namespace zf
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+
+#include "zf_access_rights.h"
+#include "zf_data_container.h"
+#include "zf_error.h"
+#include "zf_uid.h"
+
+namespace zf
+{
+/*! Локальный кэш загруженных данных моделей между запусками программы (см. DatabaseObjectOption::LocalCache)
+ * Все данные хранятся в одном файле: заголовок с версией, затем записи, которые только дописываются в конец.
+ * Индекс записей строится при открытии по заголовкам записей, данные читаются напрямую из отображенного в память файла.
+ * Запись и удаление выполняются в фоновом потоке в порядке вызова.
+ * Устаревшие записи удаляются при закрытии, если они занимают больше половины файла */
+class ZCORESHARED_EXPORT ModelDiskCache
+{
+public:
+    ModelDiskCache(
+        //! Имя файла
+        const QString& file_name,
+        //! Версия данных. При несовпадении с версией в файле кэш очищается
+        const QString& version);
+    ~ModelDiskCache();
+
+    //! Открыть файл. Поврежденный файл или файл другой версии создается заново
+    Error open();
+    //! Закрыть файл. Дожидается окончания фоновой записи
+    void close();
+    //! Открыт ли файл
+    bool isOpen() const;
+
+    //! Есть ли данные для сущности
+    bool contains(const Uid& entity_uid) const;
+
+    //! Прочитать данные. Если данных нет или они записаны для другой версии структуры, то nullptr
+    DataContainerPtr read(const Uid& entity_uid,
+        //! Структура данных
+        const DataStructurePtr& data_structure,
+        //! Прямые права доступа
+        AccessRights& direct_rights,
+        //! Косвенные права доступа
+        AccessRights& relation_rights) const;
+    /*! Записать данные. Данные сериализуются сразу, т.к. принадлежат вызывающему потоку. Контрольная сумма и запись в файл
+     * выполняются в фоне. Если контрольная сумма совпадает с записанной ранее, то запись не производится */
+    void write(const Uid& entity_uid,
+        //! Данные
+        const DataContainer& data,
+        //! Прямые права доступа
+        const AccessRights& direct_rights,
+        //! Косвенные права доступа
+        const AccessRights& relation_rights);
+    //! Удалить данные. Выполняется в фоне после ранее запрошенной записи
+    void remove(const Uid& entity_uid);
+
+private:
+    //! Положение записи в файле
+    struct Entry
+    {
+        //! Начало данных записи
+        qint64 offset = 0;
+        //! Размер данных записи
+        qint64 size = 0;
+        //! Метка версии
+        QByteArray stamp;
+    };
+
+    //! Записать сериализованные данные. Вызывается в фоновом потоке
+    Error writeHelper(const Uid& entity_uid, int structure_version, const QByteArray& content);
+    //! Удалить данные. Вызывается в фоновом потоке
+    Error removeHelper(const Uid& entity_uid);
+
+    //! Построить индекс по файлу. Возвращает false, если файл поврежден или другой версии
+    bool readIndex();
+    //! Создать пустой файл с заголовком
+    Error writeHeader();
+    //! Дописать запись в конец файла
+    Error appendRecord(const Uid& entity_uid, const QByteArray& stamp, const QByteArray& payload);
+    //! Отобразить файл в память
+    const uchar* mapFile() const;
+    //! Закрыть отображение файла
+    void unmapFile() const;
+    //! Удалить устаревшие записи
+    Error compact();
+
+    //! Имя файла
+    QString _file_name;
+    //! Версия данных
+    QString _version;
+
+    mutable QFile _file;
+    //! Отображение файла в память
+    mutable uchar* _map = nullptr;
+    //! Индекс записей
+    QHash<Uid, Entry> _index;
+    //! Объем актуальных записей
+    qint64 _live_size = 0;
+    //! Объем устаревших записей
+    qint64 _garbage_size = 0;
+
+    mutable QMutex _mutex;
+    //! Поток записи. Один, чтобы запись и удаление выполнялись в порядке вызова
+    QThreadPool _writer;
+};
+
+} // namespace zf
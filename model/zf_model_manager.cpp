@@ -2,6 +2,8 @@
 #include "zf_core.h"
 #include "zf_framework.h"
 #include "zf_model.h"
+#include "zf_model_prefetcher.h"
+#include "zf_model_disk_cache.h"
 
 #include <QApplication>
 #include <QDebug>
@@ -11,6 +13,7 @@ namespace zf
 ModelManager::~ModelManager()
 {
     _sync_operation_timeout->stop();
+    _prefetcher.reset();
 }
 
 QList<ModelPtr> ModelManager::getModelsSyncHelper(const UidList& entity_uid_list, const QList<LoadOptions>& load_options_list,
@@ -199,6 +202,58 @@ void ModelManager::disableCache(const EntityCode& entity_code)
     SharedObjectManager::disableCache(entity_code.value());
 }
 
+SharedObjectManager::CacheStatistics ModelManager::cacheStatistics(const EntityCode& entity_code) const
+{
+    QMutexLocker lock(&_mutex);
+    Z_CHECK(entity_code.isValid());
+    return SharedObjectManager::cacheStatistics(entity_code.value());
+}
+
+QMap<EntityCode, SharedObjectManager::CacheStatistics> ModelManager::cacheStatistics() const
+{
+    QMutexLocker lock(&_mutex);
+
+    QMap<EntityCode, CacheStatistics> res;
+    const auto statistics = SharedObjectManager::cacheStatistics();
+    for (auto i = statistics.constBegin(); i != statistics.constEnd(); ++i) {
+        res[EntityCode(i.key())] = i.value();
+    }
+    return res;
+}
+
+void ModelManager::setCacheMemoryLimit(qint64 bytes)
+{
+    QMutexLocker lock(&_mutex);
+    SharedObjectManager::setCacheMemoryLimit(bytes);
+}
+
+qint64 ModelManager::cacheMemorySize() const
+{
+    QMutexLocker lock(&_mutex);
+    return SharedObjectManager::cacheMemorySize();
+}
+
+void ModelManager::setPrefetchEnabled(bool b)
+{
+    if (b == isPrefetchEnabled())
+        return;
+
+    if (b)
+        _prefetcher = std::make_unique<ModelPrefetcher>(this);
+    else
+        _prefetcher.reset();
+}
+
+bool ModelManager::isPrefetchEnabled() const
+{
+    return _prefetcher != nullptr;
+}
+
+ModelPrefetcher* ModelManager::prefetcher() const
+{
+    return _prefetcher.get();
+}
+
 QObject* ModelManager::createObject(const Uid& uid, bool is_detached, Error& error) const
 {
     Z_CHECK(uid.isValid() && (uid.type() == UidType::Entity || (uid.type() == UidType::UniqueEntity)));
@@ -274,6 +329,19 @@ bool ModelManager::isShareBetweenThreads(const Uid& uid) const
     return zf::Core::getPlugin(uid.entityCode())->isModelSharedBetweenThreads(uid);
 }
 
+qint64 ModelManager::objectMemorySize(QObject* object) const
+{
+    auto m = dynamic_cast<Model*>(object);
+    Z_CHECK_NULL(m);
+    return m->data()->estimatedMemorySize();
+}
+
+void ModelManager::onObjectEvent(SharedObjectEventType type, const Uid& uid) const
+{
+    if (_prefetcher != nullptr && Utils::isMainThread())
+        _prefetcher->objectEvent(type, uid);
+}
+
 void ModelManager::sl_callback(int key, const QVariant& data)
 {
     Q_UNUSED(data)
@@ -454,8 +522,11 @@ void ModelManager::process_DBEventEntityRemoved(const I_ObjectExtension* sender_
     Q_UNUSED(sender_uid);
 
     auto uids = message.entityUids();
+    auto cache = Core::fr()->modelDiskCache();
     for (auto& uid : qAsConst(uids)) {
         removeObject(uid);
+        if (cache != nullptr)
+            cache->remove(uid);
     }
 }
 
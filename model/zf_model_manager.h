@@ -11,6 +11,7 @@ namespace zf
 {
 class Model;
 class ModelFactory;
+class ModelPrefetcher;
 
 //! Параметры кэширования сущностей. Ключ - тип сущности, значение - размер кэша
 typedef QMap<EntityCode, int> EntityCacheConfig;
@@ -134,6 +135,22 @@ public:
     //! Запретить кэширование для данного типа сущностей. Вызывать в конструкторе плагина модуля
     void disableCache(const EntityCode& entity_code);
 
+    //! Статистика кэша для сущности
+    CacheStatistics cacheStatistics(const EntityCode& entity_code) const;
+    //! Статистика кэша по всем сущностям
+    QMap<EntityCode, CacheStatistics> cacheStatistics() const;
+    //! Ограничение памяти для кэша моделей всех сущностей (байт). 0 - без ограничений
+    void setCacheMemoryLimit(qint64 bytes);
+    //! Оценка памяти, занимаемой моделями в кэше (байт)
+    qint64 cacheMemorySize() const;
+
+    /*! Включить предварительную загрузку моделей, которые обычно открываются вслед за текущей (ModelPrefetcher).
+     * По умолчанию отключено. Имеет смысл только для сущностей с включенным кэшем */
+    void setPrefetchEnabled(bool b);
+    bool isPrefetchEnabled() const;
+    //! Предварительная загрузка моделей. nullptr, если отключена
+    ModelPrefetcher* prefetcher() const;
+
 protected:
     //! Создать новый объект
     QObject* createObject(const Uid& uid,
@@ -156,6 +173,10 @@ protected:
     void markAsTemporary(QObject* object) const override;
     //! Можно ли разделять объект между потоками
     bool isShareBetweenThreads(const Uid& uid) const override;
+    //! Оценка памяти, занимаемой моделью
+    qint64 objectMemorySize(QObject* object) const override;
+    //! Операция с моделью
+    void onObjectEvent(SharedObjectEventType type, const Uid& uid) const override;
 
 private slots:
     //! Обратный вызов
@@ -360,6 +381,9 @@ private:
     //! Ожидание ответа на синхронный запрос удаления модели
     MessageID _remove_sync_feedback_message_id;
 
+    //! Предварительная загрузка моделей
+    std::unique_ptr<ModelPrefetcher> _prefetcher;
+
     mutable QRecursiveMutex _mutex;
 };
 
@@ -0,0 +1,254 @@
+#include "zf_model_prefetcher.h"
+#include "zf_core.h"
+#include "zf_database_manager.h"
+#include "zf_model.h"
+#include "zf_model_manager.h"
+
+#include <QDateTime>
+
+namespace zf
+{
+//! Максимальное количество моделей, для которых хранятся переходы
+static const int _MAX_SOURCES = 1000;
+//! Максимальное количество переходов от одной модели
+static const int _MAX_TRANSITIONS = 16;
+//! Сколько последних открытых моделей учитывать при обучении
+static const int _RECENT_DEPTH = 3;
+//! Интервал, в течение которого открытие модели считается переходом от предыдущей (мс)
+static const qint64 _TRANSITION_WINDOW_MS = 30000;
+//! Минимальное количество переходов, чтобы модель загружалась заранее
+static const int _MIN_TRANSITIONS = 2;
+//! Максимальное количество моделей, загружаемых заранее после открытия одной модели
+static const int _MAX_PREDICTED = 8;
+//! Задержка по умолчанию перед началом фоновой загрузки (мс)
+static const int _DEFAULT_DELAY_MS = 500;
+
+ModelPrefetcher::ModelPrefetcher(ModelManager* manager)
+    : QObject()
+    , _manager(manager)
+    , _transitions(_MAX_SOURCES)
+    , _timer(new QTimer(this))
+{
+    Z_CHECK_NULL(_manager);
+
+    _timer->setSingleShot(true);
+    _timer->setInterval(_DEFAULT_DELAY_MS);
+    connect(_timer, &QTimer::timeout, this, &ModelPrefetcher::sl_startNext);
+}
+
+ModelPrefetcher::~ModelPrefetcher()
+{
+    cancel();
+}
+
+void ModelPrefetcher::objectEvent(SharedObjectEventType type, const Uid& entity_uid)
+{
+    if (_requesting || !entity_uid.isEntity() || entity_uid.isTemporary())
+        return;
+
+    // модель стала использоваться: взята из кэша, создана или уже загружается заранее
+    if (type != SharedObjectEventType::TakeFromCache && type != SharedObjectEventType::New && type != SharedObjectEventType::NewDetached
+        && !(type == SharedObjectEventType::TakeFromStorage && _predicted.contains(entity_uid)))
+        return;
+
+    // вызов идет из середины SharedObjectManager::getObject, поэтому освобождать модели здесь нельзя
+    QTimer::singleShot(0, this, [this, entity_uid]() { modelOpened(entity_uid); });
+}
+
+void ModelPrefetcher::modelOpened(const Uid& entity_uid)
+{
+    if (!_recent.isEmpty() && _recent.constFirst().first == entity_uid)
+        return;
+
+    if (_predicted.remove(entity_uid)) {
+        // модель была предсказана - продолжаем загрузку остальных
+        _statistics.hits++;
+        _queue.removeAll(entity_uid);
+
+    } else {
+        // пользователь ушел в другое место
+        cancel();
+    }
+
+    learn(entity_uid);
+
+    for (auto& uid : predict(entity_uid)) {
+        if (_predicted.contains(uid) || _manager->isObjectAvailable(uid) || _manager->cacheSize(uid.entityCode()) <= 0)
+            continue;
+
+        _predicted << uid;
+        _queue << uid;
+    }
+
+    if (!_queue.isEmpty() && _loading.isEmpty())
+        _timer->start();
+}
+
+bool ModelPrefetcher::isPredicted(const Uid& entity_uid) const
+{
+    return _predicted.contains(entity_uid);
+}
+
+void ModelPrefetcher::cancel()
+{
+    _timer->stop();
+
+    _statistics.cancelled += _queue.count() + _loading.count();
+    _queue.clear();
+    _predicted.clear();
+
+    // запрос к серверу уже отправлен, поэтому модель просто отпускаем и ее загрузка завершится в кэше
+    for (auto& uid : _loading.keys()) {
+        releaseLoading(uid);
+    }
+}
+
+void ModelPrefetcher::clear()
+{
+    cancel();
+    _transitions.clear();
+    _recent.clear();
+}
+
+void ModelPrefetcher::setDelay(int ms)
+{
+    Z_CHECK(ms >= 0);
+    _timer->setInterval(ms);
+}
+
+int ModelPrefetcher::delay() const
+{
+    return _timer->interval();
+}
+
+ModelPrefetcher::Statistics ModelPrefetcher::statistics() const
+{
+    return _statistics;
+}
+
+void ModelPrefetcher::sl_startNext()
+{
+    // загружаем по одной модели, чтобы не мешать запросам пользователя
+    if (!_loading.isEmpty())
+        return;
+
+    while (!_queue.isEmpty()) {
+        Uid uid = _queue.takeFirst();
+        if (_manager->isObjectAvailable(uid))
+            continue;
+
+        bool is_from_cache;
+        bool is_cloned;
+        bool is_new;
+        Error error;
+        _requesting = true;
+        ModelPtr model = std::dynamic_pointer_cast<Model>(_manager->getObject(uid, false, is_from_cache, is_cloned, is_new, error));
+        _requesting = false;
+
+        if (error.isError()) {
+            Core::logError(error);
+            continue;
+        }
+        Z_CHECK_NULL(model);
+
+        model->load();
+        if (!model->isLoading())
+            continue;
+
+        _statistics.started++;
+        _loading[uid] = model;
+        connect(model.get(), &Model::sg_finishLoad, this, &ModelPrefetcher::sl_modelFinishLoad);
+        return;
+    }
+}
+
+void ModelPrefetcher::sl_modelFinishLoad(const Error& error, const LoadOptions& load_options, const DataPropertySet& properties)
+{
+    Q_UNUSED(load_options)
+    Q_UNUSED(properties)
+
+    Model* model = qobject_cast<Model*>(sender());
+    Z_CHECK_NULL(model);
+
+    if (model->isLoading())
+        return;
+
+    if (error.isOk())
+        _statistics.loaded++;
+
+    // после освобождения модель попадет в кэш ModelManager
+    releaseLoading(model->entityUid());
+
+    if (!_queue.isEmpty())
+        _timer->start();
+}
+
+void ModelPrefetcher::learn(const Uid& entity_uid)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    for (int i = _recent.count() - 1; i >= 0; i--) {
+        if (_recent.at(i).first == entity_uid || now - _recent.at(i).second > _TRANSITION_WINDOW_MS)
+            _recent.removeAt(i);
+    }
+
+    for (auto& r : qAsConst(_recent)) {
+        QHash<Uid, int>* targets = _transitions.object(r.first);
+        if (targets == nullptr) {
+            targets = new QHash<Uid, int>;
+            _transitions.insert(r.first, targets);
+        }
+
+        (*targets)[entity_uid]++;
+
+        if (targets->count() > _MAX_TRANSITIONS) {
+            // вытесняем самый редкий переход
+            auto rare = targets->begin();
+            for (auto i = targets->begin(); i != targets->end(); ++i) {
+                if (i.key() != entity_uid && (rare.key() == entity_uid || i.value() < rare.value()))
+                    rare = i;
+            }
+            targets->erase(rare);
+        }
+    }
+
+    _recent.prepend({entity_uid, now});
+    while (_recent.count() > _RECENT_DEPTH) {
+        _recent.removeLast();
+    }
+}
+
+UidList ModelPrefetcher::predict(const Uid& entity_uid)
+{
+    // сначала явно объявленные связи
+    UidList res = Core::databaseManager()->updateLinkTargets(entity_uid);
+
+    QHash<Uid, int>* targets = _transitions.object(entity_uid);
+    if (targets != nullptr) {
+        QList<QPair<int, Uid>> sorted;
+        for (auto i = targets->constBegin(); i != targets->constEnd(); ++i) {
+            if (i.value() >= _MIN_TRANSITIONS)
+                sorted << QPair<int, Uid>(i.value(), i.key());
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const QPair<int, Uid>& a, const QPair<int, Uid>& b) { return a.first > b.first; });
+
+        for (auto& s : qAsConst(sorted)) {
+            if (!res.contains(s.second))
+                res << s.second;
+        }
+    }
+
+    if (res.count() > _MAX_PREDICTED)
+        res = res.mid(0, _MAX_PREDICTED);
+
+    return res;
+}
+
+void ModelPrefetcher::releaseLoading(const Uid& entity_uid)
+{
+    ModelPtr model = _loading.take(entity_uid);
+    if (model != nullptr)
+        disconnect(model.get(), &Model::sg_finishLoad, this, &ModelPrefetcher::sl_modelFinishLoad);
+}
+
+} // namespace zf
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QCache>
+#include <QObject>
+#include <QTimer>
+#include "zf_defs.h"
+#include "zf_error.h"
+#include "zf_uid.h"
+
+namespace zf
+{
+class ModelManager;
+
+/*! Предварительная загрузка моделей
+ * Запоминает, какие модели обычно открываются вслед за данной, и после ее открытия в фоне загружает их по одной,
+ * чтобы к моменту открытия они уже были в кэше ModelManager. Кроме того загружаются сущности, зарегистрированные через
+ * DatabaseManager::registerUpdateLink. Если пользователь открыл модель, которая не была предсказана, то ожидающие
+ * загрузки отменяются */
+class ZCORESHARED_EXPORT ModelPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    ModelPrefetcher(ModelManager* manager);
+    ~ModelPrefetcher() override;
+
+    //! Операция с моделью в ModelManager. Вызывается ModelManager
+    void objectEvent(SharedObjectEventType type, const Uid& entity_uid);
+    //! Модель была предсказана и еще не открыта
+    bool isPredicted(const Uid& entity_uid) const;
+    //! Отменить все ожидающие загрузки
+    void cancel();
+    //! Забыть накопленную статистику переходов
+    void clear();
+
+    //! Задержка перед началом фоновой загрузки (мс)
+    void setDelay(int ms);
+    int delay() const;
+
+    //! Статистика работы
+    struct Statistics
+    {
+        //! Запущено фоновых загрузок
+        qint64 started = 0;
+        //! Фоновая загрузка завершена
+        qint64 loaded = 0;
+        //! Предсказанная модель была открыта
+        qint64 hits = 0;
+        //! Загрузка отменена
+        qint64 cancelled = 0;
+    };
+    Statistics statistics() const;
+
+private slots:
+    //! Запустить следующую загрузку из очереди
+    void sl_startNext();
+    //! Завершена фоновая загрузка модели
+    void sl_modelFinishLoad(const zf::Error& error,
+        //! Параметры загрузки
+        const zf::LoadOptions& load_options,
+        //! Какие свойства обновлялись
+        const zf::DataPropertySet& properties);
+
+private:
+    //! Модель стала использоваться (получена из кэша или создана)
+    void modelOpened(const Uid& entity_uid);
+    //! Учесть переход к модели от недавно открытых
+    void learn(const Uid& entity_uid);
+    //! Модели, которые вероятно будут открыты после указанной
+    UidList predict(const Uid& entity_uid);
+    //! Остановить загрузку модели
+    void releaseLoading(const Uid& entity_uid);
+
+    ModelManager* _manager = nullptr;
+
+    //! Переходы между моделями. Ключ - открытая модель, значение - какие модели открывались после нее и сколько раз
+    QCache<Uid, QHash<Uid, int>> _transitions;
+    //! Недавно открытые модели и время открытия. В начале - самые новые
+    QList<QPair<Uid, qint64>> _recent;
+
+    //! Предсказанные модели для текущего перехода
+    QSet<Uid> _predicted;
+    //! Ожидают загрузки
+    UidList _queue;
+    //! Загружаются в фоне
+    QHash<Uid, ModelPtr> _loading;
+    //! Таймер отложенного запуска загрузки
+    QTimer* _timer = nullptr;
+    //! Идет запрос модели самим ModelPrefetcher
+    bool _requesting = false;
+
+    Statistics _statistics;
+};
+
+} // namespace zf
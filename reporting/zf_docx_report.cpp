@@ -5,6 +5,8 @@
 
 #include <QDomDocument>
 #include <JlCompress.h>
+#include <quazip.h>
+#include <quazipfile.h>
 #include <QFile>
 #include <QBuffer>
 
@@ -91,20 +93,10 @@ Error DocxReportGenerator::openDocument(const QString& template_file, XMLDocumen
     if (!file.open(QFile::ReadOnly))
         return Error::fileIOError(&file);
 
-    QString source = QString::fromUtf8(file.readAll());
+    QByteArray data = file.readAll();
     file.close();
 
-    QString content;
-    auto error = compress(source, content);
-    if (error.isError())
-        return error;
-
-    document = XMLDocument::readXmlMemory(content, /*XML_ParserOption::XML_PARSE_NOBLANKS |*/ XML_ParserOption::XML_PARSE_NONET
-                                                       | XML_ParserOption::XML_PARSE_HUGE);
-    if (document == nullptr)
-        return Error::badFileError(template_file);
-
-    return Error();
+    return readDocument(data, template_file, document);
 }
 
 Error DocxReportGenerator::saveDocument(const QString& target_file, const XMLDocumentPtr& document)
@@ -114,6 +106,314 @@ Error DocxReportGenerator::saveDocument(const QString& target_file, const XMLDoc
     return Error();
 }
 
+bool DocxReportGenerator::isMemoryProcessingSupported() const
+{
+    return true;
+}
+
+Error DocxReportGenerator::unpackTemplateMemory(const QByteArray& template_file, QStringList& to_parse)
+{
+    _template_data = template_file;
+    _memory_parts.clear();
+    _image_info.clear();
+
+    // шаблон уже был подготовлен ранее
+    QString cache_key = compiledTemplateKey(template_file);
+    auto compiled = compiledTemplate(cache_key);
+    if (compiled != nullptr) {
+        _memory_parts = compiled->content;
+        to_parse = compiled->parts;
+        return Error();
+    }
+
+    QBuffer buffer(&_template_data);
+    Z_CHECK(buffer.open(QBuffer::ReadOnly));
+
+    QuaZip zip(&buffer);
+    zip.setAutoClose(false);
+    if (!zip.open(QuaZip::mdUnzip) || zip.getEntriesCount() <= 0)
+        return Error("DocxReportGenerator - unzip error");
+
+    Error error;
+    for (bool more = zip.goToFirstFile(); more; more = zip.goToNextFile()) {
+        QString name = zip.getCurrentFileName();
+        if (!comp(QFileInfo(name).suffix(), "xml"))
+            continue;
+
+        QByteArray data;
+        error = readZipEntry(&zip, data);
+        if (error.isError())
+            break;
+
+        // все маркеры тэгов начинаются с фигурной скобки. Части без нее не разбираются и копируются в результат как есть
+        if (!data.contains('{'))
+            continue;
+
+        QString content;
+        error = compress(QString::fromUtf8(data), content);
+        if (error.isError())
+            break;
+
+        _memory_parts[name] = content.toUtf8();
+        to_parse << name;
+    }
+
+    zip.close();
+    if (error.isOk() && zip.getZipError() != UNZ_OK)
+        error = Error("DocxReportGenerator - unzip error");
+
+    if (error.isOk()) {
+        auto prepared = Z_MAKE_SHARED(CompiledTemplate);
+        prepared->parts = to_parse;
+        prepared->content = _memory_parts;
+        insertCompiledTemplate(cache_key, prepared);
+    }
+
+    return error;
+}
+
+Error DocxReportGenerator::packTargetMemory(QIODevice* target)
+{
+    Z_CHECK_NULL(target);
+
+    QBuffer source(&_template_data);
+    Z_CHECK(source.open(QBuffer::ReadOnly));
+
+    QuaZip zip_source(&source);
+    zip_source.setAutoClose(false);
+    if (!zip_source.open(QuaZip::mdUnzip))
+        return Error("DocxReportGenerator - unzip error");
+
+    QuaZip zip_target(target);
+    zip_target.setAutoClose(false);
+    if (!zip_target.open(QuaZip::mdCreate)) {
+        zip_source.close();
+        return Error::fileIOError(target);
+    }
+
+    Error error;
+    for (bool more = zip_source.goToFirstFile(); more && error.isOk(); more = zip_source.goToNextFile()) {
+        QString name = zip_source.getCurrentFileName();
+        QString file_name = QFileInfo(name).fileName();
+
+        bool changed = _memory_parts.contains(name);
+        QByteArray data = _memory_parts.value(name);
+
+        if (!_image_info.isEmpty() && (file_name == "document.xml.rels" || file_name == "[Content_Types].xml")) {
+            if (!changed)
+                error = readZipEntry(&zip_source, data);
+            if (error.isOk())
+                error = prepareImageLinks(file_name, data);
+            changed = true;
+        }
+
+        if (error.isError())
+            break;
+
+        if (changed)
+            error = writeZipEntry(&zip_target, name, data, true);
+        else
+            error = copyZipEntry(&zip_source, &zip_target);
+    }
+
+    if (error.isOk()) {
+        // добавляем файлы картинок в папку media. JPEG уже сжат, поэтому пишем без компрессии
+        for (auto i = _image_info.constBegin(); i != _image_info.constEnd(); ++i) {
+            QByteArray image_data;
+            QBuffer image_buffer(&image_data);
+            Z_CHECK(image_buffer.open(QBuffer::WriteOnly));
+            i.value().save(&image_buffer, "jpg");
+            image_buffer.close();
+
+            error = writeZipEntry(&zip_target, "word/media/" + i.key() + ".jpg", image_data, false);
+            if (error.isError())
+                break;
+        }
+    }
+
+    zip_source.close();
+    zip_target.close();
+    if (error.isOk() && zip_target.getZipError() != ZIP_OK)
+        error = Error::fileIOError(target);
+
+    _memory_parts.clear();
+    _template_data.clear();
+
+    return error;
+}
+
+Error DocxReportGenerator::openDocumentMemory(const QString& part_name, XMLDocumentPtr& document)
+{
+    Z_CHECK(_memory_parts.contains(part_name));
+    // компрессия переменных выполнена при подготовке шаблона
+    return parseDocument(QString::fromUtf8(_memory_parts.value(part_name)), part_name, document);
+}
+
+Error DocxReportGenerator::saveDocumentMemory(const QString& part_name, const XMLDocumentPtr& document)
+{
+    QByteArray data;
+    if (document->saveToMemory(data, /*XML_SaveOption::XML_SAVE_NO_EMPTY |*/ XML_SaveOption::XML_SAVE_NO_XHTML) < 0)
+        return Error(QString("DocxReportGenerator - xml save error: %1").arg(part_name));
+
+    _memory_parts[part_name] = data;
+    return Error();
+}
+
+Error DocxReportGenerator::mergeDocuments(const QList<QByteArray>& documents, QIODevice* target)
+{
+    Z_CHECK_NULL(target);
+    Z_CHECK(!documents.isEmpty());
+
+    static const QString document_part = QStringLiteral("word/document.xml");
+    static const QString media_prefix = QStringLiteral("word/media/image_");
+    static const QString page_break = QStringLiteral(R"(<w:p><w:r><w:br w:type="page"/></w:r></w:p>)");
+
+    QString merged;
+    int insert_pos = 0;
+    // картинки из присоединяемых документов. Ключ - новый id
+    QMap<QString, QByteArray> images;
+
+    for (int n = 0; n < documents.count(); n++) {
+        QByteArray data = documents.at(n);
+        QBuffer buffer(&data);
+        Z_CHECK(buffer.open(QBuffer::ReadOnly));
+
+        QuaZip zip(&buffer);
+        zip.setAutoClose(false);
+        if (!zip.open(QuaZip::mdUnzip))
+            return Error("DocxReportGenerator - unzip error");
+
+        Error error;
+        QByteArray document_data;
+        if (!zip.setCurrentFile(document_part))
+            error = Error("DocxReportGenerator - unzip error");
+        else
+            error = readZipEntry(&zip, document_data);
+
+        QString content = QString::fromUtf8(document_data);
+
+        if (n > 0) {
+            // картинки, созданные генератором, имеют одинаковые id во всех документах, поэтому их надо переименовать
+            QString prefix = QStringLiteral("image_m%1_").arg(n);
+            for (bool more = zip.goToFirstFile(); more && error.isOk(); more = zip.goToNextFile()) {
+                QString name = zip.getCurrentFileName();
+                if (!name.startsWith(media_prefix))
+                    continue;
+
+                QByteArray image;
+                error = readZipEntry(&zip, image);
+                images[prefix + QFileInfo(name).completeBaseName().mid(6)] = image;
+            }
+            // меняем только ссылки на картинки, а не текст документа
+            static const QRegularExpression image_ref_exp(R"(\b(r:embed|r:id|Id)="image_)");
+            content.replace(image_ref_exp, QStringLiteral(R"(\1=")") + prefix);
+        }
+
+        zip.close();
+        if (error.isError())
+            return error;
+
+        int begin;
+        int end;
+        if (!findBodyContent(content, begin, end))
+            return Error("DocxReportGenerator - document body not found");
+
+        if (n == 0) {
+            merged = content;
+            insert_pos = end;
+
+        } else {
+            QString fragment = page_break + content.mid(begin, end - begin);
+            merged.insert(insert_pos, fragment);
+            insert_pos += fragment.length();
+        }
+    }
+
+    // идентификаторы графических объектов должны быть уникальны в пределах документа
+    static const QRegularExpression doc_pr_exp(R"(<wp:docPr id="\d+")");
+    QString renumbered;
+    int pos = 0;
+    int doc_pr_id = 1;
+    auto doc_pr_it = doc_pr_exp.globalMatch(merged);
+    while (doc_pr_it.hasNext()) {
+        auto match = doc_pr_it.next();
+        renumbered += merged.midRef(pos, match.capturedStart() - pos);
+        renumbered += QStringLiteral(R"(<wp:docPr id="%1")").arg(doc_pr_id++);
+        pos = match.capturedEnd();
+    }
+    renumbered += merged.midRef(pos);
+    merged.clear();
+
+    // основной документ служит основой для результата
+    QByteArray base = documents.first();
+    QBuffer source(&base);
+    Z_CHECK(source.open(QBuffer::ReadOnly));
+
+    QuaZip zip_source(&source);
+    zip_source.setAutoClose(false);
+    if (!zip_source.open(QuaZip::mdUnzip))
+        return Error("DocxReportGenerator - unzip error");
+
+    QuaZip zip_target(target);
+    zip_target.setAutoClose(false);
+    if (!zip_target.open(QuaZip::mdCreate)) {
+        zip_source.close();
+        return Error::fileIOError(target);
+    }
+
+    Error error;
+    for (bool more = zip_source.goToFirstFile(); more && error.isOk(); more = zip_source.goToNextFile()) {
+        QString name = zip_source.getCurrentFileName();
+        QString file_name = QFileInfo(name).fileName();
+
+        if (name == document_part) {
+            error = writeZipEntry(&zip_target, name, renumbered.toUtf8(), true);
+
+        } else if (!images.isEmpty() && file_name == "document.xml.rels") {
+            QByteArray xml;
+            error = readZipEntry(&zip_source, xml);
+            for (auto i = images.constBegin(); i != images.constEnd() && error.isOk(); ++i) {
+                error = appendToXML(xml, "Relationships", "Relationship",
+                                    {
+                                        {"Id", i.key()},
+                                        {"Type", R"(http://schemas.openxmlformats.org/officeDocument/2006/relationships/image)"},
+                                        {"Target", "media/" + i.key() + ".jpg"},
+                                    },
+                                    {});
+            }
+            if (error.isOk())
+                error = writeZipEntry(&zip_target, name, xml, true);
+
+        } else if (!images.isEmpty() && file_name == "[Content_Types].xml") {
+            QByteArray xml;
+            error = readZipEntry(&zip_source, xml);
+            if (error.isOk())
+                error = appendToXML(xml, "Types", "Default",
+                                    {
+                                        {"Extension", "jpg"},
+                                        {"ContentType", "image/jpeg"},
+                                    },
+                                    {{"Default", {"Extension", "jpg"}}});
+            if (error.isOk())
+                error = writeZipEntry(&zip_target, name, xml, true);
+
+        } else {
+            error = copyZipEntry(&zip_source, &zip_target);
+        }
+    }
+
+    for (auto i = images.constBegin(); i != images.constEnd() && error.isOk(); ++i) {
+        error = writeZipEntry(&zip_target, "word/media/" + i.key() + ".jpg", i.value(), false);
+    }
+
+    zip_source.close();
+    zip_target.close();
+    if (error.isOk() && zip_target.getZipError() != ZIP_OK)
+        error = Error::fileIOError(target);
+
+    return error;
+}
+
 Error DocxReportGenerator::extractText(const XMLNodePtr& node, QString& text, QString& text_before, ReportGenerator::TagType& type,
                                        bool& is_scan_next)
 {
@@ -244,40 +544,60 @@ Error DocxReportGenerator::prepareFiles(const QString& temp_folder) const
 
     for (auto& s : qAsConst(files)) {
         QString file_name = QFileInfo(s).fileName();
-        if (file_name == "document.xml.rels") {
-            // добавляем ссылки на картинки
-            for (auto i = _image_info.constBegin(); i != _image_info.constEnd(); ++i) {
-                appendToXML(s, "Relationships", "Relationship",
-                            {
-                                {"Id", i.key()},
-                                {"Type", R"(http://schemas.openxmlformats.org/officeDocument/2006/relationships/image)"},
-                                {"Target", "media/" + i.key() + ".jpg"},
-                            },
-                            {});
-            }
-        } else if (file_name == "[Content_Types].xml") {
-            // добавляем тип файла jpg
-            appendToXML(s, "Types", "Default",
-                        {
-                            {"Extension", "jpg"},
-                            {"ContentType", "image/jpeg"},
-                        },
-                        {{"Default", {"Extension", "jpg"}}});
+        if (file_name != "document.xml.rels" && file_name != "[Content_Types].xml")
+            continue;
+
+        QFile file(s);
+        if (!file.open(QFile::ReadOnly))
+            return Error::fileIOError(s);
+        QByteArray xml = file.readAll();
+        file.close();
+
+        error = prepareImageLinks(file_name, xml);
+        if (error.isError())
+            return error;
+
+        if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(xml) != xml.size())
+            return Error::fileIOError(s);
+        file.close();
+    }
+
+    return {};
+}
+
+Error DocxReportGenerator::prepareImageLinks(const QString& file_name, QByteArray& xml) const
+{
+    if (file_name == "document.xml.rels") {
+        // добавляем ссылки на картинки
+        for (auto i = _image_info.constBegin(); i != _image_info.constEnd(); ++i) {
+            auto error = appendToXML(xml, "Relationships", "Relationship",
+                                     {
+                                         {"Id", i.key()},
+                                         {"Type", R"(http://schemas.openxmlformats.org/officeDocument/2006/relationships/image)"},
+                                         {"Target", "media/" + i.key() + ".jpg"},
+                                     },
+                                     {});
+            if (error.isError())
+                return error;
         }
+    } else if (file_name == "[Content_Types].xml") {
+        // добавляем тип файла jpg
+        return appendToXML(xml, "Types", "Default",
+                           {
+                               {"Extension", "jpg"},
+                               {"ContentType", "image/jpeg"},
+                           },
+                           {{"Default", {"Extension", "jpg"}}});
     }
 
     return {};
 }
 
-Error DocxReportGenerator::appendToXML(const QString& xml_file, const QString& target_node, const QString& name,
+Error DocxReportGenerator::appendToXML(QByteArray& xml, const QString& target_node, const QString& name,
                                        const QMap<QString, QString>& params, const QMap<QString, QPair<QString, QString>>& exclude) const
 {
     QDomDocument doc;
-    QFile file(xml_file);
-    if (!file.open(QFile::ReadOnly))
-        return Error::fileIOError(xml_file);
-    doc.setContent(file.readAll());
-    file.close();
+    doc.setContent(xml);
 
     for (auto i = exclude.constBegin(); i != exclude.constEnd(); ++i) {
         QDomNodeList list = doc.elementsByTagName(i.key());
@@ -301,14 +621,122 @@ Error DocxReportGenerator::appendToXML(const QString& xml_file, const QString& t
     }
 
     target.at(0).appendChild(added);
+    xml = doc.toByteArray(4);
+
+    return {};
+}
+
+Error DocxReportGenerator::readDocument(const QByteArray& data, const QString& name, XMLDocumentPtr& document)
+{
+    QString content;
+    auto error = compress(QString::fromUtf8(data), content);
+    if (error.isError())
+        return error;
 
-    if (!file.open(QFile::WriteOnly))
-        return Error::fileIOError(xml_file);
-    QTextStream st(&file);
-    doc.save(st, 4);
+    return parseDocument(content, name, document);
+}
+
+Error DocxReportGenerator::parseDocument(const QString& content, const QString& name, XMLDocumentPtr& document)
+{
+    document = XMLDocument::readXmlMemory(content, /*XML_ParserOption::XML_PARSE_NOBLANKS |*/ XML_ParserOption::XML_PARSE_NONET
+                                                       | XML_ParserOption::XML_PARSE_HUGE);
+    if (document == nullptr)
+        return Error::badFileError(name);
+
+    return Error();
+}
+
+bool DocxReportGenerator::findBodyContent(const QString& content, int& begin, int& end)
+{
+    static const QRegularExpression body_exp(R"(<w:body(\s[^>]*)?>)");
+    static const QString body_close = QStringLiteral("</w:body>");
+    static const QString sect_begin = QStringLiteral("<w:sectPr");
+    static const QString sect_close = QStringLiteral("</w:sectPr>");
+
+    auto match = body_exp.match(content);
+    end = content.lastIndexOf(body_close);
+    if (!match.hasMatch() || end < match.capturedEnd())
+        return false;
+
+    begin = match.capturedEnd();
+
+    // параметры раздела последнего уровня находятся в самом конце тела документа
+    int sect = content.lastIndexOf(sect_begin, end);
+    if (sect >= begin) {
+        int sect_end = content.indexOf(sect_close, sect);
+        int tail = sect_end + sect_close.length();
+        if (sect_end >= 0 && tail <= end && content.midRef(tail, end - tail).trimmed().isEmpty())
+            end = sect;
+    }
+
+    return true;
+}
+
+Error DocxReportGenerator::readZipEntry(QuaZip* zip, QByteArray& data)
+{
+    QuaZipFile file(zip);
+    if (!file.open(QIODevice::ReadOnly))
+        return Error("DocxReportGenerator - unzip error");
+
+    data = file.readAll();
     file.close();
+    // при закрытии проверяется CRC
+    if (file.getZipError() != UNZ_OK)
+        return Error("DocxReportGenerator - unzip error");
 
-    return {};
+    return Error();
+}
+
+Error DocxReportGenerator::writeZipEntry(QuaZip* zip, const QString& name, const QByteArray& data, bool compressed)
+{
+    QuaZipFile file(zip);
+    if (!file.open(QIODevice::WriteOnly, QuaZipNewInfo(name), nullptr, 0, compressed ? Z_DEFLATED : 0))
+        return Error("DocxReportGenerator - zip error");
+
+    bool ok = (file.write(data) == data.size());
+    file.close();
+    if (!ok || file.getZipError() != ZIP_OK)
+        return Error("DocxReportGenerator - zip error");
+
+    return Error();
+}
+
+Error DocxReportGenerator::copyZipEntry(QuaZip* source, QuaZip* target)
+{
+    QuaZipFileInfo64 info;
+    if (!source->getCurrentFileInfo(&info))
+        return Error("DocxReportGenerator - unzip error");
+
+    // файл читается и записывается в сжатом виде (raw), поэтому повторной компрессии не происходит
+    int method = 0;
+    int level = 0;
+    QuaZipFile file_source(source);
+    if (!file_source.open(QIODevice::ReadOnly, &method, &level, true))
+        return Error("DocxReportGenerator - unzip error");
+
+    QuaZipFile file_target(target);
+    if (!file_target.open(QIODevice::WriteOnly, QuaZipNewInfo(info), nullptr, info.crc, method, level, true)) {
+        file_source.close();
+        return Error("DocxReportGenerator - zip error");
+    }
+
+    Error error;
+    qint64 left = static_cast<qint64>(info.compressedSize);
+    while (left > 0) {
+        QByteArray block = file_source.read(qMin<qint64>(left, 256 * 1024));
+        if (block.isEmpty() || file_target.write(block) != block.size()) {
+            error = Error("DocxReportGenerator - zip error");
+            break;
+        }
+        left -= block.size();
+    }
+
+    file_source.close();
+    file_target.close();
+    if (error.isOk() && (file_source.getZipError() != UNZ_OK || file_target.getZipError() != ZIP_OK))
+        error = Error("DocxReportGenerator - zip error");
+
+    return error;
 }
 
 Error DocxReportGenerator::compress(const QString& source_data, QString& result_data)
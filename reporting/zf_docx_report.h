@@ -2,6 +2,8 @@
 
 #include "zf_report.h"
 
+class QuaZip;
+
 namespace zf
 {
 /*!
@@ -25,8 +27,9 @@ namespace zf
  * Параграфы, в которых находятся начало и конец строки таблицы, полностью вырезаются из документа при генерации,
  * поэтому в них нельзя помещать любую важную информацию (например перенос страницы).
  *
- * Метод ReportGenerator::generate принимает на вход шаблон в формате DOCX. При этом он распаковывается и обрабатываются
- * все файлы с расширением XML (тело документа, заголовки и т.п.)
+ * Метод ReportGenerator::generate принимает на вход шаблон в формате DOCX. Шаблон обрабатывается в памяти: разбираются
+ * только файлы с расширением XML, которые содержат тэги (тело документа, заголовки и т.п.), остальные части архива
+ * (картинки, стили и т.п.) переносятся в результат без перепаковки
  */
 class ZCORESHARED_EXPORT DocxReportGenerator : public ReportGenerator
 {
@@ -47,6 +50,20 @@ protected:
     Error openDocument(const QString& template_file, XMLDocumentPtr& document) override;
     //! Записать документ в файл
     Error saveDocument(const QString& target_file, const XMLDocumentPtr& document) override;    
+
+    //! Поддерживается ли обработка шаблона в памяти без распаковки во временную папку
+    bool isMemoryProcessingSupported() const override;
+    //! Открыть упакованный шаблон в памяти и вернуть имена частей, которые содержат тэги
+    Error unpackTemplateMemory(const QByteArray& template_file, QStringList& to_parse) override;
+    //! Упаковать результат и записать его в устройство
+    Error packTargetMemory(QIODevice* target) override;
+    //! Открыть часть шаблона
+    Error openDocumentMemory(const QString& part_name, XMLDocumentPtr& document) override;
+    //! Записать обработанную часть шаблона
+    Error saveDocumentMemory(const QString& part_name, const XMLDocumentPtr& document) override;
+    /*! Объединить документы, сформированные по одному шаблону. Тела документов (word/document.xml) добавляются в
+     * конец первого с разрывом страницы, колонтитулы и параметры разделов берутся из первого документа */
+    Error mergeDocuments(const QList<QByteArray>& documents, QIODevice* target) override;
     //! Извлечь текст из элемента и определить его тип. Необходимо возвращать только тот текст, который может подходить
     //! под тэг, для остальных TagType = Invalid
     Error extractText(
@@ -99,17 +116,37 @@ private:
     XMLNodePtr createNode(const XMLNodePtr& parent, const QString& name, const QMap<QString, QVariant>& values = {});
     //! Подготовка файлов во временном каталоге перед архивацией
     Error prepareFiles(const QString& temp_folder) const;
+    //! Добавить ссылки на картинки в document.xml.rels или [Content_Types].xml
+    Error prepareImageLinks(const QString& file_name, QByteArray& xml) const;
     //! Добавить строку в xml
-    Error appendToXML(const QString& xml_file, const QString& target_node, const QString& name, const QMap<QString, QString>& params,
+    Error appendToXML(QByteArray& xml, const QString& target_node, const QString& name, const QMap<QString, QString>& params,
                       //! Исключения. Ключ: имя узла, значение: <имя атрибута, значение атрибута>
                       const QMap<QString, QPair<QString, QString>>& exclude) const;
 
     //! Компрессия переменных
     static Error compress(const QString& source_data, QString& result_data);
+    //! Компрессия переменных и разбор XML документа
+    static Error readDocument(const QByteArray& data, const QString& name, XMLDocumentPtr& document);
+    //! Разбор XML документа, прошедшего компрессию переменных
+    static Error parseDocument(const QString& content, const QString& name, XMLDocumentPtr& document);
+
+    //! Прочитать текущий файл архива
+    static Error readZipEntry(QuaZip* zip, QByteArray& data);
+    //! Записать файл в архив
+    static Error writeZipEntry(QuaZip* zip, const QString& name, const QByteArray& data, bool compressed);
+    //! Скопировать текущий файл архива в другой архив без распаковки
+    static Error copyZipEntry(QuaZip* source, QuaZip* target);
+    //! Найти в word/document.xml границы содержимого тела документа без параметров раздела
+    static bool findBodyContent(const QString& content, int& begin, int& end);
 
     //! Добавленные картинки. Ключ - id
     QMap<QString, QImage> _image_info;
 
+    //! Шаблон при обработке в памяти
+    QByteArray _template_data;
+    //! Части шаблона, которые содержат тэги (после компрессии переменных). Ключ - имя файла в архиве
+    QMap<QString, QByteArray> _memory_parts;
+
     //! Открывающие и закрывающие маркеры
     static const QList<QPair<QString, QString>> _MARKS;
 };
@@ -1,6 +1,7 @@
 #include "zf_html_report.h"
 
 #include <QFile>
+#include <QRegularExpression>
 
 // Поле: начало тэга
 #define HTML_FIELD_BEGIN QStringLiteral("{{")
@@ -162,4 +163,41 @@ Error HtmlReportGenerator::setImage(const XMLNodePtr& set_to, const QString& tex
     return Error("HtmlReportGenerator: image fields not supported");
 }
 
+Error HtmlReportGenerator::mergeDocuments(const QList<QByteArray>& documents, QIODevice* target)
+{
+    Z_CHECK_NULL(target);
+    Z_CHECK(!documents.isEmpty());
+
+    static const QRegularExpression body_exp(R"(<body(\s[^>]*)?>)", QRegularExpression::CaseInsensitiveOption);
+    static const QString body_close = QStringLiteral("</body>");
+    static const QString page_break = QStringLiteral(R"(<div style="page-break-before: always"></div>)");
+
+    QString merged;
+    int insert_pos = 0;
+    for (int n = 0; n < documents.count(); n++) {
+        QString content = QString::fromUtf8(documents.at(n));
+
+        auto match = body_exp.match(content);
+        int end = content.lastIndexOf(body_close, -1, Qt::CaseInsensitive);
+        if (!match.hasMatch() || end < match.capturedEnd())
+            return Error("HtmlReportGenerator - document body not found");
+
+        if (n == 0) {
+            merged = content;
+            insert_pos = end;
+
+        } else {
+            QString fragment = page_break + content.mid(match.capturedEnd(), end - match.capturedEnd());
+            merged.insert(insert_pos, fragment);
+            insert_pos += fragment.length();
+        }
+    }
+
+    QByteArray data = merged.toUtf8();
+    if (target->write(data) != data.size())
+        return Error::fileIOError(target);
+
+    return Error();
+}
+
 } // namespace zf
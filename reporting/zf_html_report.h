@@ -80,6 +80,8 @@ protected:
     //! Записать изображение в указанный элемент.
     Error setImage(const XMLNodePtr& set_to, const QString& text_before, const QString& text_after, const QImage& value,
                    const QString& image_id) override;
+    //! Объединить документы: содержимое body добавляется в конец первого документа с разрывом страницы
+    Error mergeDocuments(const QList<QByteArray>& documents, QIODevice* target) override;
 };
 
 } // namespace zf
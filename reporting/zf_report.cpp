@@ -6,11 +6,19 @@
 #include <QDebug>
 #include <QDir>
 #include <QDesktopServices>
+#include <QBuffer>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <typeinfo>
 
 namespace zf
 {
 //! Имя последнего успешно созданного файла
 QString ReportGenerator::_last_ok_file;
+//! Кэш подготовленных шаблонов
+QCache<QString, ReportGenerator::CompiledTemplatePtr> ReportGenerator::_compiled_templates(32 * 1024 * 1024);
+QMutex ReportGenerator::_compiled_templates_mutex;
 
 QAtomicInt _counter_test = 0;
 
@@ -627,20 +635,38 @@ Error ReportGenerator::generate(const DataContainer* data, const QMap<DataProper
                                 const QByteArray& template_file, const QString& target_file, QLocale::Language language,
                                 const QMap<DataProperty, QLocale::Language>& field_languages)
 {
-    Z_CHECK_NULL(data);
+    prepareGeneration(data, auto_map, language, field_languages);
 
-    _data = data;
-    _language = (language == QLocale::AnyLanguage ? Core::language(LocaleType::Workflow) : language);
-    _auto_map = auto_map;
-    _field_languages = field_languages;
+    QString target_file_name = prepareTargetFileName(target_file);
+    Error error;
+
+    if (isMemoryProcessingSupported()) {
+        // шаблон обрабатывается в памяти, временная папка не нужна
+        QSaveFile f_target(target_file_name);
+        if (!f_target.open(QFile::WriteOnly | QFile::Truncate))
+            error = Error::fileIOError(target_file_name);
+
+        if (error.isOk())
+            error = generateMemory(field_names, template_file, &f_target);
+
+        if (error.isOk() && !f_target.commit())
+            error = Error::fileIOError(target_file_name);
+
+        if (Utils::isMainThread()) {
+            if (error.isOk())
+                _last_ok_file = target_file_name;
+            else
+                _last_ok_file.clear();
+        }
+
+        return error;
+    }
 
     _temp_folder = Utils::generateTempDirName();
-    Error error = Utils::makeDir(_temp_folder);
+    error = Utils::makeDir(_temp_folder);
     if (error.isError())
         return error;
 
-    QString target_file_name = prepareTargetFileName(target_file);
-
     QStringList to_parse;
     error = unpackTemplate(template_file, _temp_folder, to_parse);
     if (error.isError())
@@ -665,58 +691,14 @@ Error ReportGenerator::generate(const DataContainer* data, const QMap<DataProper
         if (error.isOk())
             error = openDocument(file_name, _document);
 
-        XMLNodePtr root;
-        if (error.isOk()) {
-            Z_CHECK_NULL(_document);
-            root = _document->getRootElement();
-            if (root == nullptr)
-                error = createError("Empty template");
-        }
-
-        if (error.isOk()) {
-            QHash<QString, DataProperty> property_hash;
-            for (auto i = field_names.constBegin(); i != field_names.constEnd(); ++i) {
-                Z_CHECK(i.key().isValid());
-                Z_CHECK(!i.value().isEmpty());
-                property_hash[i.value().toLower()] = i.key();
-            }
-
-            error = prepareTree(root);
-
-            QStack<BlockInfoPtr> begin_blocks;
-            TagInfoPtr current_tag;
-            if (error.isOk())
-                error = parseHelper(root, property_hash, begin_blocks, current_tag);
-
-            if (error.isOk()) {
-                if (current_tag != nullptr)
-                    error = createError(QString("Found not closed tag <%1>").arg(current_tag->tag_text));
-
-                if (!begin_blocks.isEmpty()) {
-                    // есть не закрытые блоки
-                    QStringList not_closed;
-                    for (auto& b : begin_blocks) {
-                        not_closed << b->first_tag->tag_text;
-                    }
-                    error << createError(QString("Found blocks without close tag <%1>").arg(not_closed.join(", ")));
-                }
-            }
-        }
+        if (error.isOk())
+            error = processDocument(field_names);
 
         if (error.isOk()) {
-            // начинаем рекурсивно заполнять блоки от нижнего уровня к верхнему
-            for (auto& b : _blocks) {
-                error = generateHelper(b);
-                if (error.isError())
-                    break;
-            }
-
-            if (error.isOk()) {
-                if (is_packed_template)
-                    error = saveDocument(file_name, _document);
-                else
-                    error = saveDocument(target_file_name, _document);
-            }
+            if (is_packed_template)
+                error = saveDocument(file_name, _document);
+            else
+                error = saveDocument(target_file_name, _document);
         }
 
         clear();
@@ -756,6 +738,344 @@ Error ReportGenerator::generate(const DataContainer* data, const QMap<PropertyID
     return generate(data, f, auto_map, template_file, target_file, language, f_l);
 }
 
+Error ReportGenerator::generate(const DataContainer* data, const QMap<DataProperty, QString>& field_names, bool auto_map,
+                                const QByteArray& template_file, QIODevice* target, QLocale::Language language,
+                                const QMap<DataProperty, QLocale::Language>& field_languages)
+{
+    Z_CHECK_NULL(target);
+    Z_CHECK(target->isWritable());
+
+    if (isMemoryProcessingSupported()) {
+        prepareGeneration(data, auto_map, language, field_languages);
+        return generateMemory(field_names, template_file, target);
+    }
+
+    // генератор не умеет работать в памяти - формируем временный файл и копируем его в устройство
+    QString temp_folder = Utils::generateTempDirName();
+    Error error = Utils::makeDir(temp_folder);
+    if (error.isError())
+        return error;
+
+    QString temp_file = prepareTargetFileName(temp_folder + "/" + Utils::generateUniqueString());
+    error = generate(data, field_names, auto_map, template_file, temp_file, language, field_languages);
+
+    if (error.isOk()) {
+        QFile f_temp(temp_file);
+        if (!f_temp.open(QFile::ReadOnly)) {
+            error = Error::fileIOError(temp_file);
+
+        } else {
+            while (!f_temp.atEnd()) {
+                QByteArray block = f_temp.read(256 * 1024);
+                if (block.isEmpty() || target->write(block) != block.size()) {
+                    error = Error::fileIOError(temp_file);
+                    break;
+                }
+            }
+            f_temp.close();
+        }
+    }
+
+    Utils::removeDir(temp_folder);
+
+    // временный файл уже удален, показывать его нельзя
+    if (Utils::isMainThread())
+        _last_ok_file.clear();
+
+    return error;
+}
+
+Error ReportGenerator::generate(const DataContainer* data, const QMap<PropertyID, QString>& field_names, bool auto_map,
+                                const QByteArray& template_file, QIODevice* target, QLocale::Language language,
+                                const QMap<PropertyID, QLocale::Language>& field_languages)
+{
+    Z_CHECK_NULL(data);
+
+    QMap<DataProperty, QString> f;
+    for (auto it = field_names.constBegin(); it != field_names.constEnd(); ++it) {
+        f[data->property(it.key())] = it.value();
+    }
+
+    QMap<DataProperty, QLocale::Language> f_l;
+    for (auto it = field_languages.constBegin(); it != field_languages.constEnd(); ++it) {
+        f_l[data->property(it.key())] = it.value();
+    }
+
+    return generate(data, f, auto_map, template_file, target, language, f_l);
+}
+
+Error ReportGenerator::generateBatch(const Factory& factory, const QList<const DataContainer*>& data,
+                                     const QMap<DataProperty, QString>& field_names, bool auto_map, const QByteArray& template_file,
+                                     QList<QByteArray>& results, QLocale::Language language,
+                                     const QMap<DataProperty, QLocale::Language>& field_languages, QThreadPool* pool)
+{
+    Z_CHECK(factory != nullptr);
+    results.clear();
+
+    if (data.isEmpty())
+        return Error();
+
+    if (language == QLocale::AnyLanguage)
+        language = Core::language(LocaleType::Workflow);
+    if (pool == nullptr)
+        pool = QThreadPool::globalInstance();
+
+    // у каждого задания свой экземпляр генератора и свой буфер результата
+    QVector<QByteArray> documents(data.count());
+    QVector<Error> errors(data.count());
+    QByteArray* documents_ptr = documents.data();
+    Error* errors_ptr = errors.data();
+
+    auto job = [&](int n) {
+        auto generator = factory();
+        Z_CHECK_NULL(generator);
+
+        QBuffer buffer(&documents_ptr[n]);
+        Z_CHECK(buffer.open(QBuffer::WriteOnly));
+        errors_ptr[n] = generator->generate(data.at(n), field_names, auto_map, template_file, &buffer, language, field_languages);
+    };
+
+    // первый документ формируем сразу: если шаблон содержит ошибки, то запускать остальные нет смысла
+    job(0);
+    if (errors.first().isError())
+        return errors.first();
+
+    QList<QFuture<void>> futures;
+    for (int n = 1; n < data.count(); n++) {
+        futures << QtConcurrent::run(pool, job, n);
+    }
+    for (auto& f : futures) {
+        f.waitForFinished();
+    }
+
+    Error error;
+    for (auto& e : qAsConst(errors)) {
+        if (e.isError())
+            error << e;
+    }
+    if (error.isError())
+        return error;
+
+    results = documents.toList();
+    return Error();
+}
+
+Error ReportGenerator::generateBatch(const Factory& factory, const QList<const DataContainer*>& data,
+                                     const QMap<PropertyID, QString>& field_names, bool auto_map, const QByteArray& template_file,
+                                     QList<QByteArray>& results, QLocale::Language language,
+                                     const QMap<PropertyID, QLocale::Language>& field_languages, QThreadPool* pool)
+{
+    results.clear();
+    if (data.isEmpty())
+        return Error();
+
+    // структура данных у всех источников одинаковая
+    auto structure = data.first();
+    Z_CHECK_NULL(structure);
+
+    QMap<DataProperty, QString> f;
+    for (auto it = field_names.constBegin(); it != field_names.constEnd(); ++it) {
+        f[structure->property(it.key())] = it.value();
+    }
+
+    QMap<DataProperty, QLocale::Language> f_l;
+    for (auto it = field_languages.constBegin(); it != field_languages.constEnd(); ++it) {
+        f_l[structure->property(it.key())] = it.value();
+    }
+
+    return generateBatch(factory, data, f, auto_map, template_file, results, language, f_l, pool);
+}
+
+Error ReportGenerator::generateBatchMerged(const Factory& factory, const QList<const DataContainer*>& data,
+                                           const QMap<DataProperty, QString>& field_names, bool auto_map,
+                                           const QByteArray& template_file, QIODevice* target, QLocale::Language language,
+                                           const QMap<DataProperty, QLocale::Language>& field_languages, QThreadPool* pool)
+{
+    Z_CHECK_NULL(target);
+    Z_CHECK(target->isWritable());
+    Z_CHECK(!data.isEmpty());
+
+    QList<QByteArray> documents;
+    Error error = generateBatch(factory, data, field_names, auto_map, template_file, documents, language, field_languages, pool);
+    if (error.isError())
+        return error;
+
+    if (documents.count() == 1) {
+        if (target->write(documents.first()) != documents.first().size())
+            return Error::fileIOError(target);
+        return Error();
+    }
+
+    auto generator = factory();
+    Z_CHECK_NULL(generator);
+    return generator->mergeDocuments(documents, target);
+}
+
+bool ReportGenerator::isMemoryProcessingSupported() const
+{
+    return false;
+}
+
+Error ReportGenerator::unpackTemplateMemory(const QByteArray& template_file, QStringList& to_parse)
+{
+    Q_UNUSED(template_file)
+    Q_UNUSED(to_parse)
+    Z_HALT_INT;
+    return Error();
+}
+
+Error ReportGenerator::packTargetMemory(QIODevice* target)
+{
+    Q_UNUSED(target)
+    Z_HALT_INT;
+    return Error();
+}
+
+Error ReportGenerator::openDocumentMemory(const QString& part_name, XMLDocumentPtr& document)
+{
+    Q_UNUSED(part_name)
+    Q_UNUSED(document)
+    Z_HALT_INT;
+    return Error();
+}
+
+Error ReportGenerator::saveDocumentMemory(const QString& part_name, const XMLDocumentPtr& document)
+{
+    Q_UNUSED(part_name)
+    Q_UNUSED(document)
+    Z_HALT_INT;
+    return Error();
+}
+
+Error ReportGenerator::mergeDocuments(const QList<QByteArray>& documents, QIODevice* target)
+{
+    Q_UNUSED(documents)
+    Q_UNUSED(target)
+    return Error("ReportGenerator - merging documents not supported");
+}
+
+void ReportGenerator::prepareGeneration(const DataContainer* data, bool auto_map, QLocale::Language language,
+                                        const QMap<DataProperty, QLocale::Language>& field_languages)
+{
+    Z_CHECK_NULL(data);
+
+    _data = data;
+    _language = (language == QLocale::AnyLanguage ? Core::language(LocaleType::Workflow) : language);
+    _auto_map = auto_map;
+    _field_languages = field_languages;
+}
+
+Error ReportGenerator::processDocument(const QMap<DataProperty, QString>& field_names)
+{
+    Z_CHECK_NULL(_document);
+    XMLNodePtr root = _document->getRootElement();
+    if (root == nullptr)
+        return createError("Empty template");
+
+    QHash<QString, DataProperty> property_hash;
+    for (auto i = field_names.constBegin(); i != field_names.constEnd(); ++i) {
+        Z_CHECK(i.key().isValid());
+        Z_CHECK(!i.value().isEmpty());
+        property_hash[i.value().toLower()] = i.key();
+    }
+
+    Error error = prepareTree(root);
+
+    QStack<BlockInfoPtr> begin_blocks;
+    TagInfoPtr current_tag;
+    if (error.isOk())
+        error = parseHelper(root, property_hash, begin_blocks, current_tag);
+
+    if (error.isOk()) {
+        if (current_tag != nullptr)
+            error = createError(QString("Found not closed tag <%1>").arg(current_tag->tag_text));
+
+        if (!begin_blocks.isEmpty()) {
+            // есть не закрытые блоки
+            QStringList not_closed;
+            for (auto& b : begin_blocks) {
+                not_closed << b->first_tag->tag_text;
+            }
+            error << createError(QString("Found blocks without close tag <%1>").arg(not_closed.join(", ")));
+        }
+    }
+
+    if (error.isError())
+        return error;
+
+    // начинаем рекурсивно заполнять блоки от нижнего уровня к верхнему
+    for (auto& b : _blocks) {
+        error = generateHelper(b);
+        if (error.isError())
+            break;
+    }
+
+    return error;
+}
+
+Error ReportGenerator::generateMemory(const QMap<DataProperty, QString>& field_names, const QByteArray& template_file, QIODevice* target)
+{
+    QStringList to_parse;
+    Error error = unpackTemplateMemory(template_file, to_parse);
+
+    for (auto& part_name : qAsConst(to_parse)) {
+        if (error.isOk())
+            error = openDocumentMemory(part_name, _document);
+
+        if (error.isOk())
+            error = processDocument(field_names);
+
+        if (error.isOk())
+            error = saveDocumentMemory(part_name, _document);
+
+        clear();
+    }
+
+    if (error.isOk())
+        error = packTargetMemory(target);
+
+    return error;
+}
+
+void ReportGenerator::setTemplateCacheSize(int size)
+{
+    Z_CHECK(size >= 0);
+    QMutexLocker lock(&_compiled_templates_mutex);
+    _compiled_templates.setMaxCost(size);
+}
+
+void ReportGenerator::clearTemplateCache()
+{
+    QMutexLocker lock(&_compiled_templates_mutex);
+    _compiled_templates.clear();
+}
+
+QString ReportGenerator::compiledTemplateKey(const QByteArray& template_file) const
+{
+    return QString(typeid(*this).name()) + "_" + Utils::generateChecksum(template_file);
+}
+
+ReportGenerator::CompiledTemplatePtr ReportGenerator::compiledTemplate(const QString& key)
+{
+    QMutexLocker lock(&_compiled_templates_mutex);
+    auto compiled = _compiled_templates.object(key);
+    return compiled == nullptr ? nullptr : *compiled;
+}
+
+void ReportGenerator::insertCompiledTemplate(const QString& key, const CompiledTemplatePtr& compiled)
+{
+    Z_CHECK_NULL(compiled);
+
+    int cost = 0;
+    for (auto i = compiled->content.constBegin(); i != compiled->content.constEnd(); ++i) {
+        cost += i.value().size();
+    }
+
+    QMutexLocker lock(&_compiled_templates_mutex);
+    // QCache сам отбрасывает объекты, стоимость которых превышает maxCost
+    _compiled_templates.insert(key, new CompiledTemplatePtr(compiled), qMax(1, cost));
+}
+
 void ReportGenerator::showLastOk()
 {
     Z_CHECK(Utils::isMainThread());
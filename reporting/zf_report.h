@@ -1,5 +1,7 @@
 #pragma once
 
+#include <QCache>
+#include <QIODevice>
 #include <QMutex>
 
 #include "zf.h"
@@ -7,6 +9,10 @@
 #include "zf_error.h"
 #include "zf_xml.h"
 
+#include <functional>
+
+class QThreadPool;
+
 namespace zf
 {
 //! Базовый абстрактный класс для генерации документов по шаблонам XML (DOCX, ODF), XHTML, HTML4, HTML5
@@ -87,10 +93,121 @@ public:
         //! Язык для конкретных полей данных
         const QMap<PropertyID, QLocale::Language>& field_languages = {});
 
+    /*! Создать документ и записать его в устройство. Поля задаются через DataProperty
+     * Если генератор поддерживает обработку в памяти (isMemoryProcessingSupported), то временные файлы не создаются,
+     * иначе документ формируется во временном файле и затем копируется в устройство */
+    Error generate(
+        //! Источник данных
+        const DataContainer* data,
+        //! Соответствие между полями данных и текстовыми метками в шаблоне
+        const QMap<DataProperty, QString>& field_names,
+        /*! Автоматическое определение соответствия между полями данных и текстовыми метками в шаблоне по DataProperty::id
+         * Ищет совпадение между целочисленными текстовыми метками и DataProperty::id. Работает как дополнение к field_names */
+        bool auto_map,
+        //! Шаблон
+        const QByteArray& template_file,
+        //! Результат. Устройство должно быть открыто на запись
+        QIODevice* target,
+        //! Язык по умолчанию для генерации отчета. По умолчанию - Core::languageWorkflow
+        QLocale::Language language = QLocale::AnyLanguage,
+        //! Язык для конкретных полей данных
+        const QMap<DataProperty, QLocale::Language>& field_languages = {});
+    //! Создать документ и записать его в устройство. Поля задаются через коды DataProperty
+    Error generate(
+        //! Источник данных
+        const DataContainer* data,
+        //! Соответствие между полями данных и текстовыми метками в шаблоне. Ключ - id свойства
+        const QMap<PropertyID, QString>& field_names,
+        /*! Автоматическое определение соответствия между полями данных и текстовыми метками в шаблоне по DataProperty::id
+         * Ищет совпадение между текстовыми метками и DataProperty::id. Работает как дополнение к field_names */
+        bool auto_map,
+        //! Шаблон
+        const QByteArray& template_file,
+        //! Результат. Устройство должно быть открыто на запись
+        QIODevice* target,
+        //! Язык по умолчанию для генерации отчета. По умолчанию - Core::languageWorkflow
+        QLocale::Language language = QLocale::AnyLanguage,
+        //! Язык для конкретных полей данных
+        const QMap<PropertyID, QLocale::Language>& field_languages = {});
+
+    //! Создает экземпляр генератора. Для каждого задания пакетной генерации создается свой экземпляр
+    typedef std::function<std::unique_ptr<ReportGenerator>()> Factory;
+
+    /*! Пакетная генерация документов по одному шаблону. Документы формируются параллельно в пуле потоков, каждое
+     * задание использует свой экземпляр генератора. Первый документ формируется в текущем потоке, чтобы проверить шаблон
+     * и поместить его в кэш подготовленных шаблонов, остальные задания используют его совместно.
+     * Значения полей типа QPixmap/QIcon допустимы только при генерации из главного потока */
+    static Error generateBatch(
+        //! Фабрика генераторов
+        const Factory& factory,
+        //! Источники данных. Для каждого формируется отдельный документ
+        const QList<const DataContainer*>& data,
+        //! Соответствие между полями данных и текстовыми метками в шаблоне
+        const QMap<DataProperty, QString>& field_names,
+        //! Автоматическое определение соответствия между полями данных и текстовыми метками в шаблоне по DataProperty::id
+        bool auto_map,
+        //! Шаблон
+        const QByteArray& template_file,
+        //! Результаты в порядке data
+        QList<QByteArray>& results,
+        //! Язык по умолчанию для генерации отчета. По умолчанию - Core::languageWorkflow
+        QLocale::Language language = QLocale::AnyLanguage,
+        //! Язык для конкретных полей данных
+        const QMap<DataProperty, QLocale::Language>& field_languages = {},
+        //! Пул потоков. Если не задан, то QThreadPool::globalInstance
+        QThreadPool* pool = nullptr);
+    //! Пакетная генерация документов по одному шаблону. Поля задаются через коды DataProperty
+    static Error generateBatch(
+        //! Фабрика генераторов
+        const Factory& factory,
+        //! Источники данных. Для каждого формируется отдельный документ
+        const QList<const DataContainer*>& data,
+        //! Соответствие между полями данных и текстовыми метками в шаблоне. Ключ - id свойства
+        const QMap<PropertyID, QString>& field_names,
+        //! Автоматическое определение соответствия между полями данных и текстовыми метками в шаблоне по DataProperty::id
+        bool auto_map,
+        //! Шаблон
+        const QByteArray& template_file,
+        //! Результаты в порядке data
+        QList<QByteArray>& results,
+        //! Язык по умолчанию для генерации отчета. По умолчанию - Core::languageWorkflow
+        QLocale::Language language = QLocale::AnyLanguage,
+        //! Язык для конкретных полей данных
+        const QMap<PropertyID, QLocale::Language>& field_languages = {},
+        //! Пул потоков. Если не задан, то QThreadPool::globalInstance
+        QThreadPool* pool = nullptr);
+    /*! Пакетная генерация документов по одному шаблону с объединением результатов в один документ.
+     * Документы следуют друг за другом, каждый с новой страницы */
+    static Error generateBatchMerged(
+        //! Фабрика генераторов
+        const Factory& factory,
+        //! Источники данных. Для каждого формируется отдельный документ
+        const QList<const DataContainer*>& data,
+        //! Соответствие между полями данных и текстовыми метками в шаблоне
+        const QMap<DataProperty, QString>& field_names,
+        //! Автоматическое определение соответствия между полями данных и текстовыми метками в шаблоне по DataProperty::id
+        bool auto_map,
+        //! Шаблон
+        const QByteArray& template_file,
+        //! Результат. Устройство должно быть открыто на запись
+        QIODevice* target,
+        //! Язык по умолчанию для генерации отчета. По умолчанию - Core::languageWorkflow
+        QLocale::Language language = QLocale::AnyLanguage,
+        //! Язык для конкретных полей данных
+        const QMap<DataProperty, QLocale::Language>& field_languages = {},
+        //! Пул потоков. Если не задан, то QThreadPool::globalInstance
+        QThreadPool* pool = nullptr);
+
     /*! Показать стандартный диалог с информацией об успешном сохранении файла
      * Если была ошибка, то ничего не показывает */
     static void showLastOk();
 
+    /*! Максимальный размер кэша подготовленных шаблонов (байт). Шаблоны вытесняются по давности использования.
+     * 0 - кэш отключен. По умолчанию 32 Мб */
+    static void setTemplateCacheSize(int size);
+    //! Очистить кэш подготовленных шаблонов
+    static void clearTemplateCache();
+
 protected:    
     //! Тип тэга
     enum class TagType
@@ -161,8 +278,42 @@ protected:
     //! Записать документ в файл
     virtual Error saveDocument(const QString& target_file, const XMLDocumentPtr& document) = 0;
 
+    /*! Поддерживается ли обработка шаблона в памяти без распаковки во временную папку. Если да, то вместо
+     * unpackTemplate/openDocument/saveDocument/packTarget используются их аналоги с суффиксом Memory */
+    virtual bool isMemoryProcessingSupported() const;
+    /*! Открыть упакованный шаблон в памяти и вернуть имена частей, которые содержат тэги и требуют разбора.
+     * Остальные части переносятся в результат без изменений */
+    virtual Error unpackTemplateMemory(const QByteArray& template_file, QStringList& to_parse);
+    //! Упаковать результат и записать его в устройство
+    virtual Error packTargetMemory(QIODevice* target);
+    //! Открыть часть шаблона
+    virtual Error openDocumentMemory(const QString& part_name, XMLDocumentPtr& document);
+    //! Записать обработанную часть шаблона
+    virtual Error saveDocumentMemory(const QString& part_name, const XMLDocumentPtr& document);
+
+    /*! Объединить документы, сформированные по одному шаблону, в один. Документы следуют друг за другом, каждый с новой
+     * страницы. По умолчанию не поддерживается */
+    virtual Error mergeDocuments(const QList<QByteArray>& documents, QIODevice* target);
+
     //! Подготовка дерева к разбору
     virtual Error prepareTree(const XMLNodePtr& root);
+
+    //! Подготовленный шаблон. Не изменяется после помещения в кэш
+    struct CompiledTemplate
+    {
+        //! Части шаблона, которые содержат тэги
+        QStringList parts;
+        //! Подготовленное к разбору содержимое частей. Ключ - имя части
+        QMap<QString, QByteArray> content;
+    };
+    typedef std::shared_ptr<const CompiledTemplate> CompiledTemplatePtr;
+
+    //! Ключ кэша подготовленных шаблонов. Учитывает вид генератора и контрольную сумму шаблона
+    QString compiledTemplateKey(const QByteArray& template_file) const;
+    //! Найти подготовленный шаблон в кэше. Если не найден, то nullptr
+    static CompiledTemplatePtr compiledTemplate(const QString& key);
+    //! Поместить подготовленный шаблон в кэш
+    static void insertCompiledTemplate(const QString& key, const CompiledTemplatePtr& compiled);
     //! Извлечь текст из элемента и определить его тип. Для ячеек можно возвращать тип Field, т.к. он автоматически
     //! преобразуется в Column. Необходимо возвращать только тот текст, который может подходить под тэг, для остальных
     //! TagType = Invalid
@@ -262,6 +413,14 @@ private:
     };
     typedef std::shared_ptr<BlockInfo> BlockInfoPtr;
 
+    //! Инициализация параметров генерации
+    void prepareGeneration(const DataContainer* data, bool auto_map, QLocale::Language language,
+                           const QMap<DataProperty, QLocale::Language>& field_languages);
+    //! Разбор открытого документа и заполнение его данными
+    Error processDocument(const QMap<DataProperty, QString>& field_names);
+    //! Генерация в памяти без временных файлов
+    Error generateMemory(const QMap<DataProperty, QString>& field_names, const QByteArray& template_file, QIODevice* target);
+
     //! Рекурсивный парсинг исходного документа
     Error parseHelper(        
         //! Родительский узел для парсинга
@@ -318,6 +477,10 @@ private:
 
     //! Имя последнего успешно созданного файла
     static QString _last_ok_file;
+
+    //! Кэш подготовленных шаблонов. Стоимость - размер содержимого в байтах
+    static QCache<QString, CompiledTemplatePtr> _compiled_templates;
+    static QMutex _compiled_templates_mutex;
 };
 
 } // namespace zf
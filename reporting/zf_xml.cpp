@@ -273,6 +273,30 @@ int XMLDocument::saveToFile(const QString& filename, const XML_SaveOptions& opti
     return result;
 }
 
+int XMLDocument::saveToMemory(QByteArray& data, const XML_SaveOptions& options, const QString& encoding) const
+{
+    data.clear();
+
+    xmlBufferPtr buffer = xmlBufferCreate();
+    if (buffer == nullptr)
+        return -1;
+
+    xmlSaveCtxtPtr context = xmlSaveToBuffer(buffer, encoding.toLocal8Bit(), options);
+    int result;
+    if (context == nullptr) {
+        result = -1;
+
+    } else {
+        xmlSaveDoc(context, _doc);
+        result = xmlSaveClose(context);
+        if (result >= 0)
+            data = QByteArray(reinterpret_cast<const char*>(xmlBufferContent(buffer)), xmlBufferLength(buffer));
+    }
+
+    xmlBufferFree(buffer);
+    return result;
+}
+
 XMLDocument::XMLDocument(_xmlDoc* doc)
     : _doc(doc)
 {
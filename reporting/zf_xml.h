@@ -90,6 +90,8 @@ public:
 
     //! Записать в файл XML
     int saveToFile(const QString& filename, const XML_SaveOptions& options, const QString& encoding = "UTF-8") const;
+    //! Записать XML в память
+    int saveToMemory(QByteArray& data, const XML_SaveOptions& options, const QString& encoding = "UTF-8") const;
 
     //! Не использовать
     XMLDocument(_xmlDoc* doc);
@@ -290,7 +290,7 @@ void HttpHeader::removeAllValues(HeaderType key)
 QByteArray HttpHeader::toByteArray(bool header_only) const
 {
     Q_D(const HttpHeader);
-    if (!isValid() || !isContentCompleted())
+    if (!isValid() || (!header_only && !isContentCompleted()))
         return QByteArray("");
 
     QByteArray ret = QByteArray("");
@@ -300,11 +300,11 @@ QByteArray HttpHeader::toByteArray(bool header_only) const
         ret += (*it).first + QLatin1String(": ") + (*it).second + QLatin1String("\r\n");
         ++it;
     }
+    // после тела ничего не добавляем, иначе при keep-alive лишние байты попадут в начало следующего сообщения
+    ret += QStringLiteral("\r\n");
 
-    if (!header_only && hasContentLength() && hasContentType()) {
-        ret += QStringLiteral("\r\n");
+    if (!header_only && hasContentLength() && hasContentType())
         ret += d->content;
-    }
 
     return ret;
 }
@@ -552,7 +552,7 @@ QByteArray HttpResponseHeader::toByteArray(bool header_only) const
     ret += " " + QString::number(static_cast<int>(d->statCode)) + " ";
     ret += d->reasonPhr.toUtf8();
 
-    ret += "\r\n" + HttpHeader::toByteArray(header_only) + "\r\n";
+    ret += "\r\n" + HttpHeader::toByteArray(header_only);
 
     return ret;
 }
@@ -695,6 +695,45 @@ void HttpRequestHeader::setProtocolVersion(const Version& version)
     setValue(HeaderType::Accept, accept);
 }
 
+ContentEncoding HttpRequestHeader::preferredEncoding() const
+{
+    // Accept-Encoding: gzip;q=1.0, deflate;q=0.5, *;q=0
+    ContentEncoding encoding = ContentEncoding::Identity;
+    double best_q = 0;
+
+    const QStringList values = allValues(HeaderType::AcceptEncoding);
+    for (auto& v : values) {
+        for (auto& item : v.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+            auto params = item.split(QLatin1Char(';'), QString::SkipEmptyParts);
+            if (params.isEmpty())
+                continue;
+
+            QString name = params.first().trimmed().toLower();
+            double q = 1;
+            for (int i = 1; i < params.count(); i++) {
+                QString p = params.at(i).trimmed();
+                if (p.startsWith(QStringLiteral("q="), Qt::CaseInsensitive))
+                    q = p.mid(2).toDouble();
+            }
+
+            ContentEncoding e;
+            if (name == QStringLiteral("gzip") || name == QStringLiteral("x-gzip") || name == QStringLiteral("*"))
+                e = ContentEncoding::Gzip;
+            else if (name == QStringLiteral("deflate"))
+                e = ContentEncoding::Deflate;
+            else
+                continue;
+
+            if (q > best_q || (q == best_q && q > 0 && e == ContentEncoding::Gzip)) {
+                best_q = q;
+                encoding = e;
+            }
+        }
+    }
+
+    return encoding;
+}
+
 Version HttpRequestHeader::protocolVersion() const
 {
     QString v = value(HeaderType::Accept).simplified();
@@ -805,7 +844,7 @@ QByteArray HttpRequestHeader::toByteArray(bool header_only) const
     ret += " HTTP/";
     ret += QString::number(d->majVer) + ".";
     ret += QString::number(d->minVer) + "\r\n";
-    ret += HttpHeader::toByteArray(header_only) + "\r\n";
+    ret += HttpHeader::toByteArray(header_only);
 
     return ret;
 }
@@ -1034,4 +1073,88 @@ ContentType HttpHeader::contentTypeFromString(const QString& method)
     return _contentTypeNameMap.key(method.toLower(), ContentType::Unknown);
 }
 
+QString HttpHeader::contentEncodingToString(ContentEncoding encoding)
+{
+    switch (encoding) {
+        case ContentEncoding::Identity:
+            return QStringLiteral("identity");
+        case ContentEncoding::Gzip:
+            return QStringLiteral("gzip");
+        case ContentEncoding::Deflate:
+            return QStringLiteral("deflate");
+    }
+    Z_HALT_INT;
+    return QString();
+}
+
+bool HttpHeader::isCompressible(ContentType content)
+{
+    switch (content) {
+        case ContentType::ApplicationAtomXml:
+        case ContentType::ApplicationFormUrlencoded:
+        case ContentType::ApplicationJson:
+        case ContentType::ApplicationSvgXml:
+        case ContentType::ApplicationXhtmlXml:
+        case ContentType::ApplicationXml:
+        case ContentType::TextHtml:
+        case ContentType::TextPlain:
+        case ContentType::TextXml:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//! CRC-32 (IEEE 802.3) для трейлера gzip
+static quint32 _crc32(const QByteArray& data)
+{
+    static const QVector<quint32> table = []() {
+        QVector<quint32> t(256);
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[static_cast<int>(i)] = c;
+        }
+        return t;
+    }();
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (char ch : data) {
+        crc = table.at(static_cast<int>((crc ^ static_cast<quint8>(ch)) & 0xFF)) ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+//! Добавить число в формате little-endian
+static void _appendLE32(QByteArray& target, quint32 value)
+{
+    for (int i = 0; i < 4; i++) {
+        target.append(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+QByteArray HttpHeader::encodeContent(const QByteArray& data, ContentEncoding encoding)
+{
+    Z_CHECK(encoding != ContentEncoding::Identity);
+
+    // qCompress: 4 байта размера исходных данных, затем поток zlib (2 байта заголовка, deflate, 4 байта adler32)
+    QByteArray compressed = qCompress(data);
+    if (compressed.size() < 4 + 2 + 4)
+        return QByteArray();
+
+    if (encoding == ContentEncoding::Deflate)
+        return compressed.mid(4); // HTTP deflate - это поток zlib
+
+    // gzip: заголовок (без имени файла и времени), поток deflate без обертки zlib, CRC-32 и размер исходных данных
+    QByteArray result;
+    result.reserve(compressed.size() + 8);
+    result.append("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10);
+    result.append(compressed.constData() + 4 + 2, compressed.size() - 4 - 2 - 4);
+    _appendLE32(result, _crc32(data));
+    _appendLE32(result, static_cast<quint32>(data.size()));
+    return result;
+}
+
 } // namespace zf::http
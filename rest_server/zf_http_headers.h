@@ -223,6 +223,16 @@ enum class ContentType
     MicrosoftExcel_OpenXML,
 };
 
+//! Кодирование тела ответа (Content-Encoding)
+enum class ContentEncoding
+{
+    //! Без сжатия
+    Identity,
+    Gzip,
+    //! zlib (RFC 1950), как того требует HTTP для deflate
+    Deflate,
+};
+
 class HttpParser;
 class HttpPrivate;
 class HttpHeaderPrivate;
@@ -295,6 +305,8 @@ public:
     qint64 realContentLength() const;
     bool isContentCompleted() const;
 
+    /*! Заголовки, завершенные пустой строкой, и тело. При header_only тело не требуется: Content-Length может
+     * описывать данные, которые отправляются отдельно */
     virtual QByteArray toByteArray(bool header_only = false) const;
 
     bool isValid() const;
@@ -313,6 +325,12 @@ public:
     static QString contentTypeToString(ContentType content);
     static ContentType contentTypeFromString(const QString& method);
 
+    static QString contentEncodingToString(ContentEncoding encoding);
+    //! Имеет ли смысл сжимать данные такого типа (текстовые форматы). Архивы и изображения уже сжаты
+    static bool isCompressible(ContentType content);
+    //! Сжать данные. При ошибке возвращает пустой массив
+    static QByteArray encodeContent(const QByteArray& data, ContentEncoding encoding);
+
 protected:
     HttpHeader();
     HttpHeader(const HttpHeader& header);
@@ -397,6 +415,9 @@ public:
     //! Ищет заголовок Accept и извлекает из него значение параметра version. Параметры должны быть разделены ';'
     Version protocolVersion() const;
 
+    //! Предпочтительное для клиента сжатие ответа по заголовку Accept-Encoding. Из равноценных выбирается gzip
+    ContentEncoding preferredEncoding() const;
+
     //! Установить заголовок Authorization: basic login password или basic hash
     void setBasicAuthorization(const QString& login, const QString& password);
     void setBasicAuthorization(const QString& hash);
@@ -125,11 +125,23 @@ QString HttpParser::parse(QAbstractSocket* socket)
 QString HttpParser::parse(const QByteArray& data, bool is_ssl)
 {
     if (data.size()) {
+        if (isCompleted()) {
+            // сообщение уже разобрано, все остальное относится к следующему
+            _unparsed.append(data);
+            return QString();
+        }
+
         _url.setScheme(is_ssl ? QStringLiteral("https") : QStringLiteral("http"));
 
         const auto parsed
             = http_parser_execute(_http_parser.get(), &HttpParcerInternal::httpParserSettings, data.constData(), size_t(data.size()));
         if (int(parsed) < data.size()) {
+            if (HTTP_PARSER_ERRNO(_http_parser.get()) == HPE_PAUSED && isCompleted()) {
+                // парсер остановлен в onMessageComplete: дальше идет следующий запрос
+                _unparsed.append(data.constData() + parsed, data.size() - int(parsed));
+                return QString();
+            }
+
             QString error = http_errno_name(static_cast<http_errno>(_http_parser->http_errno));
             return error.isEmpty() ? QString::number(_http_parser->http_errno) : error;
         }
@@ -142,6 +154,18 @@ bool HttpParser::isCompleted() const
     return _state == State::OnMessageComplete;
 }
 
+const QByteArray& HttpParser::unparsed() const
+{
+    return _unparsed;
+}
+
+QByteArray HttpParser::takeUnparsed()
+{
+    QByteArray res = _unparsed;
+    _unparsed.clear();
+    return res;
+}
+
 const QByteArray& HttpParser::body() const
 {
     return _body;
@@ -257,6 +281,8 @@ int HttpParser::onMessageComplete(http_parser* httpParser)
 {
     qCDebug(lc) << httpParser;
     instance(httpParser)->_state = State::OnMessageComplete;
+    // останавливаемся на границе сообщения, чтобы следующий запрос не затер текущий
+    http_parser_pause(httpParser, 1);
     return 0;
 }
 
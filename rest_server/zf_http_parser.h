@@ -40,6 +40,12 @@ public:
     //! Сообщение загружено полностью
     bool isCompleted() const;
 
+    /*! Данные, поступившие после окончания сообщения (следующие запросы при конвейерной обработке HTTP/1.1).
+     * Парсер останавливается на границе сообщения, остаток не теряется при clear и передается в следующий парсинг */
+    const QByteArray& unparsed() const;
+    //! Забрать данные, поступившие после окончания сообщения
+    QByteArray takeUnparsed();
+
     const QByteArray& body() const;
     QUrl url() const;
 
@@ -89,6 +95,8 @@ private:
 
     QByteArray _body;
     QUrl _url;
+    //! Данные, поступившие после окончания сообщения
+    QByteArray _unparsed;
 
     QList<QPair<QString, QString>> _headers;
     QMap<QString, QString> _headers_lower;
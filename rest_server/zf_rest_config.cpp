@@ -153,6 +153,66 @@ void RestConfiguration::setFlushTimeout(quint32 flush_timeout)
     _flush_timeout = flush_timeout;
 }
 
+quint16 RestConfiguration::keepAliveTimeout() const
+{
+    return _keep_alive_timeout;
+}
+
+void RestConfiguration::setKeepAliveTimeout(quint16 keep_alive_timeout)
+{
+    _keep_alive_timeout = keep_alive_timeout;
+}
+
+quint16 RestConfiguration::maxKeepAliveRequests() const
+{
+    return _max_keep_alive_requests;
+}
+
+void RestConfiguration::setMaxKeepAliveRequests(quint16 max_keep_alive_requests)
+{
+    _max_keep_alive_requests = max_keep_alive_requests;
+}
+
+quint16 RestConfiguration::maxResultWaitTimeout() const
+{
+    return _max_result_wait_timeout;
+}
+
+void RestConfiguration::setMaxResultWaitTimeout(quint16 max_result_wait_timeout)
+{
+    _max_result_wait_timeout = max_result_wait_timeout;
+}
+
+quint32 RestConfiguration::compressionThreshold() const
+{
+    return _compression_threshold;
+}
+
+void RestConfiguration::setCompressionThreshold(quint32 compression_threshold)
+{
+    _compression_threshold = compression_threshold;
+}
+
+quint32 RestConfiguration::compressionMaxSize() const
+{
+    return _compression_max_size;
+}
+
+void RestConfiguration::setCompressionMaxSize(quint32 compression_max_size)
+{
+    _compression_max_size = compression_max_size;
+}
+
+const QString& RestConfiguration::metricsPath() const
+{
+    return _metrics_path;
+}
+
+void RestConfiguration::setMetricsPath(const QString& metrics_path)
+{
+    _metrics_path = metrics_path;
+}
+
 const QList<Version>& RestConfiguration::acceptedVersions() const
 {
     return _accepted_versions;
@@ -71,6 +71,32 @@ public:
     quint16 flushTimeout() const;
     void setFlushTimeout(quint32 flush_timeout);
 
+    //! Время ожидания следующего запроса в постоянном (keep-alive) соединении (с). Если 0, то соединение закрывается после
+    //! каждого ответа
+    quint16 keepAliveTimeout() const;
+    void setKeepAliveTimeout(quint16 keep_alive_timeout);
+
+    //! Максимальное количество запросов в одном постоянном соединении. Если 0, то без ограничений
+    quint16 maxKeepAliveRequests() const;
+    void setMaxKeepAliveRequests(quint16 max_keep_alive_requests);
+
+    //! Максимальное время ожидания готовности результата по запросу клиента с заголовком Prefer: wait=N (с)
+    //! Если 0, то long-poll отключен и при неготовом результате сразу отвечаем 204 (No Content)
+    quint16 maxResultWaitTimeout() const;
+    void setMaxResultWaitTimeout(quint16 max_result_wait_timeout);
+
+    //! Минимальный размер результата для сжатия ответа по Accept-Encoding (байт). Если 0, то сжатие отключено
+    quint32 compressionThreshold() const;
+    void setCompressionThreshold(quint32 compression_threshold);
+
+    //! Максимальный размер результата для сжатия (МБ). Более крупные результаты отдаются из файла без сжатия
+    quint32 compressionMaxSize() const;
+    void setCompressionMaxSize(quint32 compression_max_size);
+
+    //! Путь, по которому GET запрос возвращает статистику сервера (RestServer::metricsReport). Если пусто, то отключено
+    const QString& metricsPath() const;
+    void setMetricsPath(const QString& metrics_path);
+
     //! Список допустимых версий протокола
     const QList<Version>& acceptedVersions() const;
     void setAcceptedVersions(const QList<Version>& accepted_versions);
@@ -112,6 +138,18 @@ private:
     quint16 _collect_garbage_period = 30;
     //! Время бездействия для периодического сброса кэша на диск (с)
     quint16 _flush_timeout = 20;
+    //! Время ожидания следующего запроса в постоянном (keep-alive) соединении (с)
+    quint16 _keep_alive_timeout = 15;
+    //! Максимальное количество запросов в одном постоянном соединении
+    quint16 _max_keep_alive_requests = 1000;
+    //! Максимальное время ожидания готовности результата (с)
+    quint16 _max_result_wait_timeout = 60;
+    //! Минимальный размер результата для сжатия ответа (байт)
+    quint32 _compression_threshold = 1024;
+    //! Максимальный размер результата для сжатия (МБ)
+    quint32 _compression_max_size = 64;
+    //! Путь запроса статистики сервера
+    QString _metrics_path;
     //! Список допустимых версий протокола
     QList<Version> _accepted_versions;
     //! Список допустимых версий протокола одной строкой через запятую
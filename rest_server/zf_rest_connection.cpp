@@ -1,10 +1,13 @@
 #include "zf_rest_connection.h"
 #include "zf_socket_operations.h"
 #include "zf_rest_server.h"
+#include "zf_rest_scheduler.h"
 #include "zf_utils.h"
 #include "zf_core.h"
 
 #include <QSslSocket>
+#include <QThread>
+#include <QRegularExpression>
 
 namespace zf::http
 {
@@ -23,7 +26,8 @@ RestConnection::~RestConnection()
 
 void RestConnection::setInitialStatus(RestConnection::InitialStatus s)
 {
-    Z_CHECK(Utils::isMainThread());
+    // соединение создается в потоке обработчика соединений
+    Z_CHECK(QThread::currentThread() == thread());
     _initial_status = s;
 }
 
@@ -41,10 +45,17 @@ void RestConnection::cancell()
 {
     _cancelled = true;
 
+    // если соединение ожидало следующий запрос или результат, то никаких операций с сокетом нет и закрывать его больше некому
+    bool waiting = (_idle_timer != nullptr && _idle_timer->isActive()) || _result_waiting;
+    stopWaiting();
+
     if (_socket != nullptr)
         _socket->abort();
 
-    _rest_server->taskCountDecreased();
+    releaseTaskCounter();
+
+    if (waiting)
+        onConnectionClosed();
 }
 
 void RestConnection::sl_sslErrors(const QList<QSslError>& errors)
@@ -64,8 +75,15 @@ void RestConnection::sl_sslErrors(const QList<QSslError>& errors)
     emit sg_socketError(_session_id, _client_info, zf::Error(err.join("/r/n")));
 }
 
+void RestConnection::setAcceptTime(qint64 t)
+{
+    _accept_time = t;
+}
+
 void RestConnection::start()
 {
+    _rest_server->metrics()->addSince(RestMetrics::Phase::Accept, _accept_time);
+
     QSslSocket* ssl_socket = nullptr;
 
     if (_rest_server->sslConfiguration() == nullptr) {
@@ -76,7 +94,7 @@ void RestConnection::start()
     }
 
     if (!_socket->setSocketDescriptor(_socket_descriptor)) {
-        _rest_server->taskCountDecreased();
+        releaseTaskCounter();
         _socket->abort();
         emit sg_socketCreationError(Error(_socket->errorString()));
         onConnectionClosed();
@@ -102,36 +120,48 @@ void RestConnection::start()
 
     if (_initial_status != InitialStatus::OK) {
         // сокет изначально был передан со статусом ошибки, чтобы отправить ответ клиенту
-        QString error_text;
-        if (_initial_status == InitialStatus::SessionsLimitError) {
-            emit sg_tooManySessions(_client_info);
-            error_text = "too many sessions";
-
-        } else if (_initial_status == InitialStatus::TasksLimitError) {
-            emit sg_tooManyTasks(_client_info);
-            error_text = "too many tasks";
-
-        } else
-            Z_HALT_INT;
-
-        // счетчик задач всегда увеличивается при создании нового соединения, поэтому уменьшаем, т.к. тут новая задача
-        // не создается
-        _rest_server->taskCountDecreased();
-
-        HttpResponseHeader response(StatusCode::TooManyRequests);
-        response.setContent(error_text);
-        SocketWriter* writer = new SocketWriter(response, _client_info, _socket, _rest_server->config()->writeBufferSize(),
-                                                _rest_server->config()->disconnectTimeout(), true, true);
-        connect(writer, &SocketWriter::sg_done, this, [this]() { onConnectionClosed(); });
-        connect(writer, &SocketWriter::sg_error, this, [this]() { onConnectionClosed(); });
-        writer->start();
+        onLimitsExceeded(_initial_status);
         return;
     }
 
+    readRequest();
+}
+
+void RestConnection::readRequest()
+{
+    if (_cancelled)
+        return;
+
+    if (_request_count > 0) {
+        // каждый следующий запрос в постоянном соединении учитывается так же, как новое соединение в
+        // RestTcpServer::incomingConnection
+        InitialStatus status = checkLimits();
+        if (!_task_counted) {
+            _rest_server->taskCountIncreased();
+            _task_counted = true;
+        }
+
+        if (status != InitialStatus::OK) {
+            onLimitsExceeded(status);
+            return;
+        }
+    }
+
+    _request_count++;
+    _keep_alive = false;
+
     // читаем входящий запрос
     SocketHttpReader* request_reader = new SocketHttpReader(_client_info, _socket, _rest_server->config()->readBufferSize(),
                                                             _rest_server->config()->disconnectTimeout(), false, true);
-    connect(request_reader, &SocketHttpReader::sg_request, this, [this](const HttpRequestHeader& request) {
+    request_reader->setUnparsedData(_unparsed);
+    _unparsed.clear();
+
+    _phase_started = RestMetrics::timestamp();
+    connect(request_reader, &SocketHttpReader::sg_request, this, [this, request_reader](const HttpRequestHeader& request) {
+        _rest_server->metrics()->addSince(RestMetrics::Phase::Parse, _phase_started);
+        // запросы, присланные клиентом не дожидаясь ответа на текущий
+        _unparsed = request_reader->unparsedData();
+        _keep_alive = isKeepAliveRequested(request);
         // проверяем права доступа
         checkAccessRights(request);
     });
@@ -146,18 +176,344 @@ void RestConnection::start()
     request_reader->start();
 }
 
+void RestConnection::waitNextRequest()
+{
+    if (!_unparsed.isEmpty() || _socket->bytesAvailable() > 0) {
+        // клиент уже прислал следующий запрос
+        readRequest();
+        return;
+    }
+
+    if (_idle_timer == nullptr) {
+        _idle_timer = new QTimer(this);
+        _idle_timer->setSingleShot(true);
+        connect(_idle_timer, &QTimer::timeout, this, [this]() { closeConnection(); });
+    }
+
+    _idle_connections << connect(_socket, &QAbstractSocket::readyRead, this, [this]() {
+        stopWaiting();
+        readRequest();
+    });
+    _idle_connections << connect(_socket, &QAbstractSocket::disconnected, this, [this]() {
+        // клиент сам закрыл соединение
+        stopWaiting();
+        onConnectionClosed();
+    });
+
+    _idle_timer->start(static_cast<int>(_rest_server->config()->keepAliveTimeout()) * 1000);
+}
+
+void RestConnection::stopWaiting()
+{
+    if (_idle_timer != nullptr)
+        _idle_timer->stop();
+
+    if (_result_waiting) {
+        _result_waiting = false;
+        if (_result_wait_timer != nullptr)
+            _result_wait_timer->stop();
+        _rest_server->cancelWaitSessionResult(_session_id, this);
+    }
+
+    for (auto& c : qAsConst(_idle_connections)) {
+        disconnect(c);
+    }
+    _idle_connections.clear();
+}
+
+void RestConnection::waitResult(int timeout_sec)
+{
+    Z_CHECK(!_result_waiting);
+    Z_CHECK(timeout_sec > 0);
+
+    _result_waiting = true;
+    if (!_rest_server->waitSessionResult(_session_id, this, [this]() { onResultWaitFinished(); })) {
+        // результат был установлен (или сессия удалена) между проверками
+        onResultWaitFinished();
+        return;
+    }
+
+    if (_result_wait_timer == nullptr) {
+        _result_wait_timer = new QTimer(this);
+        _result_wait_timer->setSingleShot(true);
+        connect(_result_wait_timer, &QTimer::timeout, this, [this]() { onResultWaitFinished(); });
+    }
+
+    _idle_connections << connect(_socket, &QAbstractSocket::disconnected, this, [this]() {
+        // клиент не дождался результата
+        stopWaiting();
+        onConnectionClosed();
+    });
+
+    _result_wait_timer->start(timeout_sec * 1000);
+}
+
+void RestConnection::onResultWaitFinished()
+{
+    if (!_result_waiting)
+        return;
+
+    stopWaiting();
+
+    if (_cancelled)
+        return;
+
+    // если результат так и не готов, то клиент получит 204 (No Content) как при обычном опросе
+    auto result = _rest_server->sessionResult(_session_id, _range_header.isEmpty());
+    if (result == nullptr)
+        onSessionNotFound();
+    else
+        onResult(result);
+}
+
+int RestConnection::resultWaitTimeout(const HttpRequestHeader& request) const
+{
+    int max_timeout = _rest_server->config()->maxResultWaitTimeout();
+    if (max_timeout == 0)
+        return 0;
+
+    // Prefer: respond-async, wait=10 (RFC 7240)
+    const QStringList prefer = request.allValues(QStringLiteral("Prefer"));
+    for (auto& value : prefer) {
+        for (auto& token : value.split(QRegularExpression(QStringLiteral("[,;]")), QString::SkipEmptyParts)) {
+            QString t = token.trimmed();
+            if (!t.startsWith(QStringLiteral("wait="), Qt::CaseInsensitive))
+                continue;
+
+            bool ok;
+            int wait = t.mid(5).toInt(&ok);
+            if (ok && wait > 0)
+                return qMin(wait, max_timeout);
+        }
+    }
+
+    return 0;
+}
+
+void RestConnection::onResponseSent()
+{
+    if (!_keep_alive || _cancelled || _socket == nullptr || _socket->state() != QAbstractSocket::ConnectedState) {
+        closeConnection();
+        return;
+    }
+
+    // обмен по текущему запросу завершен, соединение остается открытым
+    emit sg_connectionClosed(_session_id);
+    _session_id.clear();
+
+    waitNextRequest();
+}
+
+void RestConnection::closeConnection()
+{
+    stopWaiting();
+
+    if (_closing)
+        return;
+
+    if (_socket != nullptr && _socket->state() != QAbstractSocket::UnconnectedState) {
+        _socket->disconnectFromHost();
+        if (_socket->state() != QAbstractSocket::UnconnectedState) {
+            // не блокируем поток обработчика: его разделяют другие соединения
+            _closing = true;
+            connect(_socket, &QAbstractSocket::disconnected, this, [this]() { onGracefulCloseFinished(); });
+            QTimer::singleShot(static_cast<int>(_rest_server->config()->disconnectTimeout()), this, [this]() {
+                // клиент не закрыл соединение за отведенное время
+                if (_socket != nullptr && _socket->state() != QAbstractSocket::UnconnectedState)
+                    _socket->abort();
+                onGracefulCloseFinished();
+            });
+            return;
+        }
+    }
+
+    onConnectionClosed();
+}
+
+void RestConnection::onGracefulCloseFinished()
+{
+    if (_closed)
+        return;
+
+    _closed = true;
+    onConnectionClosed();
+}
+
+SocketWriter* RestConnection::createResponseWriter(HttpResponseHeader& response, QIODevice* body, qint64 body_offset, qint64 body_size)
+{
+    auto config = _rest_server->config();
+
+    if (_keep_alive)
+        _keep_alive = !_cancelled && config->keepAliveTimeout() > 0
+                      && (config->maxKeepAliveRequests() == 0 || _request_count < config->maxKeepAliveRequests());
+
+    if (_keep_alive) {
+        QString keep_alive = QStringLiteral("timeout=%1").arg(config->keepAliveTimeout());
+        if (config->maxKeepAliveRequests() > 0)
+            keep_alive += QStringLiteral(", max=%1").arg(config->maxKeepAliveRequests() - _request_count);
+
+        response.setValue(HeaderType::Connection, QStringLiteral("keep-alive"));
+        response.setValue(QStringLiteral("Keep-Alive"), keep_alive);
+
+    } else {
+        response.setValue(HeaderType::Connection, QStringLiteral("close"));
+    }
+
+    if (body != nullptr)
+        return new SocketWriter(response, body, body_offset, body_size, _client_info, _socket, config->writeBufferSize(),
+                                config->disconnectTimeout(), !_keep_alive, true);
+
+    return new SocketWriter(response, _client_info, _socket, config->writeBufferSize(), config->disconnectTimeout(), !_keep_alive, true);
+}
+
+bool RestConnection::isCompressionAllowed(const SessionResultPtr& result) const
+{
+    return _accept_encoding != ContentEncoding::Identity && isCompressionNegotiable(result);
+}
+
+bool RestConnection::isCompressionNegotiable(const SessionResultPtr& result) const
+{
+    auto config = _rest_server->config();
+    if (config->compressionThreshold() == 0)
+        return false;
+
+    qint64 size = result->dataSize();
+    return HttpHeader::isCompressible(result->contentType()) && size >= config->compressionThreshold()
+           && size <= static_cast<qint64>(config->compressionMaxSize()) * 1024 * 1024;
+}
+
+RestConnection::RangeStatus RestConnection::parseRange(const QString& range, qint64 total, qint64& from, qint64& to)
+{
+    from = 0;
+    to = total - 1;
+
+    // неизвестные единицы измерения игнорируются
+    QString r = range.trimmed();
+    if (!r.startsWith(QStringLiteral("bytes="), Qt::CaseInsensitive))
+        return RangeStatus::Full;
+
+    // несколько диапазонов (multipart/byteranges) не поддерживаем - отдаем целиком, это допускается стандартом
+    r = r.mid(6).trimmed();
+    if (r.contains(QLatin1Char(',')))
+        return RangeStatus::Full;
+
+    int pos = r.indexOf(QLatin1Char('-'));
+    if (pos < 0)
+        return RangeStatus::Full;
+
+    QString first = r.left(pos).trimmed();
+    QString last = r.mid(pos + 1).trimmed();
+    bool first_ok;
+    bool last_ok;
+    qint64 first_pos = first.toLongLong(&first_ok);
+    qint64 last_pos = last.toLongLong(&last_ok);
+
+    if (first.isEmpty()) {
+        // последние N байт
+        if (!last_ok || last_pos < 0)
+            return RangeStatus::Full;
+        if (last_pos == 0 || total == 0)
+            return RangeStatus::NotSatisfiable;
+
+        from = qMax<qint64>(0, total - last_pos);
+        return RangeStatus::Partial;
+    }
+
+    if (!first_ok || first_pos < 0 || (!last.isEmpty() && (!last_ok || last_pos < first_pos)))
+        return RangeStatus::Full;
+
+    if (first_pos >= total)
+        return RangeStatus::NotSatisfiable;
+
+    from = first_pos;
+    if (!last.isEmpty())
+        to = qMin(last_pos, total - 1);
+
+    return RangeStatus::Partial;
+}
+
+bool RestConnection::isKeepAliveRequested(const HttpRequestHeader& request)
+{
+    QString connection = request.value(HeaderType::Connection).toLower();
+
+    // HTTP/1.1 по умолчанию держит соединение, HTTP/1.0 - только по явному запросу
+    if (request.majorVersion() > 1 || (request.majorVersion() == 1 && request.minorVersion() >= 1))
+        return !connection.contains(QStringLiteral("close"));
+
+    return connection.contains(QStringLiteral("keep-alive"));
+}
+
+RestConnection::InitialStatus RestConnection::checkLimits() const
+{
+    if (_rest_server->taskCount() >= _rest_server->config()->maxTaskCount())
+        return InitialStatus::TasksLimitError;
+
+    if (_rest_server->sessionCount() >= _rest_server->config()->maxSessionsCount())
+        return InitialStatus::SessionsLimitError;
+
+    return InitialStatus::OK;
+}
+
+void RestConnection::onLimitsExceeded(InitialStatus status)
+{
+    QString error_text;
+    if (status == InitialStatus::SessionsLimitError) {
+        emit sg_tooManySessions(_client_info);
+        error_text = "too many sessions";
+
+    } else if (status == InitialStatus::TasksLimitError) {
+        emit sg_tooManyTasks(_client_info);
+        error_text = "too many tasks";
+
+    } else
+        Z_HALT_INT;
+
+    // счетчик задач всегда увеличивается при создании нового соединения, поэтому уменьшаем, т.к. тут новая задача
+    // не создается
+    releaseTaskCounter();
+
+    // клиент перегружает сервер - соединение не сохраняем
+    _keep_alive = false;
+
+    HttpResponseHeader response(StatusCode::TooManyRequests);
+    response.setContent(error_text);
+    SocketWriter* writer = createResponseWriter(response);
+    connect(writer, &SocketWriter::sg_done, this, [this]() { onConnectionClosed(); });
+    connect(writer, &SocketWriter::sg_error, this, [this]() { onConnectionClosed(); });
+    writer->start();
+}
+
+void RestConnection::releaseTaskCounter()
+{
+    if (!_task_counted)
+        return;
+
+    _task_counted = false;
+    _rest_server->taskCountDecreased();
+}
+
 void RestConnection::checkAccessRights(const HttpRequestHeader& request)
 {
+    // ответ на предыдущий запрос в этом соединении уже получен
+    if (_access_rights_connection)
+        disconnect(_access_rights_connection);
+
     // асинхронно запрашиваем права доступа
-    connect(
+    _access_rights_connection = connect(
         _rest_server, &RestServer::sg_requestAccessRightsFeedback, this,
         [this, request](MessageID message_id, bool accepted, zf::Error error) {
             if (message_id != _access_rights_feedback_id)
                 return;
 
+            disconnect(_access_rights_connection);
+            _rest_server->metrics()->addSince(RestMetrics::Phase::AccessRights, _phase_started);
+
             if (accepted) {
                 Z_CHECK(error.isOk());
-                if (request.method() == Method::Post) {
+                if (isMetricsRequest(request)) {
+                    processMetricsRequest();
+
+                } else if (request.method() == Method::Post) {
                     processInitialRequest(request);
 
                 } else if (request.method() == Method::Get) {
@@ -175,6 +531,7 @@ void RestConnection::checkAccessRights(const HttpRequestHeader& request)
         },
         Qt::QueuedConnection);
 
+    _phase_started = RestMetrics::timestamp();
     _access_rights_feedback_id = _rest_server->requestAccessRights(request, request.cridentials().login());
     Z_CHECK(_access_rights_feedback_id.isValid());
 }
@@ -202,7 +559,7 @@ void RestConnection::processInitialRequest(const HttpRequestHeader& request)
 void RestConnection::processGetResultRequest(const HttpRequestHeader& request)
 {
     // счетчик задач всегда увеличивается при создании нового соединения, поэтому уменьшаем, т.к. тут новая задача не создается
-    _rest_server->taskCountDecreased();
+    releaseTaskCounter();
 
     if (request.contentLength() == 0) {
         onBadRequest(Error(QStringLiteral("no session id")));
@@ -213,21 +570,62 @@ void RestConnection::processGetResultRequest(const HttpRequestHeader& request)
 
     } else {
         _session_id = QString::fromUtf8(request.content());
+        // при частичном запросе результат остается в сессии, чтобы клиент мог докачать остальное
+        _range_header = request.value(HeaderType::Range);
+        _accept_encoding = request.preferredEncoding();
 
-        auto result = _rest_server->sessionResult(_session_id);
+        auto result = _rest_server->sessionResult(_session_id, _range_header.isEmpty());
         if (result == nullptr) {
             // клиент проверяет готовность данных, но его сессии нет
             onSessionNotFound();
+
+        } else if (!result->isValid() && resultWaitTimeout(request) > 0) {
+            // данные не готовы, но клиент готов подождать
+            waitResult(resultWaitTimeout(request));
+
         } else {
             onResult(result);
         }
     }
 }
 
+bool RestConnection::isMetricsRequest(const HttpRequestHeader& request) const
+{
+    const QString& path = _rest_server->config()->metricsPath();
+    return !path.isEmpty() && request.method() == Method::Get && request.path().path() == path;
+}
+
+void RestConnection::processMetricsRequest()
+{
+    // счетчик задач всегда увеличивается при создании нового соединения, поэтому уменьшаем, т.к. тут новая задача не создается
+    releaseTaskCounter();
+
+    if (_socket != nullptr && _socket->isOpen()) {
+        HttpResponseHeader response(StatusCode::Ok);
+        response.setContent(_rest_server->metricsReport());
+        response.setContentType(ContentType::ApplicationJson);
+
+        SocketWriter* writer = createResponseWriter(response);
+        connect(writer, &SocketWriter::sg_done, this, [this]() { onResponseSent(); });
+        connect(writer, &SocketWriter::sg_error, this, [this](const Error& error) {
+            emit sg_socketError(QString(), _client_info, error);
+            onConnectionClosed();
+        });
+        writer->start();
+
+    } else {
+        onConnectionClosed();
+    }
+}
+
 void RestConnection::onBadRequest(const Error& error)
 {
     // счетчик задач всегда увеличивается при создании нового соединения, поэтому уменьшаем, т.к. тут новая задача не создается
-    _rest_server->taskCountDecreased();
+    releaseTaskCounter();
+
+    // после некорректного запроса состояние потока данных не определено - соединение закрываем
+    _keep_alive = false;
+    _unparsed.clear();
 
     emit sg_badRequest(_session_id, _client_info, error);
 
@@ -236,8 +634,7 @@ void RestConnection::onBadRequest(const Error& error)
         response.setContent(error.fullText());
         response.setContentType(ContentType::TextPlain);
 
-        SocketWriter* writer = new SocketWriter(response, _client_info, _socket, _rest_server->config()->writeBufferSize(),
-                                                _rest_server->config()->disconnectTimeout(), true, true);
+        SocketWriter* writer = createResponseWriter(response);
         connect(writer, &SocketWriter::sg_done, this, [this]() { onConnectionClosed(); });
         connect(writer, &SocketWriter::sg_error, this, [this, session_id = _session_id](const Error& error) {
             emit sg_socketError(session_id, _client_info, error);
@@ -261,15 +658,17 @@ void RestConnection::onRequestAccept(const HttpRequestHeader& request)
         response.setContent(_session_id);
         response.setContentType(ContentType::TextPlain);
 
-        SocketWriter* writer = new SocketWriter(response, _client_info, _socket, _rest_server->config()->writeBufferSize(),
-                                                _rest_server->config()->disconnectTimeout(), true, true);
+        SocketWriter* writer = createResponseWriter(response);
         connect(writer, &SocketWriter::sg_done, this, [this, session_id = _session_id, request]() {
+            // счетчик задач уменьшит RestServer при постановке задачи на обработку
+            _task_counted = false;
             // информируем сервер о необходимости создания новой сессии
             emit sg_taskCreated(session_id, request, _ip_interface_address, _client_info);
-            onConnectionClosed();
+            onResponseSent();
         });
         connect(writer, &SocketWriter::sg_error, this, [this](const Error& error) {
             // если ошибка при отправке ответа, то новую сессию создавать смысла нет
+            releaseTaskCounter();
             emit sg_socketError(_session_id, _client_info, error);
             onConnectionClosed();
         });
@@ -277,7 +676,7 @@ void RestConnection::onRequestAccept(const HttpRequestHeader& request)
 
     } else {
         // счетчик задач всегда увеличивается при создании нового соединения, поэтому уменьшаем, т.к. тут новая задача не создается
-        _rest_server->taskCountDecreased();
+        releaseTaskCounter();
         emit sg_socketError(QString(), _client_info, Error(QStringLiteral("onRequestAccept - connection closed")));
         onConnectionClosed();
     }
@@ -292,9 +691,8 @@ void RestConnection::onSessionNotFound()
         response.setContent(_session_id);
         response.setContentType(ContentType::TextPlain);
 
-        SocketWriter* writer = new SocketWriter(response, _client_info, _socket, _rest_server->config()->writeBufferSize(),
-                                                _rest_server->config()->disconnectTimeout(), true, true);
-        connect(writer, &SocketWriter::sg_done, this, [this]() { onConnectionClosed(); });
+        SocketWriter* writer = createResponseWriter(response);
+        connect(writer, &SocketWriter::sg_done, this, [this]() { onResponseSent(); });
         connect(writer, &SocketWriter::sg_error, this, [this](const Error& error) {
             emit sg_socketError(_session_id, _client_info, error);
             onConnectionClosed();
@@ -309,6 +707,12 @@ void RestConnection::onSessionNotFound()
 void RestConnection::onResult(const SessionResultPtr& result)
 {
     QScopedPointer<HttpResponseHeader> response;
+    // тело отправляется из файла или буфера результата без копирования в HttpResponseHeader
+    QIODevice* body = nullptr;
+    qint64 body_offset = 0;
+    qint64 body_size = 0;
+    // клиент получит данные до последнего байта
+    bool data_delivered = false;
 
     if (!result->isValid()) {
         // данные пока не готовы
@@ -324,21 +728,84 @@ void RestConnection::onResult(const SessionResultPtr& result)
 
     } else {
         // расчет готов
-        response.reset(new HttpResponseHeader(StatusCode::Created));
-        response->setContentType(result->contentType());
-        response->setContent(*result->data());
+        qint64 total = result->dataSize();
+        qint64 from;
+        qint64 to;
+        RangeStatus range_status = parseRange(_range_header, total, from, to);
+
+        // ответ зависит от Accept-Encoding, даже если в итоге отдается без сжатия
+        bool negotiable = isCompressionNegotiable(result);
+
+        QByteArrayPtr encoded;
+        if (range_status == RangeStatus::Full && _range_header.isEmpty() && isCompressionAllowed(result)) {
+            QByteArrayPtr source = result->data();
+            if (source != nullptr) {
+                QByteArray compressed = HttpHeader::encodeContent(*source, _accept_encoding);
+                // если сжатие не дало выигрыша, то отдаем как есть
+                if (!compressed.isNull() && compressed.size() < total)
+                    encoded = Z_MAKE_SHARED(QByteArray, compressed);
+            }
+        }
+
+        Error error;
+        if (encoded != nullptr) {
+            QBuffer* buffer = new QBuffer;
+            buffer->setData(*encoded);
+            buffer->open(QBuffer::ReadOnly);
+            body = buffer;
+
+        } else if (range_status != RangeStatus::NotSatisfiable) {
+            body = result->createDataDevice(error);
+        }
+
+        if (range_status == RangeStatus::NotSatisfiable) {
+            response.reset(new HttpResponseHeader(StatusCode::RequestRangeNotSatisfiable));
+            response->setValue(HeaderType::ContentRange, QStringLiteral("bytes */%1").arg(total));
+            response->setContentType(ContentType::TextPlain);
+            response->setContent(result->sessionId());
+
+        } else if (error.isError()) {
+            response.reset(new HttpResponseHeader(StatusCode::InternalServerError));
+            response->setContent(QStringLiteral("%1\n%2").arg(result->sessionId(), error.fullText()));
+            response->setContentType(ContentType::TextPlain);
+
+        } else if (encoded != nullptr) {
+            response.reset(new HttpResponseHeader(StatusCode::Created));
+            response->setContentType(result->contentType());
+            response->setValue(HeaderType::ContentEncoding, HttpHeader::contentEncodingToString(_accept_encoding));
+
+            body_size = encoded->size();
+            response->setValue(HeaderType::ContentLength, QString::number(body_size));
+            data_delivered = true;
+
+        } else {
+            response.reset(new HttpResponseHeader(range_status == RangeStatus::Partial ? StatusCode::PartialContent : StatusCode::Created));
+            if (range_status == RangeStatus::Partial)
+                response->setValue(HeaderType::ContentRange, QStringLiteral("bytes %1-%2/%3").arg(from).arg(to).arg(total));
+            response->setValue(HeaderType::AcceptRanges, QStringLiteral("bytes"));
+            response->setContentType(result->contentType());
+
+            body_offset = (result->isFileBacked() ? result->dataOffset() : 0) + from;
+            body_size = total == 0 ? 0 : to - from + 1;
+            response->setValue(HeaderType::ContentLength, QString::number(body_size));
+            data_delivered = total == 0 || to == total - 1;
+        }
+
+        // кэши должны различать ответы по Accept-Encoding, в т.ч. отданные без сжатия
+        if (negotiable && !error.isError())
+            response->setValue(HeaderType::Vary, QStringLiteral("Accept-Encoding"));
     }
 
     if (_socket != nullptr && _socket->isOpen()) {
-        SocketWriter* writer = new SocketWriter(*response.data(), _client_info, _socket, _rest_server->config()->writeBufferSize(),
-                                                _rest_server->config()->disconnectTimeout(), true, true);
-        connect(writer, &SocketWriter::sg_done, this, [this, result]() {
+        SocketWriter* writer = createResponseWriter(*response.data(), body, body_offset, body_size);
+        connect(writer, &SocketWriter::sg_done, this, [this, result, data_delivered, write_started = RestMetrics::timestamp()]() {
+            _rest_server->metrics()->addSince(RestMetrics::Phase::ResultWrite, write_started);
             // сообщаем о фактическом окончании сессии, т.к. клиент проинформирован о результате
             if (result->isError())
                 emit sg_resultErrorDelivered(result->sessionId(), _client_info);
-            else if (result->isValid())
+            else if (data_delivered)
                 emit sg_resultDataDelivered(result->sessionId(), _client_info);
-            onConnectionClosed();
+            onResponseSent();
         });
         connect(writer, &SocketWriter::sg_error, this, [this, result](const Error& error) {
             emit sg_socketError(result->sessionId(), _client_info, error);
@@ -347,6 +814,7 @@ void RestConnection::onResult(const SessionResultPtr& result)
         writer->start();
 
     } else {
+        delete body;
         emit sg_socketError(QString(), _client_info, Error(QStringLiteral("onResult - connection closed")));
         onConnectionClosed();
     }
@@ -359,10 +827,20 @@ void RestConnection::onConnectionClosed()
     deleteLater();
 }
 
-RestConnectionWorker::RestConnectionWorker(RestServer* rest_server)
+RestConnectionWorker::RestConnectionWorker(RestServer* rest_server, const std::shared_ptr<RestConnectionScheduler>& scheduler)
     : zf::thread::Worker(true, new RestConnectionWorkerObject)
     , _rest_server(rest_server)
+    , _scheduler(scheduler)
 {
+    Z_CHECK_NULL(_scheduler);
+
+    // сигналы генерируются в потоке worker, когда объект уже переведен в него
+    QObject::connect(
+        object(), &RestConnectionWorkerObject::sg_started, object(), [this]() { _scheduler->registerWorker(this); },
+        Qt::DirectConnection);
+    QObject::connect(
+        object(), &RestConnectionWorkerObject::sg_finished, object(), [this]() { _scheduler->unregisterWorker(this); },
+        Qt::DirectConnection);
 }
 
 RestConnectionWorker::~RestConnectionWorker()
@@ -383,21 +861,18 @@ void RestConnectionWorker::onCancell()
     }
 }
 
-void RestConnectionWorker::onRequest()
+void RestConnectionWorker::takeConnections()
 {
-    auto request = getRequest();
-    Z_CHECK_NULL(request);
-
-    qintptr socket_descriptor;
-    RestConnection::InitialStatus initial_status;
+    if (isCancelRequested())
+        return; // оставшиеся в очереди соединения получат другие потоки при unregisterWorker
 
-    QDataStream ds(request->toByteArray());
-    ds.setVersion(Consts::DATASTREAM_VERSION);
-
-    fromStreamInt(ds, socket_descriptor);
-    fromStreamInt(ds, initial_status);
+    RestConnectionScheduler::PendingConnection pending;
+    if (!_scheduler->take(this, pending))
+        return;
 
-    auto connection = _rest_server->createConnectionObject(socket_descriptor, object());
+    auto connection = _rest_server->createConnectionObject(pending.descriptor, object());
+    connection->setInitialStatus(pending.initial_status);
+    connection->setAcceptTime(pending.accept_time);
     object()->setupConnection(connection);
 
     _connections << connection;
@@ -407,7 +882,7 @@ void RestConnectionWorker::onRequest()
 void RestConnectionWorker::onConnectionDestroyed(QObject* connection)
 {
     Z_CHECK(_connections.remove(connection));
-    sendDone();
+    _scheduler->connectionFinished(this);
 }
 
 RestConnectionWorkerObject::RestConnectionWorkerObject()
@@ -2,6 +2,7 @@
 
 #include <QEventLoop>
 #include <QSslConfiguration>
+#include <QTimer>
 
 #include "zf_error.h"
 #include "zf_thread_worker.h"
@@ -15,6 +16,7 @@ namespace zf::http
 class RestServer;
 class RestConnection;
 class RestConnectionWorker;
+class RestConnectionScheduler;
 
 //! Класс для взаимодействия с RestConnectionWorker через сигналы/слоты
 class RestConnectionWorkerObject : public zf::thread::WorkerObject
@@ -83,22 +85,26 @@ signals:
     friend class RestConnectionWorker;
 };
 
-//! Соединение с клиентом. Активно только на время открытго сокета
+/*! Поток обработки соединений с клиентами. Соединения получает от RestConnectionScheduler: из своей очереди или из очереди
+ * другого потока, если своя пуста */
 class RestConnectionWorker : public zf::thread::Worker
 {    
 public:
     RestConnectionWorker(
         //! Основной сервер
-        RestServer* rest_server);
+        RestServer* rest_server,
+        //! Распределение входящих соединений
+        const std::shared_ptr<RestConnectionScheduler>& scheduler);
     ~RestConnectionWorker();
 
     RestConnectionWorkerObject* object() const;
 
+    //! Забрать ожидающее соединение и начать его обработку. Вызывается RestConnectionScheduler в потоке worker
+    void takeConnections();
+
 protected:    
     //! Вызывается при запросе остановки
     void onCancell() override;
-    //! Вызывается при запросе на обработку данных
-    void onRequest() override;
 
 private:
     //! Объект-соединение был уничтожен
@@ -106,13 +112,19 @@ private:
 
     //! Основной сервер
     RestServer* _rest_server;
+    //! Распределение входящих соединений
+    std::shared_ptr<RestConnectionScheduler> _scheduler;
     //! Соединения
     QSet<QObject*> _connections;
 
     friend class RestConnectionWorkerObject;
 };
 
-//! Соединение с клиентом. Активно только на время открытго сокета
+/*! Соединение с клиентом. Активно только на время открытго сокета
+ * Поддерживаются постоянные соединения HTTP/1.1 (keep-alive): после отправки ответа соединение ожидает следующий запрос
+ * в течение RestConfiguration::keepAliveTimeout. Запросы, присланные клиентом без ожидания ответа (pipelining),
+ * обрабатываются по очереди, ответы отправляются в порядке поступления запросов
+ * Запрос результата с заголовком Prefer: wait=N паркуется в SessionManager до готовности результата (long-poll) */
 class ZCORESHARED_EXPORT RestConnection : public QObject
 {
     Q_OBJECT
@@ -134,8 +146,10 @@ public:
         TasksLimitError,
     };
 
-    //! Вызывается до передачи в пул потоков. Состояние соединения
+    //! Вызывается в потоке соединения до process. Состояние соединения
     void setInitialStatus(InitialStatus s);
+    //! Вызывается в потоке соединения до process. Момент приема соединения (RestMetrics::timestamp)
+    void setAcceptTime(qint64 t);
 
     //! Запуск
     void process();
@@ -158,7 +172,7 @@ signals:
 
     //! Ошибка создания сокета
     void sg_socketCreationError(zf::Error error);
-    //! Соединение закрыто
+    //! Соединение закрыто. Для постоянного соединения также генерируется после завершения обмена по каждому запросу
     void sg_connectionClosed(
         //! id сессии - может быть пустым, если сессия не создавалась
         QString session_id);    
@@ -203,6 +217,64 @@ private slots:
 private:
     Q_SLOT void start();
 
+    //! Прочитать очередной запрос
+    void readRequest();
+    //! Ожидание следующего запроса в постоянном соединении
+    void waitNextRequest();
+    //! Прекратить ожидание следующего запроса или результата
+    void stopWaiting();
+    //! Ожидать готовности результата сессии (long-poll)
+    void waitResult(int timeout_sec);
+    //! Ожидание результата завершено (результат готов, сессия удалена или таймаут)
+    void onResultWaitFinished();
+    //! Сколько секунд клиент готов ждать результат (заголовок Prefer: wait=N), с учетом ограничений сервера
+    int resultWaitTimeout(const HttpRequestHeader& request) const;
+    //! Ответ отправлен. Ожидание следующего запроса или закрытие соединения
+    void onResponseSent();
+    //! Закрыть соединение по инициативе сервера
+    void closeConnection();
+    //! Сокет закрыт после closeConnection (клиентом или по таймауту)
+    void onGracefulCloseFinished();
+
+    //! Создать объект для отправки ответа. Заполняет заголовки Connection/Keep-Alive
+    SocketWriter* createResponseWriter(HttpResponseHeader& response,
+        //! Тело ответа, отправляемое из внешнего источника (становится собственностью SocketWriter). Content-Length задает вызывающий
+        QIODevice* body = nullptr,
+        //! Смещение тела в источнике
+        qint64 body_offset = 0,
+        //! Размер тела
+        qint64 body_size = 0);
+
+    //! Результат разбора заголовка Range
+    enum class RangeStatus
+    {
+        //! Отдать данные целиком (заголовка нет, он некорректен или содержит несколько диапазонов)
+        Full,
+        //! Отдать диапазон from-to
+        Partial,
+        //! Диапазон за пределами данных
+        NotSatisfiable,
+    };
+    //! Запрос статистики сервера (RestConfiguration::metricsPath)
+    bool isMetricsRequest(const HttpRequestHeader& request) const;
+    //! Ответ на запрос статистики сервера
+    void processMetricsRequest();
+    //! Сжимать ли результат для текущего запроса: клиент принимает сжатие и результат допускает сжатие
+    bool isCompressionAllowed(const SessionResultPtr& result) const;
+    //! Результат допускает сжатие независимо от запроса: тип данных текстовый, размер в пределах настроек
+    bool isCompressionNegotiable(const SessionResultPtr& result) const;
+    //! Разбор заголовка Range (RFC 7233). Поддерживается один диапазон в байтах
+    static RangeStatus parseRange(const QString& range, qint64 total, qint64& from, qint64& to);
+    //! Запрашивает ли клиент постоянное соединение
+    static bool isKeepAliveRequested(const HttpRequestHeader& request);
+
+    //! Проверка ограничений на количество задач и сессий
+    InitialStatus checkLimits() const;
+    //! Ответ клиенту о превышении ограничений
+    void onLimitsExceeded(InitialStatus status);
+    //! Уменьшить счетчик задач, если он был увеличен для текущего запроса
+    void releaseTaskCounter();
+
     //! Проверка прав доступа
     void checkAccessRights(const HttpRequestHeader& request);
     //! Обработать начальный запрос на обработку данных
@@ -230,6 +302,10 @@ private:
     qintptr _socket_descriptor;
 
     QString _session_id;
+    //! Заголовок Range текущего запроса результата
+    QString _range_header;
+    //! Сжатие, которое принимает клиент в текущем запросе результата
+    ContentEncoding _accept_encoding = ContentEncoding::Identity;
     QString _client_info;
     //! Адрес сетевого интерфейса на котором произошло подключение
     QString _ip_interface_address;
@@ -239,5 +315,33 @@ private:
     InitialStatus _initial_status = InitialStatus::OK;
 
     bool _cancelled = false;
+
+    //! Момент приема соединения
+    qint64 _accept_time = 0;
+    //! Начало текущего этапа обработки запроса (для RestMetrics)
+    qint64 _phase_started = 0;
+
+    //! Количество запросов, прочитанных в этом соединении
+    int _request_count = 0;
+    //! Оставить соединение открытым после отправки текущего ответа
+    bool _keep_alive = false;
+    //! Счетчик задач RestServer был увеличен для текущего запроса и еще не уменьшен
+    bool _task_counted = true;
+    //! Данные следующих запросов, прочитанные из сокета вместе с текущим
+    QByteArray _unparsed;
+    //! Таймер ожидания следующего запроса
+    QTimer* _idle_timer = nullptr;
+    //! Соединение припарковано до готовности результата
+    bool _result_waiting = false;
+    //! Таймер ожидания результата
+    QTimer* _result_wait_timer = nullptr;
+    //! Подключения к сигналам сокета на время ожидания следующего запроса или результата
+    QList<QMetaObject::Connection> _idle_connections;
+    //! closeConnection ожидает отключения клиента
+    bool _closing = false;
+    //! Отключение после closeConnection обработано
+    bool _closed = false;
+    //! Подключение к ответу о правах доступа для текущего запроса
+    QMetaObject::Connection _access_rights_connection;
 };
 } // namespace zf::http
@@ -0,0 +1,148 @@
+#include "zf_rest_metrics.h"
+#include "zf_core.h"
+
+#include <QtAlgorithms>
+#include <chrono>
+
+namespace zf::http
+{
+RestMetrics::RestMetrics()
+{
+    reset();
+}
+
+void RestMetrics::add(Phase phase, qint64 usec)
+{
+    int p = static_cast<int>(phase);
+    Z_CHECK(p >= 0 && p < PHASE_COUNT);
+
+    usec = qMax<qint64>(0, usec);
+    _buckets[p][bucketIndex(usec)].fetchAndAddRelaxed(1);
+    _count[p].fetchAndAddRelaxed(1);
+
+    qint64 current = _maximum[p].loadAcquire();
+    while (usec > current && !_maximum[p].testAndSetOrdered(current, usec, current)) {
+    }
+}
+
+void RestMetrics::addSince(Phase phase, qint64 started)
+{
+    if (started > 0)
+        add(phase, timestamp() - started);
+}
+
+void RestMetrics::reset()
+{
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            _buckets[p][i].storeRelease(0);
+        }
+        _count[p].storeRelease(0);
+        _maximum[p].storeRelease(0);
+    }
+}
+
+quint64 RestMetrics::count(Phase phase) const
+{
+    return _count[static_cast<int>(phase)].loadAcquire();
+}
+
+qint64 RestMetrics::maximum(Phase phase) const
+{
+    return _maximum[static_cast<int>(phase)].loadAcquire();
+}
+
+qint64 RestMetrics::percentile(Phase phase, double percent) const
+{
+    int p = static_cast<int>(phase);
+
+    // снимок корзин. Параллельные add могут дать небольшое расхождение с _count, поэтому считаем сами
+    quint64 buckets[BUCKET_COUNT];
+    quint64 total = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] = _buckets[p][i].loadAcquire();
+        total += buckets[i];
+    }
+    if (total == 0)
+        return 0;
+
+    quint64 target = qMax<quint64>(1, static_cast<quint64>(qBound(0.0, percent, 100.0) * total / 100.0 + 0.5));
+    quint64 cumulative = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        if (buckets[i] == 0)
+            continue;
+
+        if (cumulative + buckets[i] >= target) {
+            // линейная интерполяция внутри корзины
+            qint64 lower = bucketLowerBound(i);
+            qint64 upper = i + 1 < BUCKET_COUNT ? bucketLowerBound(i + 1) : maximum(phase);
+            qint64 value = lower + static_cast<qint64>((upper - lower) * static_cast<double>(target - cumulative) / buckets[i]);
+            return qMin(value, maximum(phase));
+        }
+        cumulative += buckets[i];
+    }
+
+    return maximum(phase);
+}
+
+QJsonObject RestMetrics::toJson() const
+{
+    QJsonObject res;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        Phase phase = static_cast<Phase>(p);
+
+        QJsonObject info;
+        info[QStringLiteral("count")] = static_cast<double>(count(phase));
+        info[QStringLiteral("p50_ms")] = percentile(phase, 50) / 1000.0;
+        info[QStringLiteral("p99_ms")] = percentile(phase, 99) / 1000.0;
+        info[QStringLiteral("max_ms")] = maximum(phase) / 1000.0;
+        res[phaseName(phase)] = info;
+    }
+    return res;
+}
+
+QString RestMetrics::phaseName(Phase phase)
+{
+    switch (phase) {
+        case Phase::Accept:
+            return QStringLiteral("accept");
+        case Phase::Parse:
+            return QStringLiteral("parse");
+        case Phase::AccessRights:
+            return QStringLiteral("access_rights");
+        case Phase::TaskQueue:
+            return QStringLiteral("task_queue");
+        case Phase::ResultWrite:
+            return QStringLiteral("result_write");
+    }
+    Z_HALT_INT;
+    return QString();
+}
+
+qint64 RestMetrics::timestamp()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int RestMetrics::bucketIndex(qint64 usec)
+{
+    if (usec < 4)
+        return static_cast<int>(usec);
+
+    // номер старшего бита и два следующих за ним бита
+    int msb = 63 - qCountLeadingZeroBits(static_cast<quint64>(usec));
+    int sub = static_cast<int>((usec >> (msb - 2)) & 3);
+    return qMin(4 + (msb - 2) * 4 + sub, BUCKET_COUNT - 1);
+}
+
+qint64 RestMetrics::bucketLowerBound(int index)
+{
+    if (index < 4)
+        return index;
+
+    int msb = (index - 4) / 4 + 2;
+    int sub = (index - 4) % 4;
+    return static_cast<qint64>(4 + sub) << (msb - 2);
+}
+
+} // namespace zf::http
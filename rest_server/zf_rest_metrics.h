@@ -0,0 +1,74 @@
+#pragma once
+
+#include "zf_global.h"
+
+#include <QAtomicInteger>
+#include <QJsonObject>
+
+namespace zf
+{
+namespace http
+{
+/*! Гистограммы задержек RestServer по этапам обработки запроса
+ * Корзины логарифмические (4 корзины на каждую степень двойки), поэтому перцентили вычисляются с погрешностью не
+ * более 25%. Все методы потокобезопасны и не используют блокировок */
+class ZCORESHARED_EXPORT RestMetrics
+{
+public:
+    //! Этапы обработки запроса
+    enum class Phase
+    {
+        //! От приема соединения до начала его обработки в потоке соединений
+        Accept,
+        //! Чтение и разбор HTTP запроса
+        Parse,
+        //! Проверка прав доступа
+        AccessRights,
+        //! Ожидание задачи в очереди пула потоков
+        TaskQueue,
+        //! Отправка результата клиенту
+        ResultWrite,
+    };
+    //! Количество этапов
+    static const int PHASE_COUNT = static_cast<int>(Phase::ResultWrite) + 1;
+
+    RestMetrics();
+
+    //! Зарегистрировать длительность этапа (мкс)
+    void add(Phase phase, qint64 usec);
+    //! Зарегистрировать длительность этапа, начатого в момент started (RestMetrics::timestamp)
+    void addSince(Phase phase, qint64 started);
+    //! Очистить статистику
+    void reset();
+
+    //! Количество замеров
+    quint64 count(Phase phase) const;
+    //! Максимальная длительность (мкс)
+    qint64 maximum(Phase phase) const;
+    //! Перцентиль длительности (мкс). percent от 0 до 100
+    qint64 percentile(Phase phase, double percent) const;
+
+    //! Статистика по всем этапам: количество, p50, p99, максимум (мс)
+    QJsonObject toJson() const;
+
+    //! Имя этапа
+    static QString phaseName(Phase phase);
+    //! Монотонное время (мкс). Сопоставимо между потоками
+    static qint64 timestamp();
+
+private:
+    //! Количество корзин. Длительности более 2^40 мкс попадают в последнюю
+    static const int BUCKET_COUNT = 4 + 38 * 4;
+
+    //! Номер корзины для длительности
+    static int bucketIndex(qint64 usec);
+    //! Нижняя граница корзины
+    static qint64 bucketLowerBound(int index);
+
+    QAtomicInteger<quint64> _buckets[PHASE_COUNT][BUCKET_COUNT];
+    QAtomicInteger<quint64> _count[PHASE_COUNT];
+    QAtomicInteger<qint64> _maximum[PHASE_COUNT];
+};
+
+} // namespace http
+} // namespace zf
@@ -0,0 +1,180 @@
+#include "zf_rest_scheduler.h"
+#include "zf_core.h"
+
+#include <QTcpSocket>
+
+namespace zf::http
+{
+RestConnectionScheduler::RestConnectionScheduler()
+{
+}
+
+RestConnectionScheduler::~RestConnectionScheduler()
+{
+    // все потоки остановлены, принятые сокеты никто не обработает
+    for (auto& c : qAsConst(_orphans)) {
+        closeDescriptor(c.descriptor);
+    }
+}
+
+void RestConnectionScheduler::registerWorker(RestConnectionWorker* worker)
+{
+    Z_CHECK_NULL(worker);
+
+    QMutexLocker lock(&_mutex);
+    Z_CHECK(findSlot(worker) == nullptr);
+
+    auto slot = Z_MAKE_SHARED(Slot);
+    slot->worker = worker;
+    _slots << slot;
+
+    while (!_orphans.isEmpty()) {
+        scheduleHelper(_orphans.dequeue());
+    }
+}
+
+void RestConnectionScheduler::unregisterWorker(RestConnectionWorker* worker)
+{
+    QMutexLocker lock(&_mutex);
+
+    auto slot = findSlot(worker);
+    if (slot == nullptr)
+        return;
+
+    _slots.removeOne(slot);
+    while (!slot->queue.isEmpty()) {
+        scheduleHelper(slot->queue.dequeue());
+    }
+}
+
+void RestConnectionScheduler::schedule(const PendingConnection& connection)
+{
+    QMutexLocker lock(&_mutex);
+    scheduleHelper(connection);
+}
+
+bool RestConnectionScheduler::take(RestConnectionWorker* worker, PendingConnection& connection)
+{
+    QMutexLocker lock(&_mutex);
+
+    auto slot = findSlot(worker);
+    if (slot == nullptr)
+        return false;
+
+    slot->wake_posted = false;
+
+    if (!slot->queue.isEmpty()) {
+        connection = slot->queue.dequeue();
+
+    } else {
+        // своя очередь пуста - крадем у самого отстающего потока. Берем с хвоста: голову он, возможно, уже разбирает
+        SlotPtr victim;
+        for (auto& s : qAsConst(_slots)) {
+            if (!s->queue.isEmpty() && (victim == nullptr || s->queue.count() > victim->queue.count()))
+                victim = s;
+        }
+        if (victim == nullptr)
+            return false;
+
+        connection = victim->queue.takeLast();
+    }
+
+    slot->active++;
+
+    // остальное - следующей итерацией цикла событий, чтобы уже открытые соединения потока не ждали
+    if (!slot->queue.isEmpty())
+        wake(slot);
+
+    return true;
+}
+
+void RestConnectionScheduler::connectionFinished(RestConnectionWorker* worker)
+{
+    QMutexLocker lock(&_mutex);
+
+    auto slot = findSlot(worker);
+    if (slot == nullptr)
+        return;
+
+    slot->active--;
+    Z_CHECK(slot->active >= 0);
+
+    // поток освободился - если кто-то не успевает, помогаем
+    for (auto& s : qAsConst(_slots)) {
+        if (!s->queue.isEmpty()) {
+            wake(slot);
+            break;
+        }
+    }
+}
+
+int RestConnectionScheduler::pendingCount() const
+{
+    QMutexLocker lock(&_mutex);
+
+    int count = _orphans.count();
+    for (auto& s : qAsConst(_slots)) {
+        count += s->queue.count();
+    }
+    return count;
+}
+
+void RestConnectionScheduler::scheduleHelper(const PendingConnection& connection)
+{
+    if (_slots.isEmpty()) {
+        _orphans.enqueue(connection);
+        return;
+    }
+
+    SlotPtr target;
+    for (auto& s : qAsConst(_slots)) {
+        if (target == nullptr || s->active + s->queue.count() < target->active + target->queue.count())
+            target = s;
+    }
+
+    // поток не успел разобрать предыдущие соединения (занят рукопожатием или блокирующей записью)
+    bool lagging = !target->queue.isEmpty();
+
+    target->queue.enqueue(connection);
+    wake(target);
+
+    if (lagging) {
+        // будим наименее загруженный поток с пустой очередью, он заберет соединение себе
+        SlotPtr helper;
+        for (auto& s : qAsConst(_slots)) {
+            if (s != target && s->queue.isEmpty() && (helper == nullptr || s->active < helper->active))
+                helper = s;
+        }
+        if (helper != nullptr)
+            wake(helper);
+    }
+}
+
+void RestConnectionScheduler::wake(const SlotPtr& slot)
+{
+    if (slot->wake_posted)
+        return;
+
+    slot->wake_posted = true;
+    RestConnectionWorker* worker = slot->worker;
+    QMetaObject::invokeMethod(
+        worker->object(), [worker]() { worker->takeConnections(); }, Qt::QueuedConnection);
+}
+
+RestConnectionScheduler::SlotPtr RestConnectionScheduler::findSlot(RestConnectionWorker* worker) const
+{
+    for (auto& s : qAsConst(_slots)) {
+        if (s->worker == worker)
+            return s;
+    }
+    return nullptr;
+}
+
+void RestConnectionScheduler::closeDescriptor(qintptr descriptor)
+{
+    QTcpSocket socket;
+    if (socket.setSocketDescriptor(descriptor))
+        socket.abort();
+}
+
+} // namespace zf::http
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "zf_global.h"
+#include "zf_rest_connection.h"
+
+#include <QMutex>
+#include <QQueue>
+#include <memory>
+
+namespace zf
+{
+namespace http
+{
+/*! Распределение входящих соединений по потокам RestConnectionWorker
+ * У каждого потока своя очередь принятых, но еще не обработанных сокетов. Новое соединение ставится в очередь наименее
+ * загруженного потока, а поток, у которого своя очередь пуста, забирает соединения с хвоста самой длинной чужой очереди.
+ * Поэтому поток, занятый долгим TLS рукопожатием или медленным клиентом, не задерживает соединения, попавшие к нему в очередь
+ * Потокобезопасно. Очереди короткие, операции над ними занимают O(количество потоков), поэтому защищены одним мьютексом */
+class RestConnectionScheduler
+{
+public:
+    //! Принятое соединение, ожидающее обработки
+    struct PendingConnection
+    {
+        //! Идентификатор сокета
+        qintptr descriptor = 0;
+        //! Состояние, определенное при приеме соединения
+        RestConnection::InitialStatus initial_status = RestConnection::InitialStatus::OK;
+        //! Момент приема соединения (RestMetrics::timestamp)
+        qint64 accept_time = 0;
+    };
+
+    RestConnectionScheduler();
+    ~RestConnectionScheduler();
+
+    //! Поток запущен и готов принимать соединения. Вызывается в потоке worker
+    void registerWorker(RestConnectionWorker* worker);
+    //! Поток завершается. Его очередь передается остальным. Вызывается в потоке worker
+    void unregisterWorker(RestConnectionWorker* worker);
+
+    //! Поставить соединение в очередь наименее загруженного потока
+    void schedule(const PendingConnection& connection);
+    //! Забрать соединение для обработки: из своей очереди, а если она пуста - из чужой. Вызывается в потоке worker
+    bool take(RestConnectionWorker* worker, PendingConnection& connection);
+    //! Поток закончил обработку соединения. Вызывается в потоке worker
+    void connectionFinished(RestConnectionWorker* worker);
+
+    //! Количество соединений, ожидающих обработки
+    int pendingCount() const;
+
+private:
+    //! Состояние потока
+    struct Slot
+    {
+        RestConnectionWorker* worker = nullptr;
+        //! Принятые соединения
+        QQueue<PendingConnection> queue;
+        //! Количество обрабатываемых соединений
+        int active = 0;
+        //! Запрос на разбор очереди уже отправлен в поток
+        bool wake_posted = false;
+    };
+    typedef std::shared_ptr<Slot> SlotPtr;
+
+    //! Поставить в очередь без блокировки
+    void scheduleHelper(const PendingConnection& connection);
+    //! Отправить потоку запрос на разбор очереди
+    void wake(const SlotPtr& slot);
+    SlotPtr findSlot(RestConnectionWorker* worker) const;
+    //! Закрыть сокет, который некому обработать
+    static void closeDescriptor(qintptr descriptor);
+
+    mutable QMutex _mutex;
+    QList<SlotPtr> _slots;
+    //! Соединения, принятые до запуска первого потока
+    QQueue<PendingConnection> _orphans;
+};
+
+} // namespace http
+} // namespace zf
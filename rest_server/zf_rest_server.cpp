@@ -16,6 +16,7 @@
 #include <QFile>
 #include <QTextCodec>
 #include <QApplication>
+#include <QJsonDocument>
 
 #include "zf_core.h"
 #include "zf_html_tools.h"
@@ -26,6 +27,7 @@ namespace zf::http
 RestServer::RestServer(QObject* parent)
     : QObject(parent)
     , _session_manager(std::make_unique<SessionManager>(this))
+    , _metrics(std::make_unique<RestMetrics>())
 {
 }
 
@@ -161,13 +163,42 @@ int RestServer::processingTaskCount() const
     return _task_controller->count();
 }
 
-SessionResultPtr RestServer::sessionResult(const QString& session_id) const
+RestMetrics* RestServer::metrics() const
+{
+    return _metrics.get();
+}
+
+QByteArray RestServer::metricsReport() const
+{
+    QJsonObject report;
+    report[QStringLiteral("sessions")] = sessionCount();
+    report[QStringLiteral("tasks")] = taskCount();
+    report[QStringLiteral("processing_tasks")] = processingTaskCount();
+    report[QStringLiteral("phases")] = _metrics->toJson();
+
+    return QJsonDocument(report).toJson(QJsonDocument::Indented);
+}
+
+SessionResultPtr RestServer::sessionResult(const QString& session_id, bool take) const
 {
     auto session = getSessionById(session_id);
     if (session == nullptr)
         return nullptr;
 
-    return session->isTaskCompleted() ? session->takeResult() : Z_MAKE_SHARED(SessionResult);
+    if (!session->isTaskCompleted())
+        return Z_MAKE_SHARED(SessionResult);
+
+    return take ? session->takeResult() : session->peekResult();
+}
+
+bool RestServer::waitSessionResult(const QString& session_id, QObject* receiver, const std::function<void()>& wake) const
+{
+    return _session_manager->parkConnection(session_id, receiver, wake);
+}
+
+void RestServer::cancelWaitSessionResult(const QString& session_id, QObject* receiver) const
+{
+    _session_manager->unparkConnection(session_id, receiver);
 }
 
 QHostAddress RestServer::host() const
@@ -209,6 +240,7 @@ void RestServer::processTaskRequest(const QString& session_id, const HttpRequest
         return;
     }
     _pending_requests[task->id()] = Z_MAKE_SHARED(QVariant, QVariant::fromValue(request));
+    _task_queued_time[task->id()] = RestMetrics::timestamp();
 
     _session_manager->registerNewSession(ip_interface_address, client_info, session_id, _config.keepDataTimout());
     _session_manager->requestFlush();
@@ -316,6 +348,12 @@ Error RestServer::loadConfig(const QString& config_file, RestConfiguration& conf
     QString collect_garbage_arg = settings.value("tuning/collect").toString();
     QString cache_size_arg = settings.value("tuning/cache").toString();
     QString max_size_arg = settings.value("tuning/maxsize").toString();
+    QString keep_alive_arg = settings.value("tuning/keepalive").toString();
+    QString keep_alive_max_arg = settings.value("tuning/keepalive-max").toString();
+    QString long_poll_arg = settings.value("tuning/longpoll").toString();
+    QString compress_arg = settings.value("tuning/compress").toString();
+    QString compress_max_arg = settings.value("tuning/compress-max").toString();
+    QString metrics_arg = settings.value("tuning/metrics").toString().trimmed();
 
     port = port_arg.toUInt();
     if (port <= 0)
@@ -365,6 +403,16 @@ Error RestServer::loadConfig(const QString& config_file, RestConfiguration& conf
     if (max_size <= 0)
         max_size = 10;
 
+    // 0 - отключить keep-alive, поэтому значение по умолчанию только если параметр не задан
+    quint64 keep_alive = keep_alive_arg.isEmpty() ? 15 : keep_alive_arg.toUInt();
+    quint64 keep_alive_max = keep_alive_max_arg.isEmpty() ? 1000 : keep_alive_max_arg.toUInt();
+    quint64 long_poll = long_poll_arg.isEmpty() ? 60 : long_poll_arg.toUInt();
+    quint64 compress = compress_arg.isEmpty() ? 1024 : compress_arg.toUInt();
+
+    quint64 compress_max = compress_max_arg.toUInt();
+    if (compress_max <= 0)
+        compress_max = 64;
+
     if (key.isEmpty() != certificate.isEmpty()) {
         if (key.isEmpty())
             return Error("ssl key file not defined");
@@ -392,6 +440,12 @@ Error RestServer::loadConfig(const QString& config_file, RestConfiguration& conf
     config.setMaxSessionResultCached(cache_size);
     config.setCollectGarbagePeriod(collect_garbage);
     config.setMaxRequestContentSize(max_size);
+    config.setKeepAliveTimeout(qMin<quint64>(keep_alive, std::numeric_limits<quint16>::max()));
+    config.setMaxKeepAliveRequests(qMin<quint64>(keep_alive_max, std::numeric_limits<quint16>::max()));
+    config.setMaxResultWaitTimeout(qMin<quint64>(long_poll, std::numeric_limits<quint16>::max()));
+    config.setCompressionThreshold(qMin<quint64>(compress, std::numeric_limits<quint32>::max()));
+    config.setCompressionMaxSize(qMin<quint64>(compress_max, std::numeric_limits<quint32>::max()));
+    config.setMetricsPath(metrics_arg.isEmpty() || metrics_arg.startsWith('/') ? metrics_arg : "/" + metrics_arg);
     config.setAcceptedVersions({Version(1, 0, 0)});
 
     return Error();
@@ -436,6 +490,7 @@ void RestServer::sl_task_started(const QString& session_id)
     auto request = _pending_requests.value(session_id);
     Z_CHECK_NULL(request);
     _pending_requests.remove(session_id);
+    _metrics->addSince(RestMetrics::Phase::TaskQueue, _task_queued_time.take(session_id));
     // отправляем запрос на обработку
     _task_controller->request(session_id, request);
 
@@ -613,6 +668,9 @@ void RestServer::sl_task_error(const QString& session_id, qint64 status, const Q
 
 void RestServer::sl_task_finished(const QString& session_id)
 {
+    // задача могла быть отменена, не дойдя до запуска
+    _task_queued_time.remove(session_id);
+
     auto session = getSessionById(session_id);
     if (session != nullptr) {
         if (!session->isTaskCompleted())
@@ -16,6 +16,7 @@
 #include "zf_rest_tcp_server.h"
 #include "zf_rest_session.h"
 #include "zf_rest_config.h"
+#include "zf_rest_metrics.h"
 #include "zf_message.h"
 
 #define Z_REST_SERVER_DEBUG 0
@@ -41,6 +42,8 @@ namespace http
      *   Если количество выполняемых задач превышает лимит, то 504 (GatewayTimeout) text/plain с body, содержащим текст
      * ошибки Если количество входящих соединений превышает лимит, то они закрываются без обратной связи
      * 3. Клиент периодически шлет запрос GET с text/plain body, содержащим ID сессии
+     *    Если в запросе есть заголовок Prefer: wait=<секунды>, то при неготовом результате сервер держит запрос до его готовности,
+     * но не дольше указанного времени и RestConfiguration::maxResultWaitTimeout (long-poll)
      * 4. Сервер в ответ:
      *      Если результат готов, то отвечает 201 (Created) с body, содержащим результат выполнения (формат зависит от
      * реализации) Если результат не готов, то отвечает 204 (No Content) с пустым body.
@@ -84,8 +87,19 @@ namespace http
         //! Количество задач, которые сейчас вычисляются (запущены соответствующие потоки)
         int processingTaskCount() const;
 
-        //! Результат выполнения сессии по ее id. Если сессия не найдена, то nullptr
-        SessionResultPtr sessionResult(const QString& session_id) const;
+        //! Гистограммы задержек по этапам обработки запросов. Потокобезопасно
+        RestMetrics* metrics() const;
+        //! Статистика сервера в JSON: количество сессий и задач, задержки по этапам
+        QByteArray metricsReport() const;
+
+        /*! Результат выполнения сессии по ее id. Если сессия не найдена или результат уже забран, то nullptr
+         * При take == false результат остается в сессии (частичная выдача по HTTP Range) */
+        SessionResultPtr sessionResult(const QString& session_id, bool take = true) const;
+        /*! Ожидать результат сессии (long-poll). wake будет вызван в потоке receiver при установке результата или удалении сессии
+         * Возвращает false, если ждать нечего: сессии нет или результат уже готов. Потокобезопасно */
+        bool waitSessionResult(const QString& session_id, QObject* receiver, const std::function<void()>& wake) const;
+        //! Прекратить ожидание результата сессии. Потокобезопасно
+        void cancelWaitSessionResult(const QString& session_id, QObject* receiver) const;
 
         //! Адрес
         QHostAddress host() const;
@@ -273,6 +287,10 @@ namespace http
 
         //! Управление сессиями
         std::unique_ptr<SessionManager> _session_manager;
+        //! Статистика задержек
+        std::unique_ptr<RestMetrics> _metrics;
+        //! Время постановки задачи в очередь пула потоков. Ключ - id задачи
+        QHash<QString, qint64> _task_queued_time;
 
         //! Вывод в консоль информации о превышении количества сессий не чаще чем указано
         QElapsedTimer _too_many_session_info;
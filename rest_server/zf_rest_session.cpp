@@ -4,6 +4,10 @@
 #include "zf_core.h"
 #include "zf_rest_server.h"
 
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QBuffer>
+
 namespace zf::http
 {
 SessionCacheItem::SessionCacheItem(const QString& session_id)
@@ -108,7 +112,9 @@ void Session::setTaskResult(ContentType content_type, QByteArrayPtr data)
 
     _result = Z_MAKE_SHARED(SessionResult, _session_id, content_type, data);
     _result_was_set = true;
+    lock.unlock();
 
+    // вне блокировки: обработчики обращаются к SessionManager, который сам блокирует сессии
     emit sg_resultInstalled(_session_id);
 }
 
@@ -119,6 +125,7 @@ void Session::setTaskError(const Error& error, StatusCode error_status)
 
     _result = Z_MAKE_SHARED(SessionResult, _session_id, error, error_status);
     _result_was_set = true;
+    lock.unlock();
 
     emit sg_resultInstalled(_session_id);
 }
@@ -129,18 +136,42 @@ bool Session::isResultTaken() const
     return _result_taken;
 }
 
-static const int _session_stream_version = 3;
+//! Данные результата пишутся в отдельный файл, который после записи не изменяется
+static const int _session_stream_version = 5;
+//! Данные результата пишутся в конец файла как есть
+static const int _session_stream_version_tail = 4;
+//! Данные результата внутри QDataStream
+static const int _session_stream_version_inline = 3;
+//! Размер блока при копировании данных результата из файла в файл
+static const qint64 _session_copy_block_size = 256 * 1024;
+
+QString Session::dataFileName(const QString& file_name)
+{
+    return file_name + QStringLiteral(".data");
+}
+
 Error Session::saveToFile(const QString& file_name) const
-{    
-    QFile f(file_name);
-    if (!f.open(QFile::WriteOnly | QFile::Truncate))
+{
+    QMutexLocker lock(&_mutex);
+
+    /* Данные результата могут в этот момент отдаваться клиенту прямо из файла (в т.ч. по Range), поэтому файл с данными
+     * никогда не перезаписывается: он создается один раз, а при повторном сохранении перезаписываются только метаданные */
+    if (_result != nullptr && (_result->_data != nullptr || _result->isFileBacked())) {
+        QString data_file_name = dataFileName(file_name);
+        if (_result->dataFile() != data_file_name) {
+            Error error = saveDataToFile(data_file_name);
+            if (error.isError())
+                return error;
+        }
+    }
+
+    QSaveFile f(file_name);
+    if (!f.open(QFile::WriteOnly))
         return Error::fileIOError(file_name);
 
     QDataStream st(&f);
     st.setVersion(Consts::DATASTREAM_VERSION);
 
-    QMutexLocker lock(&_mutex);
-
     st << _session_stream_version;
     st << _session_id;
     st << _client_info;
@@ -156,7 +187,53 @@ Error Session::saveToFile(const QString& file_name) const
     if (_result != nullptr)
         st << *_result.get();
 
-    f.close();
+    if (st.status() != QDataStream::Ok) {
+        f.cancelWriting();
+        return Error::fileIOError(file_name);
+    }
+
+    if (!f.commit())
+        return Error::fileIOError(file_name);
+
+    return Error();
+}
+
+Error Session::saveDataToFile(const QString& data_file_name) const
+{
+    // файл с таким именем может существовать только от прерванного сохранения, читателей у него нет
+    QSaveFile f(data_file_name);
+    if (!f.open(QFile::WriteOnly))
+        return Error::fileIOError(data_file_name);
+
+    if (_result->isFileBacked()) {
+        // переносим данные из предыдущего файла блоками, не загружая целиком
+        QFile source(_result->dataFile());
+        if (!source.open(QFile::ReadOnly) || !source.seek(_result->dataOffset())) {
+            f.cancelWriting();
+            return Error::fileIOError(source);
+        }
+
+        QByteArray block;
+        qint64 left = _result->dataSize();
+        while (left > 0) {
+            block = source.read(qMin(left, _session_copy_block_size));
+            if (block.isEmpty() || f.write(block) != block.size()) {
+                f.cancelWriting();
+                return Error::fileIOError(data_file_name);
+            }
+            left -= block.size();
+        }
+
+    } else if (!_result->_data->isEmpty()) {
+        if (f.write(*_result->_data) != _result->_data->size()) {
+            f.cancelWriting();
+            return Error::fileIOError(data_file_name);
+        }
+    }
+
+    if (!f.commit())
+        return Error::fileIOError(data_file_name);
+
     return Error();
 }
 
@@ -176,7 +253,7 @@ std::shared_ptr<Session> Session::loadFromFile(const QString& file_name, Error&
     SessionPtr session = SessionPtr(new Session());
     int version;
     st >> version;
-    if (version != _session_stream_version) {
+    if (version != _session_stream_version && version != _session_stream_version_tail && version != _session_stream_version_inline) {
         f.close();
         error = Error("wrong Session version file");
         return nullptr;
@@ -197,6 +274,22 @@ std::shared_ptr<Session> Session::loadFromFile(const QString& file_name, Error&
     if (has_result) {
         session->_result = Z_MAKE_SHARED(SessionResult);
         st >> *session->_result.get();
+
+        if (version == _session_stream_version && st.status() == QDataStream::Ok && session->_result->_data_size > 0) {
+            // данные остаются на диске и отдаются клиенту прямо из файла
+            QString data_file_name = dataFileName(file_name);
+            session->_result->_data_file = data_file_name;
+            session->_result->_data_offset = 0;
+            if (QFileInfo(data_file_name).size() < session->_result->_data_size)
+                st.setStatus(QDataStream::ReadPastEnd);
+
+        } else if (version == _session_stream_version_tail && st.status() == QDataStream::Ok && session->_result->_data_size > 0) {
+            // старый формат: данные в конце файла сессии
+            session->_result->_data_file = file_name;
+            session->_result->_data_offset = f.pos();
+            if (f.size() < session->_result->_data_offset + session->_result->_data_size)
+                st.setStatus(QDataStream::ReadPastEnd);
+        }
     }
 
     if (st.status() != QDataStream::Ok)
@@ -211,7 +304,8 @@ SessionResultPtr Session::takeResult() const
 {
     QMutexLocker lock(&_mutex);
     Z_CHECK(_result_was_set);
-    Z_CHECK(!_result_taken);
+    if (_result_taken)
+        return nullptr; // другое соединение успело забрать раньше
 
     auto res_copy = _result;
     _result.reset();
@@ -222,6 +316,13 @@ SessionResultPtr Session::takeResult() const
     return res_copy;
 }
 
+SessionResultPtr Session::peekResult() const
+{
+    QMutexLocker lock(&_mutex);
+    Z_CHECK(_result_was_set);
+    return _result;
+}
+
 SessionResult::SessionResult()
 {
 }
@@ -230,6 +331,9 @@ SessionResult::SessionResult(const SessionResult& r)
     : _session_id(r._session_id)
     , _content_type(r._content_type)
     , _data(r._data)
+    , _data_file(r._data_file)
+    , _data_offset(r._data_offset)
+    , _data_size(r._data_size)
     , _error(r._error)
     , _error_status(r._error_status)
 {
@@ -278,7 +382,58 @@ ContentType SessionResult::contentType() const
 
 QByteArrayPtr SessionResult::data() const
 {
-    return _data;
+    if (_data != nullptr || !isFileBacked())
+        return _data;
+
+    QFile f(_data_file);
+    if (!f.open(QFile::ReadOnly) || !f.seek(_data_offset))
+        return nullptr;
+
+    return Z_MAKE_SHARED(QByteArray, f.read(_data_size));
+}
+
+qint64 SessionResult::dataSize() const
+{
+    if (isFileBacked())
+        return _data_size;
+
+    return _data == nullptr ? 0 : _data->size();
+}
+
+bool SessionResult::isFileBacked() const
+{
+    return !_data_file.isEmpty();
+}
+
+QString SessionResult::dataFile() const
+{
+    return _data_file;
+}
+
+qint64 SessionResult::dataOffset() const
+{
+    return _data_offset;
+}
+
+QIODevice* SessionResult::createDataDevice(Error& error) const
+{
+    error.clear();
+
+    if (isFileBacked()) {
+        QFile* f = new QFile(_data_file);
+        if (!f->open(QFile::ReadOnly)) {
+            error = Error::fileIOError(_data_file);
+            delete f;
+            return nullptr;
+        }
+        return f;
+    }
+
+    QBuffer* buffer = new QBuffer;
+    if (_data != nullptr)
+        buffer->setData(*_data);
+    buffer->open(QBuffer::ReadOnly);
+    return buffer;
 }
 
 Error SessionResult::error() const
@@ -291,13 +446,18 @@ StatusCode SessionResult::errorStatus() const
     return _error_status;
 }
 
-static const int _session_result_stream_version = 1;
+//! Только метаданные, данные пишутся отдельно
+static const int _session_result_stream_version = 2;
+//! Данные внутри потока
+static const int _session_result_stream_version_inline = 1;
 QDataStream& operator<<(QDataStream& s, const SessionResult& res)
 {
     s << _session_result_stream_version;
     s << res._session_id;
     toStreamInt(s, res._content_type);
-    s << (res._data == nullptr ? QByteArray() : *res.data());
+    bool has_data = res._data != nullptr || res.isFileBacked();
+    s << has_data;
+    s << res.dataSize();
     s << res._error;
     toStreamInt(s, res._error_status);
     return s;
@@ -309,7 +469,7 @@ QDataStream& operator>>(QDataStream& s, SessionResult& res)
 
     int version;
     s >> version;
-    if (version != _session_result_stream_version) {
+    if (version != _session_result_stream_version && version != _session_result_stream_version_inline) {
         if (s.status() == QDataStream::Ok)
             s.setStatus(QDataStream::ReadCorruptData);
         return s;
@@ -318,12 +478,22 @@ QDataStream& operator>>(QDataStream& s, SessionResult& res)
     s >> res._session_id;
     fromStreamInt(s, res._content_type);
 
-    QByteArray data;
-    s >> data;
-    if (data.isNull())
-        res._data.reset();
-    else
-        res._data = Z_MAKE_SHARED(QByteArray, data);
+    if (version == _session_result_stream_version_inline) {
+        QByteArray data;
+        s >> data;
+        if (data.isNull())
+            res._data.reset();
+        else
+            res._data = Z_MAKE_SHARED(QByteArray, data);
+
+    } else {
+        bool has_data;
+        s >> has_data;
+        s >> res._data_size;
+        // сами данные остаются в файле. Если их нет, то пустой массив, как у результата с ошибкой
+        if (has_data && res._data_size == 0)
+            res._data = Z_MAKE_SHARED(QByteArray);
+    }
 
     s >> res._error;
     fromStreamInt(s, res._error_status);
@@ -384,6 +554,7 @@ SessionPtr SessionManager::getSession(const QString& session_id)
         }
 
         info->session = session;
+        connectSession(session);
         registerInCache(session_id);
     }
 
@@ -409,7 +580,7 @@ SessionPtr SessionManager::registerNewSession(const QString& ip_interface_addres
 
 SessionPtr SessionManager::registerNewSessionHelper(const SessionPtr& session)
 {
-    connect(session.get(), &Session::sg_resultInstalled, this, &SessionManager::sl_sessionResultInstalled);
+    connectSession(session);
 
     auto session_info = Z_MAKE_SHARED(SessionInfo);
 
@@ -436,6 +607,8 @@ Error SessionManager::removeSession(const QString& session_id)
         info->session->closeSession();
 
     Error error = Utils::removeFile(sessionFileName(session_id));
+    if (error.isOk() && QFile::exists(Session::dataFileName(sessionFileName(session_id))))
+        error = Utils::removeFile(Session::dataFileName(sessionFileName(session_id)));
     if (error.isOk()) {
         _sessions->remove(session_id);
         removeFromCache(session_id);
@@ -444,6 +617,9 @@ Error SessionManager::removeSession(const QString& session_id)
         _server->log(error);
     }
 
+    // ожидающие соединения ответят клиенту, что сессии больше нет
+    wakeParkedConnections(session_id);
+
     return error;
 }
 
@@ -499,6 +675,63 @@ int SessionManager::sessionInMemoryCount() const
     return _session_cache.count();
 }
 
+bool SessionManager::parkConnection(const QString& session_id, QObject* receiver, const std::function<void()>& wake)
+{
+    Z_CHECK_NULL(receiver);
+    Z_CHECK(wake != nullptr);
+
+    // до блокировки _parked_mutex, чтобы не нарушать порядок блокировок
+    SessionPtr session = getSession(session_id);
+    if (session == nullptr)
+        return false;
+
+    QMutexLocker lock(&_parked_mutex);
+    // результат устанавливается под Session::_mutex, а будят после этого под _parked_mutex. Поэтому, если здесь результата
+    // еще нет, то sl_sessionResultInstalled гарантированно увидит это соединение
+    if (session->isTaskCompleted() || session->isSessionClosed())
+        return false;
+
+    _parked.insert(session_id, {receiver, wake});
+    return true;
+}
+
+void SessionManager::unparkConnection(const QString& session_id, QObject* receiver)
+{
+    QMutexLocker lock(&_parked_mutex);
+    for (auto i = _parked.find(session_id); i != _parked.end() && i.key() == session_id;) {
+        if (i.value().receiver == receiver || i.value().receiver.isNull())
+            i = _parked.erase(i);
+        else
+            ++i;
+    }
+}
+
+int SessionManager::parkedConnectionCount() const
+{
+    QMutexLocker lock(&_parked_mutex);
+    return _parked.count();
+}
+
+void SessionManager::wakeParkedConnections(const QString& session_id)
+{
+    QMutexLocker lock(&_parked_mutex);
+    for (auto& p : _parked.values(session_id)) {
+        if (!p.receiver.isNull())
+            QMetaObject::invokeMethod(p.receiver.data(), p.wake, Qt::QueuedConnection);
+    }
+    _parked.remove(session_id);
+}
+
+void SessionManager::connectSession(const SessionPtr& session)
+{
+    // кэш сессий обслуживается в потоке менеджера
+    connect(session.get(), &Session::sg_resultInstalled, this, &SessionManager::sl_sessionResultInstalled);
+    // будим сразу в потоке задачи: затрагивается только _parked_mutex
+    connect(
+        session.get(), &Session::sg_resultInstalled, this, [this](const QString& session_id) { wakeParkedConnections(session_id); },
+        Qt::DirectConnection);
+}
+
 void SessionManager::sl_sessionResultInstalled(const QString& session_id)
 {    
     QMutexLocker lock(&_mutex);
@@ -578,6 +811,10 @@ Error SessionManager::loadSessionsFromDisk()
     QDir dir(sessionManagerFolder());
     Error error;
     for (auto& file_name : dir.entryList(QDir::Files)) {
+        // данные результатов загружаются вместе с сессией
+        if (file_name.endsWith(QStringLiteral(".data")))
+            continue;
+
         error << loadSession(sessionIdFromFileName(QFileInfo(file_name).fileName()));
     }
 
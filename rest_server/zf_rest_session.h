@@ -3,7 +3,10 @@
 #include <QMutexLocker>
 #include <QDateTime>
 #include <QCache>
+#include <QMap>
 #include <QTimer>
+#include <QPointer>
+#include <functional>
 
 #include "zf_error.h"
 #include "zf_http_headers.h"
@@ -33,8 +36,22 @@ public:
 
     //! HTTP content type для task_result_data
     ContentType contentType() const;
-    //! Данные, которые подготовил обработчик
+    //! Данные, которые подготовил обработчик. Для результата, сброшенного на диск, данные читаются из файла целиком,
+    //! поэтому для отправки клиенту использовать createDataDevice
     QByteArrayPtr data() const;
+    //! Размер данных (байт)
+    qint64 dataSize() const;
+
+    //! Данные хранятся на диске, а не в памяти
+    bool isFileBacked() const;
+    //! Файл, в котором хранятся данные
+    QString dataFile() const;
+    //! Смещение данных в файле
+    qint64 dataOffset() const;
+
+    /*! Открыть данные для последовательного чтения без загрузки в память. За удаление отвечает вызывающий
+     * Для результата на диске возвращает QFile, позиционирование на dataOffset выполняет вызывающий */
+    QIODevice* createDataDevice(Error& error) const;
 
     //! Ошибка, которую сгенерировал обработчик
     Error error() const;
@@ -48,13 +65,21 @@ private:
     ContentType _content_type = ContentType::Unknown;
     //! Данные, которые подготовил обработчик
     QByteArrayPtr _data;
+    //! Файл, в котором хранятся данные (если они сброшены на диск)
+    QString _data_file;
+    //! Смещение данных в файле
+    qint64 _data_offset = 0;
+    //! Размер данных в файле
+    qint64 _data_size = 0;
     //! Ошибка, которую сгенерировал обработчик
     Error _error;
     //! Статус ошибки
     StatusCode _error_status = StatusCode::Ok;
 
+    //! Сериализуются только метаданные. Сами данные Session::saveToFile пишет как есть в отдельный файл Session::dataFileName
     friend ZCORESHARED_EXPORT QDataStream& operator<<(QDataStream& s, const zf::http::SessionResult& res);
     friend ZCORESHARED_EXPORT QDataStream& operator>>(QDataStream& s, zf::http::SessionResult& res);
+    friend class Session;
 };
 typedef std::shared_ptr<SessionResult> SessionResultPtr;
 
@@ -104,6 +129,8 @@ public:
     /*! Результат выполнения задачи. Для корректной работы с потоками, результат можно забрать только один раз,
      * после этого он удаляется из сессии */
     SessionResultPtr takeResult() const;
+    //! Результат выполнения задачи без изъятия из сессии (частичная выдача по HTTP Range)
+    SessionResultPtr peekResult() const;
     //! Был ли забран результат выполнения задачи
     bool isResultTaken() const;
 
@@ -129,8 +156,13 @@ private:
         //! Когда была создана
         const QDateTime& created);
 
-    //! Сохранить в файл
+    /*! Сохранить в файл. Метаданные пишутся через QDataStream, данные результата как есть пишутся в отдельный файл dataFileName.
+     * Данные не загружаются в память ни при сохранении, ни при чтении - отправляются клиенту напрямую из файла */
     Error saveToFile(const QString& file_name) const;
+    //! Записать данные результата в отдельный файл
+    Error saveDataToFile(const QString& data_file_name) const;
+    //! Имя файла с данными результата для файла сессии
+    static QString dataFileName(const QString& file_name);
     //! Создать объект из файла
     static std::shared_ptr<Session> loadFromFile(const QString& file_name, Error& error);
 
@@ -222,6 +254,15 @@ public:
     //! Загрузить все сессии с диска (начальная инициализация)
     Error loadSessionsFromDisk();
 
+    /*! Припарковать соединение до установки результата сессии (long-poll). Потокобезопасно
+     * wake вызывается в потоке receiver через Qt::QueuedConnection при установке результата или удалении сессии
+     * Возвращает false, если ждать нечего: сессии нет или результат уже установлен */
+    bool parkConnection(const QString& session_id, QObject* receiver, const std::function<void()>& wake);
+    //! Убрать соединение из ожидания результата (таймаут или закрытие соединения). Потокобезопасно
+    void unparkConnection(const QString& session_id, QObject* receiver);
+    //! Количество соединений, ожидающих результат
+    int parkedConnectionCount() const;
+
 private slots:
     //! Установлен результат расчета сессии
     void sl_sessionResultInstalled(const QString& session_id);
@@ -242,6 +283,10 @@ private:
     Error flushSession(const QString& session_id);
     //! Загрузить сессию с диска
     Error loadSession(const QString& session_id);
+    //! Разбудить соединения, ожидающие результат сессии
+    void wakeParkedConnections(const QString& session_id);
+    //! Подключиться к сигналам сессии
+    void connectSession(const SessionPtr& session);
 
     mutable Z_RECURSIVE_MUTEX _mutex;
 
@@ -284,6 +329,18 @@ private:
     //! Ошибки при удалении из кэша и сохранении на диск
     Error _last_remove_cache_errors;
 
+    //! Соединение, ожидающее результат сессии
+    struct ParkedConnection
+    {
+        QPointer<QObject> receiver;
+        std::function<void()> wake;
+    };
+    //! Соединения, ожидающие результат. Ключ - session id
+    QMultiHash<QString, ParkedConnection> _parked;
+    /*! Отдельный мьютекс, т.к. парковка идет из потоков соединений. Порядок блокировки: _parked_mutex -> Session::_mutex,
+     * _mutex -> _parked_mutex. Session::sg_resultInstalled генерируется вне Session::_mutex */
+    mutable QMutex _parked_mutex;
+
     QTimer _collect_garbage_timer;
     QTimer _flush_timer;
 };
@@ -3,7 +3,7 @@
 #include "zf_rest_connection.h"
 #include "zf_rest_server.h"
 #include "zf_socket_operations.h"
-#include "zf_rest_server.h"
+#include "zf_rest_scheduler.h"
 
 #include <QSslKey>
 #include <QSslCertificate>
@@ -12,6 +12,7 @@ namespace zf::http
 {
 RestTcpServer::RestTcpServer(RestServer* rest_server, QObject* parent)
     : QTcpServer(parent)
+    , _scheduler(std::make_shared<RestConnectionScheduler>())
     , _rest_server(rest_server)
 {
     Z_CHECK_NULL(_rest_server);
@@ -31,7 +32,7 @@ RestTcpServer::RestTcpServer(RestServer* rest_server, QObject* parent)
 
     // инициализируем пул обработчиков соединений
     for (int i = 0; i < rest_server->config()->connectionsThreadCount(); i++) {
-        _connection_controller->startWorker(new RestConnectionWorker(rest_server));
+        _connection_controller->startWorker(new RestConnectionWorker(rest_server, _scheduler));
     }
 }
 
@@ -94,18 +95,12 @@ void RestTcpServer::incomingConnection(qintptr handle)
 
     _rest_server->taskCountIncreased();
 
-    // выбираем поток с наименьшей нагрузкой
-    QString best_task_id = _connection_controller->bestTask();
-    Z_CHECK(!best_task_id.isEmpty());
-
-    // шлем ему запрос
-    QByteArray data;
-    QDataStream ds(&data, QIODevice::WriteOnly);
-    ds.setVersion(Consts::DATASTREAM_VERSION);
-
-    toStreamInt(ds, handle);
-    toStreamInt(ds, initial_status);
-    _connection_controller->request(best_task_id, Z_MAKE_SHARED(QVariant, data));
+    // в очередь наименее загруженного потока. Если он не успевает, соединение заберет другой
+    RestConnectionScheduler::PendingConnection pending;
+    pending.descriptor = handle;
+    pending.initial_status = initial_status;
+    pending.accept_time = RestMetrics::timestamp();
+    _scheduler->schedule(pending);
 
     /* делаем вид что добавляем сокет, чтобы задействовать механизм ограничения входящих соединений
      * но реальный сокет добавить нельзя, т.к. он должен быть создан внутри потока RestConnection */
@@ -7,12 +7,15 @@
 #include "zf_thread_controller.h"
 #include "zf_http_headers.h"
 
+#include <memory>
+
 namespace zf
 {
 namespace http
 {
 class RestServer;
 class RestConnection;
+class RestConnectionScheduler;
 
 class RestTcpServer : public QTcpServer
 {
@@ -89,6 +92,8 @@ private:
 
     //! Менеджер потоков для обработки входящих соединений
     thread::Controller* _connection_controller;
+    //! Распределение входящих соединений по потокам. Разделяется с потоками, т.к. они могут завершиться позже сервера
+    std::shared_ptr<RestConnectionScheduler> _scheduler;
     //! Основной сервер
     RestServer* _rest_server;
 };
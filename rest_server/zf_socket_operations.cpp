@@ -1,6 +1,8 @@
 #include "zf_socket_operations.h"
 #include "zf_core.h"
 
+#include <QFileDevice>
+
 namespace zf::http
 {
 SocketOperation::SocketOperation(const QString& host_info, QAbstractSocket* socket, quint16 buffer_size, quint32 disconnect_timeout,
@@ -292,6 +294,17 @@ Error SocketHttpReader::wait(HttpRequestHeader& request, HttpResponseHeader& res
     return res;
 }
 
+void SocketHttpReader::setUnparsedData(const QByteArray& data)
+{
+    Z_CHECK(!isStarted());
+    _unparsed = data;
+}
+
+QByteArray SocketHttpReader::unparsedData() const
+{
+    return _unparsed;
+}
+
 Error SocketHttpReader::read(HttpRequestHeader& request, const QString& host_info, QAbstractSocket* socket, qint64 read_buffer_size,
                              quint32 disconnect_timeout, bool close_on_finish)
 {
@@ -354,7 +367,16 @@ void SocketHttpReader::sl_readyRead()
         return;
     }
 
-    QString error = _parcer->parse(socket());
+    QString error;
+    if (!_unparsed.isEmpty()) {
+        // сначала то, что осталось от предыдущего запроса в том же соединении
+        auto ssl_socket = qobject_cast<QSslSocket*>(socket());
+        error = _parcer->parse(_unparsed, ssl_socket != nullptr && ssl_socket->isEncrypted());
+        _unparsed.clear();
+    }
+    if (error.isEmpty())
+        error = _parcer->parse(socket());
+
     if (!error.isEmpty()) {
         _parcer->clear();
         setError(Error(error));
@@ -364,6 +386,8 @@ void SocketHttpReader::sl_readyRead()
     if (!_parcer->isCompleted())
         return;
 
+    _unparsed = _parcer->takeUnparsed();
+
     if (_parcer->type() == HttpParser::Type::HTTP_REQUEST) {
         _request = HttpRequestHeader(*_parcer);
         emit sg_request(_request);
@@ -403,6 +427,33 @@ SocketWriter::SocketWriter(const HttpHeader& header, const QString& host_info, Q
 {
 }
 
+SocketWriter::SocketWriter(const HttpHeader& header, QIODevice* body, qint64 body_offset, qint64 body_size, const QString& host_info,
+                           QAbstractSocket* socket, quint16 write_buffer_size, quint32 disconnect_timeout, bool close_on_finish,
+                           bool delete_on_finish, QObject* parent)
+    : SocketWriter(header.toByteArray(true), host_info, socket, write_buffer_size, disconnect_timeout, close_on_finish, delete_on_finish,
+                   parent)
+{
+    Z_CHECK_NULL(body);
+    Z_CHECK(body->isOpen());
+    Z_CHECK(body_offset >= 0 && body_size >= 0);
+    Z_CHECK(header.contentLength() == body_size);
+
+    _body = body;
+    _body->setParent(this);
+    _body_left = body_size;
+    _data_size += body_size;
+
+    if (body_size == 0)
+        return;
+
+    QFileDevice* file = qobject_cast<QFileDevice*>(body);
+    if (file != nullptr)
+        _body_map = file->map(body_offset, body_size);
+
+    if (_body_map == nullptr && !_body->seek(body_offset))
+        _body_error = Error::fileIOError(_body);
+}
+
 SocketWriter::~SocketWriter()
 {
     delete _data_buffer;
@@ -479,11 +530,28 @@ void SocketWriter::sl_send()
         return;
     }
 
-    qint64 read = _data_buffer->read(_write_buffer.data(), _write_buffer.size());
-    Z_CHECK(read >= 0);
+    if (_body_error.isError()) {
+        setError(_body_error);
+        return;
+    }
+
+    const char* chunk;
+    qint64 read;
+    if (!_data_buffer->atEnd()) {
+        read = _data_buffer->read(_write_buffer.data(), _write_buffer.size());
+        Z_CHECK(read >= 0);
+        chunk = _write_buffer.constData();
+
+    } else {
+        chunk = readBody(read);
+        if (chunk == nullptr) {
+            setError(Error::fileIOError(_body));
+            return;
+        }
+    }
 
     _has_read += read;
-    qint64 written = socket()->write(_write_buffer.constData(), read);
+    qint64 written = socket()->write(chunk, read);
     if (written < 0) {
         if (!socket()->errorString().isEmpty())
             setError(Error(socket()->errorString()));
@@ -519,7 +587,28 @@ void SocketWriter::sl_bytesWritten(qint64 len)
 
 bool SocketWriter::isAllWriten() const
 {
-    return _data_size == 0 || _has_written == _data_size || _data_buffer->atEnd();
+    return _data_size == 0 || _has_written == _data_size || (_data_buffer->atEnd() && _body_left == 0);
+}
+
+const char* SocketWriter::readBody(qint64& size)
+{
+    size = qMin<qint64>(_body_left, _write_buffer.size());
+    if (size == 0)
+        return _write_buffer.constData();
+
+    if (_body_map != nullptr) {
+        const char* ptr = reinterpret_cast<const char*>(_body_map) + _body_map_pos;
+        _body_map_pos += size;
+        _body_left -= size;
+        return ptr;
+    }
+
+    size = _body->read(_write_buffer.data(), size);
+    if (size <= 0)
+        return nullptr;
+
+    _body_left -= size;
+    return _write_buffer.constData();
 }
 
 TcpSocket::TcpSocket(QObject* parent)
@@ -142,6 +142,12 @@ public:
     //! Запустить и ждать до окончания чтения или ошибки
     Error wait(HttpRequestHeader& request, HttpResponseHeader& response);
 
+    //! Данные, которые уже были прочитаны из сокета предыдущей операцией, но к ней не относятся. Задается до start
+    void setUnparsedData(const QByteArray& data);
+    //! Данные, прочитанные из сокета после окончания сообщения (следующие запросы при конвейерной обработке)
+    //! Доступны в момент генерации sg_request/sg_response
+    QByteArray unparsedData() const;
+
     //! Синхронно прочитать входящий HTTP запрос
     static Error read(
         //! HTTP запрос
@@ -187,6 +193,8 @@ private slots:
 
 private:
     std::shared_ptr<HttpParser> _parcer;
+    //! Данные, прочитанные из сокета ранее
+    QByteArray _unparsed;
     HttpRequestHeader _request;
     HttpResponseHeader _response;
 };
@@ -226,6 +234,29 @@ public:
         bool close_on_finish = false,
         //! Удалить объект по окончании записи или при ошибке
         bool delete_on_finish = false, QObject* parent = 0);
+    /*! Заголовок и тело из внешнего источника (например файла), которое не загружается в память целиком.
+     * Если источник - файл, то он отображается в память и передается в сокет без промежуточного буфера чтения */
+    explicit SocketWriter(
+        //! Заголовок. Content-Length должен быть задан и равен body_size
+        const HttpHeader& header,
+        //! Источник тела (должен быть открыт на чтение). Становится собственностью SocketWriter
+        QIODevice* body,
+        //! Смещение начала тела в источнике
+        qint64 body_offset,
+        //! Размер тела (байт)
+        qint64 body_size,
+        //! Информация о хосте
+        const QString& host_info,
+        //! Сокет для записи (должен быть открыт)
+        QAbstractSocket* socket,
+        //! Размер буфера записи данных в сокет (байт)
+        quint16 write_buffer_size,
+        //! Время ожидания отключения сокета (мс). Имеет смысл только при close_on_finish
+        quint32 disconnect_timeout = 5000,
+        //! Закрыть сокет по окончании записи или при ошибке
+        bool close_on_finish = false,
+        //! Удалить объект по окончании записи или при ошибке
+        bool delete_on_finish = false, QObject* parent = 0);
     ~SocketWriter();
 
     QByteArray data() const;
@@ -278,11 +309,24 @@ private slots:
 
 private:
     bool isAllWriten() const;
+    //! Прочитать очередную порцию тела. Возвращает указатель на данные или nullptr при ошибке
+    const char* readBody(qint64& size);
 
     QByteArray _data;
     QBuffer* _data_buffer = nullptr;
     QByteArray _write_buffer;
 
+    //! Источник тела, которое передается после _data
+    QIODevice* _body = nullptr;
+    //! Тело, отображенное в память (если источник - файл)
+    uchar* _body_map = nullptr;
+    //! Сколько байт тела осталось прочитать
+    qint64 _body_left = 0;
+    //! Позиция в отображенном теле
+    qint64 _body_map_pos = 0;
+    //! Ошибка подготовки тела. Передается через sg_error после запуска
+    Error _body_error;
+
     qint64 _has_read = 0;
     qint64 _has_written = 0;
     qint64 _data_size = 0;
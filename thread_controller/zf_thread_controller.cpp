@@ -46,7 +46,7 @@ void Controller::setThreadTimeout(int thread_timeout_ms)
 
 int Controller::count() const
 {
-    return _workers.count();
+    return _worker_count.loadAcquire();
 }
 
 int Controller::activeCount() const
@@ -123,6 +123,7 @@ QString Controller::startWorker(Worker* worker)
     }
 
     _workers[id] = worker;
+    _worker_count.storeRelease(_workers.count());
 
     Z_THREAD_CONTROLLER_DEBUG_LOG(id, "Controller::startWorker 4");
 
@@ -182,6 +183,7 @@ void Controller::cancelAll()
         delete w;
         _workers.remove(id);
     }
+    _worker_count.storeRelease(0);
 
     _waiting_to_cancel.clear();
     _cancell_requested = false;
@@ -231,6 +233,7 @@ void Controller::sl_worker_finished(QString id)
         return;
 
     _workers.remove(id);
+    _worker_count.storeRelease(_workers.count());
     emit sg_finished(id);
 
     w->wait(_terminate_timeout_ms);
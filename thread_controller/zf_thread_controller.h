@@ -6,6 +6,7 @@
 #include <QThreadPool>
 #include <QMap>
 #include <QSet>
+#include <QAtomicInt>
 
 #include "zf_thread_worker.h"
 
@@ -39,7 +40,7 @@ public:
     int threadTimeout() const;
     void setThreadTimeout(int thread_timeout_ms);
 
-    //! Общее количество выполняемых задач
+    //! Общее количество выполняемых задач. Потокобезопасно
     int count() const;
     //! Сколько задач реально выполняется, а не просто висит в ожидании свободного потока в пуле
     int activeCount() const;
@@ -113,6 +114,8 @@ private:
 
     //! Список выполняемых задач
     QMap<QString, Worker*> _workers;
+    //! Количество задач в _workers. Отдельно, т.к. count() вызывается из других потоков
+    QAtomicInt _worker_count;
     //! Ожидают остановки
     QSet<QString> _waiting_to_cancel;
 
@@ -3697,7 +3697,21 @@ bool View::calculateConditionFilter(const DataProperty& dataset, int row, const
 
     QList<ModelPtr> data_not_ready;
     Error error;
-    bool res = c_filter->calculateOnView(this, data_not_ready, error, { DataStructure::propertyRow(dataset, datasetRowID(dataset, row, parent)) });
+    bool res = false;
+
+    auto info = propertyInfo(dataset);
+    if (info->compiled_condition_filter == nullptr && !info->compiled_condition_filter_unsupported) {
+        info->compiled_condition_filter = CompiledCondition::compile(c_filter, this, dataset, data_not_ready, error);
+        // условие нельзя скомпилировать (или ошибка компиляции) - вычисляем по дереву, оно и сообщит об ошибке
+        info->compiled_condition_filter_unsupported = info->compiled_condition_filter == nullptr && data_not_ready.isEmpty();
+        if (info->compiled_condition_filter_unsupported)
+            error = Error();
+    }
+
+    if (info->compiled_condition_filter != nullptr)
+        res = info->compiled_condition_filter->calculate(row, parent, data_not_ready, error);
+    else if (info->compiled_condition_filter_unsupported)
+        res = c_filter->calculateOnView(this, data_not_ready, error, {DataStructure::propertyRow(dataset, datasetRowID(dataset, row, parent))});
 
     if (!data_not_ready.isEmpty()) {
         // надо обновить отфильтровку после окончания загрузки данных
@@ -3743,6 +3757,7 @@ void View::sl_conditionLookupModelLoaded(const Error&, const LoadOptions&, const
         }
 
         if (info->condition_lookup_load_waiting_info.isEmpty()) {
+            resetCompiledConditionFilter(dataset);
             filter()->refilter(dataset); // все загрузилось
             // qDebug() << "--------- 3";
             const_cast<View*>(this)->unBlockUi();
@@ -5202,10 +5217,18 @@ void View::updateWidgetHighlight(const HighlightItem& item)
 
 void View::conditionFilterChanged(const DataProperty& dataset)
 {
+    resetCompiledConditionFilter(dataset);
     horizontalHeaderView(dataset)->viewport()->update();
     emit sg_conditionFilterChanged(dataset);
 }
 
+void View::resetCompiledConditionFilter(const DataProperty& dataset)
+{
+    auto info = propertyInfo(dataset);
+    info->compiled_condition_filter.reset();
+    info->compiled_condition_filter_unsupported = false;
+}
+
 void View::compressActionsHelper()
 {
     if (mainToolbar() != nullptr)
@@ -1908,6 +1908,8 @@ private:
 
     //! Изменились условия фильтрации
     void conditionFilterChanged(const DataProperty& dataset);
+    //! Сбросить скомпилированный фильтр на основании условий
+    void resetCompiledConditionFilter(const DataProperty& dataset);
 
     //! Удалить лишние сепараторы
     void compressActionsHelper();
@@ -2064,6 +2066,11 @@ private:
         //! Список lookup моделей, которые должны загрузиться прежде чем с ними можно будет работать в фильтрации или сортировке
         QList<ConditionLookupLoadWaitingInfo> condition_lookup_load_waiting_info;
 
+        //! Скомпилированный фильтр на основании условий. Сбрасывается при изменении условий или загрузке lookup
+        CompiledConditionPtr compiled_condition_filter;
+        //! Фильтр нельзя скомпилировать и он вычисляется по дереву условий
+        bool compiled_condition_filter_unsupported = false;
+
         //!  Подписка на сигнал об окончании перезагрузки lookup
         QMetaObject::Connection connection_lookup;
     };